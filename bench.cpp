@@ -0,0 +1,504 @@
+// Microbenchmarks for the portable core (Linux).
+//
+//   bench                         run everything, human-readable
+//   bench --filter=json           only benchmarks whose name contains "json"
+//   bench --json > base.json      machine-readable results (stable key order)
+//   bench --baseline=base.json    compare against saved results; exits 1 if
+//                                 anything got slower than --threshold (5%)
+//
+// Each benchmark is calibrated to ~--min-time seconds per sample and the
+// median of --samples samples is reported, which keeps run-to-run noise low
+// enough to compare builds on one machine.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "asset_hash.h"
+#include "clip_crypto.h"
+#include "clip_json.h"
+#include "histogram.h"
+#include "log_channel.h"
+#include "log_model.h"
+#include "remote_deploy.h"
+#include "scan.h"
+#include "shm_ring.h"
+#include "startup.h"
+#include "transcode.h"
+
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct Benchmark {
+    std::string name;
+    size_t bytesPerOp;  // 0 if throughput in bytes is meaningless
+    std::function<void()> op;
+};
+
+struct Result {
+    std::string name;
+    double nsPerOp = 0;
+    double gbPerSec = 0;
+    double spread = 0;  // (max - min) / median across samples
+    uint64_t iterations = 0;
+};
+
+static std::vector<Benchmark>& Registry() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+static void Register(std::string name, size_t bytesPerOp, std::function<void()> op) {
+    Registry().push_back({ std::move(name), bytesPerOp, std::move(op) });
+}
+
+static double Seconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static Result Run(const Benchmark& b, double minTime, int samples) {
+    // Calibrate: grow the batch until one batch takes ~minTime
+    uint64_t batch = 1;
+    for (;;) {
+        double t0 = Seconds();
+        for (uint64_t i = 0; i < batch; i++) b.op();
+        double elapsed = Seconds() - t0;
+        if (elapsed >= minTime || batch >= (1ull << 40)) break;
+        double scale = elapsed > 0 ? minTime / elapsed : 100;
+        batch = (uint64_t)(batch * std::min(100.0, std::max(2.0, scale * 1.1)));
+    }
+
+    std::vector<double> perOp;
+    for (int s = 0; s < samples; s++) {
+        double t0 = Seconds();
+        for (uint64_t i = 0; i < batch; i++) b.op();
+        perOp.push_back((Seconds() - t0) * 1e9 / batch);
+    }
+    std::sort(perOp.begin(), perOp.end());
+
+    Result r;
+    r.name = b.name;
+    r.nsPerOp = perOp[perOp.size() / 2];
+    r.gbPerSec = b.bytesPerOp && r.nsPerOp > 0 ? b.bytesPerOp / r.nsPerOp : 0;
+    r.spread = r.nsPerOp > 0 ? (perOp.back() - perOp.front()) / r.nsPerOp : 0;
+    r.iterations = batch * samples;
+    return r;
+}
+
+// --- Clip ring handoff -----------------------------------------------------
+
+static void FutexWait(std::atomic<uint32_t>* word, uint32_t value) {
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, value, nullptr, nullptr, 0);
+}
+
+static void FutexWake(std::atomic<uint32_t>* word) {
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+static void RingSend(ShmRing& ring, const void* data, size_t len) {
+    while (!ring.TryWrite(data, len)) std::this_thread::yield();
+    if (ring.WakeNeeded()) FutexWake(ring.SleepWord());
+}
+
+// Waits for records the way a native consumer would: spin for a moment,
+// then sleep on the ring's futex word until the producer signals
+template <typename OnRecord>
+static void RingReceive(ShmRing& ring, OnRecord onRecord) {
+    for (;;) {
+        if (ring.Drain(onRecord)) return;
+        for (int spin = 0; spin < 1024 && !ring.Pending(); spin++) {}
+        if (ring.Pending()) continue;
+        if (ring.PrepareSleep()) FutexWait(ring.SleepWord(), 1);
+        ring.EndSleep();
+    }
+}
+
+// --- Inputs ---------------------------------------------------------------
+
+static std::string AsciiText(size_t size) {
+    std::mt19937 rng(1);
+    std::string s(size, ' ');
+    for (char& c : s) c = (char)(' ' + rng() % 95);
+    return s;
+}
+
+// Mostly ASCII with Latin-1, CJK and emoji mixed in, like real clips
+static std::string MixedText(size_t size) {
+    static const char* pieces[] = { "hello ", "wörld ", "naïve ", "日本語 ", "テキスト ", "🙂 ", "code(); " };
+    std::mt19937 rng(2);
+    std::string s;
+    while (s.size() < size) s += pieces[rng() % 7];
+    return s;
+}
+
+// Source code: lots of quotes, backslashes and newlines to escape
+static std::string CodeText(size_t size) {
+    static const char* pieces[] = {
+        "if (x == \"a\\\\b\") {\n", "\treturn \"\\n\";\n", "}\n", "printf(\"%d\\t%s\\n\", i, name);\n",
+        "path = \"C:\\\\Users\\\\spill\";\n", "// plain comment text goes here\n"
+    };
+    std::mt19937 rng(3);
+    std::string s;
+    while (s.size() < size) s += pieces[rng() % 6];
+    return s;
+}
+
+// Byte-at-a-time C++ escaper, to show what the SSE2 skip buys. It is not
+// the server's path: the server is Python, and its json.dumps (C
+// accelerated) runs at ~0.2 GB/s on both inputs below on the machine that
+// gave the readme's numbers, about this loop's speed on code.
+static void BytewiseEscape(std::string& out, std::string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    for (unsigned char c : text) {
+        if (c == '"') out += "\\\"";
+        else if (c == '\\') out += "\\\\";
+        else if (c == '\n') out += "\\n";
+        else if (c == '\t') out += "\\t";
+        else if (c == '\r') out += "\\r";
+        else if (c < 0x20) { out += "\\u00"; out += hex[c >> 4]; out += hex[c & 15]; }
+        else out += (char)c;
+    }
+    out += '"';
+}
+
+static void RegisterAll() {
+    const size_t kSize = 64 * 1024;
+
+    // Transcoding
+    static std::string ascii = AsciiText(kSize);
+    static std::string mixed = MixedText(kSize);
+    static std::u16string ascii16 = Utf8ToUtf16(ascii);
+    static std::u16string mixed16 = Utf8ToUtf16(mixed);
+    static std::u16string wide(kSize, u'\0');
+    static std::string narrow(kSize * 3, '\0');
+
+    Register("transcode/utf8_to_utf16/ascii", ascii.size(), [] {
+        DoNotOptimize(Utf8ToUtf16(ascii.data(), ascii.size(), &wide[0]));
+    });
+    Register("transcode/utf8_to_utf16/mixed", mixed.size(), [] {
+        DoNotOptimize(Utf8ToUtf16(mixed.data(), mixed.size(), &wide[0]));
+    });
+    Register("transcode/utf16_to_utf8/ascii", ascii16.size() * 2, [] {
+        DoNotOptimize(Utf16ToUtf8(ascii16.data(), ascii16.size(), &narrow[0]));
+    });
+    Register("transcode/utf16_to_utf8/mixed", mixed16.size() * 2, [] {
+        DoNotOptimize(Utf16ToUtf8(mixed16.data(), mixed16.size(), &narrow[0]));
+    });
+    Register("transcode/validate_utf8/mixed", mixed.size(), [] {
+        DoNotOptimize(ValidateUtf8(mixed.data(), mixed.size()));
+    });
+
+    // JSON
+    static std::string code = CodeText(kSize);
+    static std::string escaped;
+    Register("json/escape/code/bytewise", code.size(), [] {
+        escaped.clear();
+        BytewiseEscape(escaped, code);
+        DoNotOptimize(escaped);
+    });
+    Register("json/escape/code/simd", code.size(), [] {
+        escaped.clear();
+        AppendJsonString(escaped, code);
+        DoNotOptimize(escaped);
+    });
+    Register("json/escape/prose/simd", mixed.size(), [] {
+        escaped.clear();
+        AppendJsonString(escaped, mixed);
+        DoNotOptimize(escaped);
+    });
+
+    static std::string clipJson;
+    ClipJson clip;
+    clip.content = code;
+    clip.timestamp = "2026-01-01T12:00:00.000000";
+    clip.userId = "user1";
+    AppendClipJson(clipJson, clip);
+    static std::string scratch;
+    Register("json/parse_clip/code", clipJson.size(), [] {
+        scratch = clipJson;  // parsing is destructive
+        ClipJson parsed;
+        DoNotOptimize(ParseClipJson(&scratch[0], scratch.size(), parsed));
+    });
+    Register("json/parse_clip/copy_only", clipJson.size(), [] {
+        scratch = clipJson;  // baseline for the copy inside parse_clip
+        DoNotOptimize(scratch);
+    });
+
+    // Histograms
+    static HdrHistogram histogram;
+    static uint64_t value = 1;
+    Register("histogram/record", 0, [] {
+        value = value * 6364136223846793005ull + 1442695040888963407ull;
+        histogram.Record(value >> 44);
+    });
+
+    // Child log channel: split + parse + push, then drain, as the GUI does
+    static std::string logStream;
+    for (int i = 0; logStream.size() < kSize; i++) {
+        if (i % 4 == 3) logStream += "Collecting flask\r\n";  // pip noise
+        else logStream += "{\"ts\": 1792378854.302, \"level\": \"info\", \"source\": \"server\", "
+                          "\"msg\": \"[CLIPBOARD] [user1] Received (5 chars): 'h\\u00e9llo'\"}\n";
+    }
+    static std::string logScratch;
+    static LogChannel logChannel(1 << 16);
+    Register("log/split_parse_drain", logStream.size(), [] {
+        logScratch = logStream;
+        LineSplitter splitter;
+        splitter.Feed(&logScratch[0], logScratch.size(),
+                      [](char* line, size_t len) { logChannel.Push(line, len, "python"); });
+        logChannel.Drain([](LogRecord& record) { DoNotOptimize(record); });
+    });
+
+    static SpscRing<uint64_t> ring(1024);
+    Register("log/spsc_ring/push_pop", 0, [] {
+        uint64_t item = 1;
+        ring.TryPush(std::move(item));
+        ring.TryPop(item);
+        DoNotOptimize(item);
+    });
+
+    // Scrollback: wrap + append at the GUI's width, with eviction running
+    static std::wstring logText;
+    while (logText.size() < kSize / 2) {
+        logText += L"[server] [CLIPBOARD] [user1] Received (5 chars): 'h\u00e9llo' and a longer tail "
+                   L"that has to be wrapped once at sixty columns\n";
+    }
+    static LogScrollback<wchar_t> scrollback(256 * 1024, 60);
+    Register("log/scrollback/append", logText.size() * sizeof(wchar_t), [] {
+        scrollback.Append(logText);
+        DoNotOptimize(scrollback.EndRow());
+    });
+
+    // Start: naming the extracted server script by content hash. Stand-in
+    // text the size of the embedded server, so the bench doesn't embed it
+    static std::string serverScript = CodeText(112 * 1024);
+    Register("startup/asset_hash/script_112k", serverScript.size(), [] {
+        DoNotOptimize(AssetHash(serverScript));
+    });
+
+    // External Start: the one-round-trip script with the server inlined
+    static RemoteTarget remote;
+    remote.host = "example.org";
+    Register("startup/remote_bringup_script", serverScript.size(), [] {
+        DoNotOptimize(RemoteBringUpScript(remote, serverScript, "flask requests"));
+    });
+
+    // Local-mode clip ring: a 1 KB clip written and read back in place
+    static std::vector<uint64_t> ringRegion(ShmRing::RegionSize(1 << 20) / 8);
+    static ShmRing clipRing = ShmRing::Create(ringRegion.data(), ringRegion.size() * 8);
+    static std::string ringClip = clipJson.substr(0, 1024);
+    Register("shm_ring/write_drain/1k", ringClip.size(), [] {
+        clipRing.TryWrite(ringClip.data(), ringClip.size());
+        clipRing.Drain([](const char* data, size_t len) { DoNotOptimize(data[len - 1]); });
+    });
+
+    // Handoff to another thread and back: one-way latency is half of ns/op.
+    // The echo thread parks on a futex between benchmarks.
+    static std::vector<uint64_t> pingRegion(ShmRing::RegionSize(4096) / 8);
+    static std::vector<uint64_t> pongRegion(ShmRing::RegionSize(4096) / 8);
+    static ShmRing ping = ShmRing::Create(pingRegion.data(), pingRegion.size() * 8);
+    static ShmRing pong = ShmRing::Create(pongRegion.data(), pongRegion.size() * 8);
+    std::thread([] {
+        ShmRing in = ShmRing::Attach(pingRegion.data(), pingRegion.size() * 8);
+        ShmRing out = ShmRing::Attach(pongRegion.data(), pongRegion.size() * 8);
+        for (;;) RingReceive(in, [&](const char* data, size_t len) { RingSend(out, data, len); });
+    }).detach();
+    static char message[64];
+    Register("shm_ring/handoff/round_trip", 0, [] {
+        RingSend(ping, message, sizeof(message));
+        RingReceive(pong, [](const char* data, size_t) { DoNotOptimize(data[0]); });
+    });
+
+    // Multi-needle scan over clip text none of the needles occur in, so every
+    // byte is looked at; most of them start like words that do. A query
+    // against recent clips without an index costs (bytes of those clips) /
+    // (GB/s below).
+    static const char* needles[] = { "hello world", "naive", "codec", "wordle",
+                                     "ÄRGER", "localhost", "redirect", "clear" };
+    static MultiScanner oneNeedle, eightNeedles, eightFolded(true);
+    oneNeedle.Add(needles[0]);
+    for (const char* needle : needles) {
+        eightNeedles.Add(needle);
+        eightFolded.Add(needle);
+    }
+    Register("scan/find/1_needle/std", mixed.size(), [] {
+        DoNotOptimize(std::string_view(mixed).find(needles[0]));
+    });
+    Register("scan/find/1_needle/pair", mixed.size(), [] {
+        DoNotOptimize(oneNeedle.Find(mixed));
+    });
+    Register("scan/find/8_needles/std", mixed.size(), [] {
+        for (const char* needle : needles) DoNotOptimize(std::string_view(mixed).find(needle));
+    });
+    Register("scan/find/8_needles/teddy", mixed.size(), [] {
+        DoNotOptimize(eightNeedles.Find(mixed));
+    });
+    Register("scan/find/8_needles/teddy_icase", mixed.size(), [] {
+        DoNotOptimize(eightFolded.Find(mixed));
+    });
+    Register("scan/find/8_needles/teddy_icase_code", code.size(), [] {
+        DoNotOptimize(eightFolded.Find(code));
+    });
+    // Lower-case copy, then a find per needle: the shape of a scan in Python
+    static std::string lowered;
+    Register("scan/find/8_needles/lower_copy_std", mixed.size(), [] {
+        lowered = mixed;
+        for (char& c : lowered) c = (char)tolower((unsigned char)c);
+        for (const char* needle : needles) DoNotOptimize(std::string_view(lowered).find(needle));
+    });
+
+    // Clip encryption: one 64 KiB chunk sealed in place, and a whole clip
+    // through the streaming sealer/opener. The HTTP round trip a clip rides
+    // on costs ~100 us, which is 64 KiB at ~0.6 GB/s.
+    static const uint8_t key[kClipKeySize] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    static const uint8_t nonce[kClipNonceSize] = { 9 };
+    static ClipAead gcm(ClipCipher::Aes256Gcm, key), gcmPortable(ClipCipher::Aes256Gcm, key, false);
+    static ClipAead chacha(ClipCipher::ChaCha20Poly1305, key);
+    static std::string sealBuffer(kSize + kClipTagSize, '\0');
+    auto sealChunk = [](const ClipAead& aead) {
+        uint8_t* p = (uint8_t*)&sealBuffer[0];
+        aead.Seal(nonce, (const uint8_t*)"user", 4, p, kSize, p);
+        DoNotOptimize(sealBuffer[kSize]);
+    };
+    Register("crypto/seal/aes_gcm", kSize, [=] { sealChunk(gcm); });
+    Register("crypto/seal/aes_gcm_portable", kSize, [=] { sealChunk(gcmPortable); });
+    Register("crypto/seal/chacha20", kSize, [=] { sealChunk(chacha); });
+    static std::string bigClip = MixedText(1 << 20);
+    static std::string sealed[3], sealedCopy;
+    for (ClipCipher cipher : { ClipCipher::Aes256Gcm, ClipCipher::ChaCha20Poly1305 }) {
+        std::string suffix = cipher == ClipCipher::Aes256Gcm ? "aes_gcm" : "chacha20";
+        std::string& input = sealed[(int)cipher];
+        ClipSealer sealer(cipher, key, "user", nonce);
+        sealer.Update(bigClip.data(), bigClip.size(), input);
+        sealer.Finish(input);
+        Register("crypto/stream_seal/1m/" + suffix, bigClip.size(), [cipher] {
+            ClipSealer sealer(cipher, key, "user", nonce);
+            sealedCopy.clear();
+            sealer.Update(bigClip.data(), bigClip.size(), sealedCopy);
+            sealer.Finish(sealedCopy);
+        });
+        Register("crypto/stream_open/1m/" + suffix, bigClip.size(), [&input] {
+            ClipOpener opener(key, "user");
+            sealedCopy.clear();
+            opener.Update(input.data(), input.size(), sealedCopy);
+            DoNotOptimize(opener.Finish(sealedCopy));
+        });
+    }
+}
+
+// --- Output and comparison --------------------------------------------------
+
+static std::string ToJson(const std::vector<Result>& results) {
+    std::ostringstream out;
+    out << "{\"benchmarks\":[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        char line[512];
+        snprintf(line, sizeof(line),
+                 "  {\"name\":\"%s\",\"ns_per_op\":%.3f,\"gb_per_s\":%.3f,\"spread\":%.4f,\"iterations\":%llu}%s\n",
+                 r.name.c_str(), r.nsPerOp, r.gbPerSec, r.spread, (unsigned long long)r.iterations,
+                 i + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+// Reads name -> ns_per_op from a file written by --json
+static bool LoadBaseline(const std::string& path, std::map<std::string, double>& baseline) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t name = line.find("\"name\":\"");
+        size_t ns = line.find("\"ns_per_op\":");
+        if (name == std::string::npos || ns == std::string::npos) continue;
+        name += 8;
+        std::string key = line.substr(name, line.find('"', name) - name);
+        baseline[key] = atof(line.c_str() + ns + 12);
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string filter, baselinePath;
+    bool json = false;
+    double minTime = 0.1, threshold = 0.05;
+    int samples = 7;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        if (key == "--filter") filter = value;
+        else if (key == "--json") json = true;
+        else if (key == "--baseline") baselinePath = value;
+        else if (key == "--threshold") threshold = atof(value.c_str()) / (!value.empty() && value.back() == '%' ? 100 : 1);
+        else if (key == "--min-time") minTime = atof(value.c_str());
+        else if (key == "--samples") samples = std::max(1, atoi(value.c_str()));
+        else {
+            fprintf(stderr, "usage: bench [--filter=S] [--json] [--baseline=FILE] [--threshold=5%%]"
+                            " [--min-time=0.1] [--samples=7]\n");
+            return 2;
+        }
+    }
+
+    std::map<std::string, double> baseline;
+    if (!baselinePath.empty() && !LoadBaseline(baselinePath, baseline)) {
+        fprintf(stderr, "bench: cannot read baseline %s\n", baselinePath.c_str());
+        return 2;
+    }
+
+    RegisterAll();
+    std::vector<Result> results;
+    int regressions = 0;
+    for (const Benchmark& b : Registry()) {
+        if (!filter.empty() && b.name.find(filter) == std::string::npos) continue;
+        Result r = Run(b, minTime, samples);
+        results.push_back(r);
+        if (json) continue;
+
+        printf("%-36s %12.1f ns/op", r.name.c_str(), r.nsPerOp);
+        if (r.gbPerSec > 0) printf(" %8.2f GB/s", r.gbPerSec);
+        else printf("%14s", "");
+        printf("  ±%4.1f%%", r.spread * 50);
+        auto base = baseline.find(r.name);
+        if (base != baseline.end() && base->second > 0) {
+            double change = r.nsPerOp / base->second - 1;
+            bool slower = change > threshold;
+            regressions += slower;
+            printf("  %+6.1f%% vs baseline%s", change * 100, slower ? "  REGRESSION" : "");
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    if (json) {
+        fputs(ToJson(results).c_str(), stdout);
+        for (const Result& r : results) {
+            auto base = baseline.find(r.name);
+            if (base != baseline.end() && base->second > 0 && r.nsPerOp / base->second - 1 > threshold) regressions++;
+        }
+    }
+    if (regressions) fprintf(stderr, "bench: %d benchmark(s) regressed by more than %.0f%%\n", regressions, threshold * 100);
+    return regressions ? 1 : 0;
+}
@@ -1,13 +1,32 @@
 #pragma once
 
 const char* broadcast_py = R"py(
-from flask import Flask, request, jsonify
+from flask import Flask, request, jsonify, Response, g
+import atexit
+import hashlib
+import itertools
 import json
+import math
+import mmap
 import os
+import platform
+import re
+import select
+import shutil
+import socket
+import ssl
+import struct
+import tempfile
 from datetime import datetime
+from urllib.parse import urlencode
+from collections import Counter, OrderedDict, deque
 import threading
 import logging
+import logging.handlers
 import sys
+import time
+from array import array
+from bisect import bisect_left, bisect_right
 
 if sys.platform == "win32":
     sys.stdout.reconfigure(encoding='utf-8')
@@ -15,10 +34,65 @@ if sys.platform == "win32":
 
 app = Flask(__name__)
 
+# Clips are mostly non-ASCII-safe text; don't inflate them with \uXXXX escapes
+app.config['JSON_AS_ASCII'] = False
+if hasattr(app, 'json'):
+    app.json.ensure_ascii = False
+
 # Configuration
-LOG_FILE = "clipboard_log.txt"
-JSON_LOG_FILE = "clipboard_log.json"
+LOG_FILE = "clipboard_log.txt"  # Who sent how much when; never clip text, which only the JSON log keeps
+JSON_LOG_FILE = "clipboard_log.jsonl"  # One compact JSON record per line
+LEGACY_JSON_LOG_FILE = "clipboard_log.json"  # Whole-file log of older versions; moved into JSON_LOG_FILE on start
 MAX_CONTENT_DISPLAY = 100  # Max characters to display in console
+MAX_CLIPS_PER_USER = 50  # Clips whose format payloads are kept in memory
+MAX_LATEST_WAIT = 60  # Upper bound for /<user_id>/latest?wait= and /<user_id>/wanted?wait= in seconds
+TRACE_CAPACITY = 4096  # Most recent stage spans kept for /trace
+TRACE_CLIENT_STAGES = {'capture', 'hash', 'queue', 'seal'}  # Stages a client may report; others are dropped
+CAPTURE_FILE = os.environ.get('SPILL_CAPTURE')  # Request trace for replay; off unless set
+CAPTURE_QUERY_KEPT = {'wait', 'limit', 'after', 'seconds', 'hz', 'idle', 'user_id'}  # Query values captured as is; others are hashed
+MAX_PROFILE_SECONDS = 15  # Upper bound for /profile?seconds=; the request's thread samples throughout
+SEARCH_INDEX_CHARS = 16 * 1024  # Leading characters of each clip that search can find
+MAX_SEARCH_RESULTS = 100  # Upper bound for /<user_id>/search?limit=
+SEARCH_SCAN_BUDGET = 200000  # Candidate clips one query may check before answering with what it has
+SEARCH_SCAN_BLOCK = 512  # Clips searched in one pass over their records where the index can't narrow a range
+RING_NAME = os.environ.get('SPILL_RING')  # Shared-memory clip ring for a local client; set by the GUI
+RING_CAPACITY = 4 * 1024 * 1024  # Ring data bytes; clips over half of this go over HTTP
+REDACT_MODE = os.environ.get('SPILL_REDACT', 'mask')  # Secrets in clips: 'mask' them, 'drop' the clip, or 'off'
+REDACT_PATTERNS_FILE = 'redact_patterns.txt'  # Extra secret patterns, one regular expression per line
+REDACT_MIN_ENTROPY = 4.2  # Bits per character above which a long mixed-case token counts as a secret
+TLS_CERT = os.environ.get('SPILL_TLS_CERT', 'spill.crt')  # PEM certificate chain; port 8000 speaks TLS when it and the key exist
+TLS_KEY = os.environ.get('SPILL_TLS_KEY', 'spill.key')  # PEM private key for TLS_CERT
+TLS_TICKETS = 2  # TLS 1.3 session tickets per full handshake; each resumes one later connection
+TLS_HANDSHAKE_TIMEOUT = 10  # Seconds a client gets to finish its handshake
+RATE_USER = float(os.environ.get('SPILL_RATE_USER', 20))  # Requests a second one user may sustain; 0 = no limit
+RATE_USER_BURST = 60  # Requests one user may make back to back before RATE_USER applies
+RATE_GLOBAL = float(os.environ.get('SPILL_RATE_GLOBAL', 400))  # Requests a second across all users; 0 = no limit
+RATE_GLOBAL_BURST = 800  # Requests all users together may make back to back
+RATE_BYTES_PER_TOKEN = 64 * 1024  # A request costs one token plus one per this many body bytes
+ADMIT_RUNNING = 8  # Requests handled at once; the rest wait for a turn, clips first
+ADMIT_WAIT = (2.0, 1.0, 0.1)  # Seconds a small clip / other request / low-priority request waits for a turn before a 503
+SHED_LARGE_BODY = 256 * 1024  # Bodies over this many bytes are low priority under overload
+RETAIN_AGE = float(os.environ.get('SPILL_RETAIN_AGE', 24 * 3600))  # Seconds a clip is kept; 0 = no age limit
+RETAIN_CLIPS = int(os.environ.get('SPILL_RETAIN_CLIPS', 1000))  # Newest clips kept per user; 0 = no count limit
+RETAIN_BYTES = int(os.environ.get('SPILL_RETAIN_BYTES', 64 * 1024 * 1024))  # Record bytes kept per user; 0 = no byte limit
+COMPACT_INTERVAL = 60  # Seconds between retention passes
+COMPACT_MIN_GAP = 1  # Seconds between passes when woken early (clears, arena evictions)
+COMPACT_DEAD_RATIO = 0.5  # Share of the clip log that must be dropped records before it is rewritten
+COMPACT_MIN_BYTES = 1024 * 1024  # ... and at least this many bytes of them
+TEXT_LOG_MAX_BYTES = 16 * 1024 * 1024  # clipboard_log.txt is moved to .1 past this size
+SERVER_LOG_MAX_BYTES = 16 * 1024 * 1024  # server.log likewise
+EPHEMERAL_MB = int(os.environ.get('SPILL_EPHEMERAL_MB', 0))  # Keep clips only in a memory arena this size, write no files; 0 = off
+UNIX_SOCKET = os.environ.get('SPILL_SOCKET', '' if EPHEMERAL_MB else 'spill.sock')  # Same-host listener; '' turns it off (the default when ephemeral)
+ARENA_EVICT_SHARE = 64  # Ephemeral mode frees at least 1/this of the arena whenever it has to evict
+
+# Clip formats, cheapest first. The cheapest available one travels inline as
+# 'content'; the rest are uploaded by the client only once a consumer asks.
+CLIP_FORMATS = OrderedDict([
+    ('text', 'text/plain; charset=utf-8'),
+    ('html', 'text/html; charset=utf-8'),
+    ('rtf', 'application/rtf'),
+    ('files', 'text/uri-list; charset=utf-8'),
+])
 
 # Fix console encoding for Windows BEFORE setting up logging
 if sys.platform == 'win32':
@@ -48,73 +122,1824 @@ class SafeStreamHandler(logging.StreamHandler):
             record.msg = str(record.getMessage()).encode('ascii', 'replace').decode('ascii')
             super().emit(record)
 
+class JsonLineFormatter(logging.Formatter):
+    """One JSON record per line, for the spill GUI's log channel"""
+
+    def __init__(self, source):
+        super().__init__()
+        self.source = source
+
+    def format(self, record):
+        message = record.getMessage()
+        if record.exc_info:
+            message += '\n' + self.formatException(record.exc_info)
+        line = {'ts': round(record.created, 3), 'level': record.levelname.lower(),
+                'source': self.source, 'msg': message}
+        event = getattr(record, 'event', None)  # logging.info(..., extra={'event': 'ready'})
+        if event:
+            line['event'] = event
+        return json.dumps(line)
+
+console_handler = SafeStreamHandler()
+if os.environ.get('SPILL_LOG_JSON'):
+    console_handler.setFormatter(JsonLineFormatter('server'))
+
 logging.basicConfig(
     level=logging.INFO,
     format='%(asctime)s - %(levelname)s - %(message)s',
-    handlers=[
-        logging.FileHandler('server.log', encoding='utf-8'),
-        SafeStreamHandler()
-    ]
+    handlers=([] if EPHEMERAL_MB else [
+        logging.handlers.RotatingFileHandler('server.log', maxBytes=SERVER_LOG_MAX_BYTES, backupCount=1,
+                                             encoding='utf-8')
+    ]) + [console_handler]
 )
 
+class TraceRecorder:
+    """Per-clip stage spans in a fixed-size ring plus running per-stage
+    aggregates. Timestamps come from perf_counter_ns, which is system-wide
+    monotonic on Windows and Linux, so client and server spans line up when
+    both run on one machine."""
+
+    def __init__(self, capacity):
+        self.lock = threading.Lock()
+        self.spans = deque(maxlen=capacity)
+        self.stages = {}  # (process, stage) -> [count, total_ns, max_ns]
+
+    def record(self, trace_id, process, stage, start_ns, end_ns):
+        duration = max(0, end_ns - start_ns)
+        with self.lock:
+            self.spans.append((trace_id, process, stage, start_ns, duration))
+            agg = self.stages.get((process, stage))
+            if agg is None:
+                agg = self.stages[(process, stage)] = [0, 0, 0]
+            agg[0] += 1
+            agg[1] += duration
+            agg[2] = max(agg[2], duration)
+
+    def summary(self):
+        with self.lock:
+            return {
+                f'{process}.{stage}': {
+                    'count': count,
+                    'mean_ms': round(total / count / 1e6, 3),
+                    'max_ms': round(peak / 1e6, 3)
+                }
+                for (process, stage), (count, total, peak) in self.stages.items()
+            }
+
+    def chrome_trace(self):
+        """Spans as Chrome trace-event JSON (chrome://tracing, Perfetto)"""
+        with self.lock:
+            spans = list(self.spans)
+        pids = {'client': 1, 'server': 2}
+        events = [
+            {'name': 'process_name', 'ph': 'M', 'pid': pid, 'args': {'name': name}}
+            for name, pid in pids.items()
+        ]
+        for trace_id, process, stage, start_ns, duration in spans:
+            events.append({
+                'name': stage, 'cat': process, 'ph': 'X',
+                'ts': start_ns / 1000, 'dur': duration / 1000,
+                'pid': pids.get(process, 0), 'tid': 0,
+                'args': {'trace_id': trace_id}
+            })
+        return {'traceEvents': events, 'displayTimeUnit': 'ms'}
+
+trace_recorder = TraceRecorder(TRACE_CAPACITY)
+
+class HdrHistogram:
+    """Log-linear histogram of non-negative integers: 32 sub-buckets per
+    power of two, so every recorded value is reported within ~3%"""
+    SUB_BITS = 5
+    SUB_COUNT = 1 << SUB_BITS
+    MAGNITUDES = 40  # values up to 2^44
+
+    def __init__(self):
+        self.counts = [0] * (self.SUB_COUNT * self.MAGNITUDES)
+        self.count = 0
+        self.sum = 0
+
+    @classmethod
+    def index(cls, value):
+        if value < cls.SUB_COUNT:
+            return value
+        shift = value.bit_length() - cls.SUB_BITS - 1
+        index = cls.SUB_COUNT * (shift + 1) + (value >> shift) - cls.SUB_COUNT
+        return min(index, cls.SUB_COUNT * cls.MAGNITUDES - 1)
+
+    @classmethod
+    def value_at(cls, index):
+        """Upper edge of a bucket"""
+        if index < cls.SUB_COUNT:
+            return index
+        shift = index // cls.SUB_COUNT - 1
+        return ((index % cls.SUB_COUNT + cls.SUB_COUNT + 1) << shift) - 1
+
+    def record(self, value):
+        value = max(0, int(value))
+        self.counts[self.index(value)] += 1
+        self.count += 1
+        self.sum += value
+
+    def merge(self, counts, count, total):
+        """Adds a copy of another histogram's (counts, count, sum)"""
+        self.counts = [a + b for a, b in zip(self.counts, counts)]
+        self.count += count
+        self.sum += total
+
+    def quantile(self, q):
+        if not self.count:
+            return 0
+        rank = max(1, int(q * self.count + 0.5))
+        seen = 0
+        for i, n in enumerate(self.counts):
+            seen += n
+            if seen >= rank:
+                return self.value_at(i)
+        return self.value_at(len(self.counts) - 1)
+
+class MetricsShard:
+    """Counters and histograms of the threads assigned to this shard. Its
+    lock is only contended by those threads and, for a few list copies, a
+    scrape."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.counters = {}    # (name, labels) -> int
+        self.histograms = {}  # (name, labels) -> HdrHistogram
+
+class Metrics:
+    """Metrics in a fixed pool of SHARDS long-lived shards, merged on scrape.
+    werkzeug runs a thread per connection, so shards aren't per thread:
+    each new thread is handed the next shard round-robin, with no lock and
+    nothing to fold when it exits. Recording takes only its shard's lock;
+    a scrape copies each shard under that lock and merges the copies
+    outside it."""
+
+    QUANTILES = (0.5, 0.9, 0.99, 0.999)
+    SHARDS = 16  # about twice ADMIT_RUNNING, so running requests rarely share one
+
+    def __init__(self):
+        self.local = threading.local()
+        self.shards = [MetricsShard() for _ in range(self.SHARDS)]
+        self.assigned = itertools.count()  # next() is atomic under the GIL
+        self.inflight = set()  # idents of threads inside a request
+
+    def shard(self):
+        shard = getattr(self.local, 'shard', None)
+        if shard is None:
+            shard = self.local.shard = self.shards[next(self.assigned) % self.SHARDS]
+        return shard
+
+    def inc(self, name, labels=(), amount=1):
+        shard = self.shard()
+        key = (name, labels)
+        with shard.lock:
+            shard.counters[key] = shard.counters.get(key, 0) + amount
+
+    def observe(self, name, value, labels=()):
+        shard = self.shard()
+        key = (name, labels)
+        with shard.lock:
+            hist = shard.histograms.get(key)
+            if hist is None:
+                hist = shard.histograms[key] = HdrHistogram()
+            hist.record(value)
+
+    def snapshot(self):
+        merged = MetricsShard()
+        for shard in self.shards:
+            with shard.lock:
+                counters = list(shard.counters.items())
+                histograms = [(key, list(hist.counts), hist.count, hist.sum)
+                              for key, hist in shard.histograms.items()]
+            for key, value in counters:
+                merged.counters[key] = merged.counters.get(key, 0) + value
+            for key, counts, count, total in histograms:
+                hist = merged.histograms.get(key)
+                if hist is None:
+                    hist = merged.histograms[key] = HdrHistogram()
+                hist.merge(counts, count, total)
+        return merged
+
+    def prometheus(self, gauges):
+        """Prometheus text exposition; `gauges` is [(name, help, value)]"""
+        def fmt(labels, extra=()):
+            pairs = list(labels) + list(extra)
+            if not pairs:
+                return ''
+            return '{' + ','.join(f'{k}="{v}"' for k, v in pairs) + '}'
+
+        merged = self.snapshot()
+        lines = []
+        for name, help_text, value in gauges:
+            lines += [f'# HELP {name} {help_text}', f'# TYPE {name} gauge', f'{name} {value}']
+
+        names = sorted({name for name, _ in merged.counters})
+        for name in names:
+            lines += [f'# HELP {name} {METRIC_HELP.get(name, name)}', f'# TYPE {name} counter']
+            for (n, labels), value in sorted(merged.counters.items()):
+                if n == name:
+                    lines.append(f'{name}{fmt(labels)} {value}')
+
+        names = sorted({name for name, _ in merged.histograms})
+        for name in names:
+            lines += [f'# HELP {name} {METRIC_HELP.get(name, name)}', f'# TYPE {name} summary']
+            for (n, labels), hist in sorted(merged.histograms.items(), key=lambda item: item[0]):
+                if n != name:
+                    continue
+                for q in self.QUANTILES:
+                    lines.append(f'{name}{fmt(labels, [("quantile", q)])} {hist.quantile(q)}')
+                lines.append(f'{name}_sum{fmt(labels)} {hist.sum}')
+                lines.append(f'{name}_count{fmt(labels)} {hist.count}')
+        return '\n'.join(lines) + '\n'
+
+METRIC_HELP = {
+    'spill_requests_total': 'Requests handled, by endpoint and status',
+    'spill_request_latency_us': 'Request handling latency in microseconds',
+    'spill_commit_latency_us': 'Clip commit (log append) latency in microseconds',
+    'spill_payload_bytes': 'Clip request body size in bytes',
+    'spill_queue_depth': 'Requests in flight when a request arrives',
+    'spill_ring_clips_total': 'Clips received through the shared-memory ring',
+    'spill_unix_requests_total': 'Requests over the Unix socket, by peer uid',
+    'spill_search_candidates': 'Clips checked per search query',
+    'spill_redactions_total': 'Secrets found in clips, by kind and action (mask or drop)',
+    'spill_tls_handshakes_total': 'TLS handshakes on port 8000, by result (full, resumed or failed) and version',
+    'spill_tls_handshake_us': 'TLS handshake time in microseconds, by result',
+    'spill_rate_limited_total': 'Requests and ring clips turned away by a token bucket, by scope (user or global) and source',
+    'spill_shed_total': 'Requests turned away (503) after waiting for a turn too long, by endpoint',
+    'spill_retention_dropped_total': 'Clips removed by retention, by reason (age, count, bytes or cleared)',
+    'spill_compaction_us': 'Clip log rewrite time in microseconds',
+    'spill_compacted_bytes_total': 'Bytes the compactor reclaimed from the clip log',
+    'spill_trace_dropped_total': 'Malformed or unknown client trace stages dropped',
+}
+
+metrics = Metrics()
+
+class TrafficCapture:
+    """Content-redacted request log for the replay tool: arrival time, user,
+    sizes and a short hash of each payload, never the payload itself"""
+
+    def __init__(self, path):
+        self.lock = threading.Lock()
+        self.file = open(path, 'a', encoding='utf-8', buffering=1 << 16)
+        self.last_flush = time.monotonic()
+        self.write({'capture': 'spill', 'version': 1, 'started': datetime.now().isoformat()})
+
+    def write(self, record):
+        line = json.dumps(record, separators=(',', ':'), ensure_ascii=False) + '\n'
+        with self.lock:
+            self.file.write(line)
+            now = time.monotonic()
+            if now - self.last_flush >= 1:
+                self.file.flush()
+                self.last_flush = now
+
+    def flush(self):
+        with self.lock:
+            self.file.flush()
+
+    @staticmethod
+    def query_hashed(args):
+        """The query string with every value outside CAPTURE_QUERY_KEPT
+        (search text, for one) replaced by a short hash of it"""
+        pairs = [(key, value if key in CAPTURE_QUERY_KEPT
+                  else 'h-' + hashlib.blake2b(value.encode('utf-8', 'surrogatepass'), digest_size=8).hexdigest())
+                 for key, value in args.items(multi=True)]
+        return urlencode(pairs)
+
+    def record(self, arrived_us, response):
+        path = request.path
+        if request.args:
+            path += '?' + self.query_hashed(request.args)
+        entry = {
+            't_us': arrived_us,
+            'method': request.method,
+            'path': path,
+            'user': (request.view_args or {}).get('user_id'),
+            'bytes': request.content_length or 0,
+            'status': response.status_code,
+        }
+        if request.method == 'POST' and request.endpoint == 'receive_clipboard':
+            data = request.get_json(silent=True) or {}
+            content = data.get('content', '').encode('utf-8', 'surrogatepass')
+            entry['content_bytes'] = len(content)
+            entry['hash'] = hashlib.blake2b(content, digest_size=8).hexdigest()
+            entry['formats'] = data.get('formats', [])
+            entry['number'] = getattr(g, 'broadcast_number', None)
+        elif request.method == 'PUT':
+            entry['hash'] = hashlib.blake2b(request.get_data(), digest_size=8).hexdigest()
+        self.write(entry)
+
+traffic_capture = TrafficCapture(CAPTURE_FILE) if CAPTURE_FILE and not EPHEMERAL_MB else None
+if traffic_capture:
+    atexit.register(traffic_capture.flush)
+
+class TokenBucket:
+    """`rate` tokens a second, holding at most `burst`"""
+
+    __slots__ = ('rate', 'burst', 'tokens', 'stamp')
+
+    def __init__(self, rate, burst, now):
+        self.rate, self.burst, self.tokens, self.stamp = rate, burst, burst, now
+
+    def refill(self, now):
+        self.tokens = min(self.burst, self.tokens + (now - self.stamp) * self.rate)
+        self.stamp = now
+
+    def wait_for(self, cost):
+        """Seconds until `cost` tokens are there; 0 if they are now"""
+        return max(0.0, (min(cost, self.burst) - self.tokens) / self.rate)
+
+    def spend(self, cost):
+        self.tokens -= min(cost, self.burst)
+
+# Last in line for a turn under overload, with large bodies
+LOW_PRIORITY_ENDPOINTS = {'get_user_logs', 'search_clips', 'get_trace', 'get_trace_stats',
+                          'get_stats', 'home'}
+UNGATED_ENDPOINTS = {'healthz', 'get_metrics', 'whoami', 'get_profile'}  # never wait for a turn
+UNLIMITED_ENDPOINTS = {'healthz', 'get_metrics'}  # and never rate limited
+
+class AdmissionControl:
+    """Decides whether a request runs before its body is read. Token
+    buckets per user and for the whole server turn floods away with 429.
+    Past that, only ADMIT_RUNNING requests run at once: more threads would
+    only take turns on the GIL and make every request slow. The others wait
+    for a turn, small clips before other requests before low-priority work
+    (log queries, search, large bodies), and a request whose wait runs out gets
+    503, so under overload the low-priority work is shed first."""
+
+    PRUNE_AT = 10000  # User buckets kept before the full (idle) ones are dropped
+    CLIP, NORMAL, LOW = range(3)  # priorities, best first
+
+    def __init__(self, user_rate, user_burst, global_rate, global_burst):
+        self.lock = threading.Lock()
+        self.user_rate, self.user_burst = user_rate, user_burst
+        self.users = {}  # user_id -> TokenBucket
+        self.server = TokenBucket(global_rate, global_burst, time.monotonic()) if global_rate > 0 else None
+        self.turn_free = threading.Condition()
+        self.running = 0
+        self.waiting = [0, 0, 0]  # by priority
+
+    @staticmethod
+    def cost(length):
+        return 1 + (length or 0) // RATE_BYTES_PER_TOKEN
+
+    def limit(self, user_id, cost):
+        """None when the request may go ahead (its tokens are spent), else
+        (scope, seconds until it would be let in)"""
+        now = time.monotonic()
+        with self.lock:
+            bucket = None
+            if user_id is not None and self.user_rate > 0:
+                bucket = self.users.get(user_id)
+                if bucket is None:
+                    if len(self.users) >= self.PRUNE_AT:
+                        self.prune(now)
+                    bucket = self.users[user_id] = TokenBucket(self.user_rate, self.user_burst, now)
+                bucket.refill(now)
+                wait = bucket.wait_for(cost)
+                if wait:
+                    return 'user', wait
+            if self.server:
+                self.server.refill(now)
+                wait = self.server.wait_for(cost)
+                if wait:
+                    return 'global', wait
+                self.server.spend(cost)
+            if bucket:
+                bucket.spend(cost)
+        return None
+
+    def prune(self, now):
+        # A bucket that has refilled to its burst is the same as a new one
+        self.users = {user_id: bucket for user_id, bucket in self.users.items()
+                      if bucket.tokens + (now - bucket.stamp) * bucket.rate < bucket.burst}
+
+    def priority(self, endpoint, length):
+        if endpoint in LOW_PRIORITY_ENDPOINTS or (length or 0) > SHED_LARGE_BODY:
+            return self.LOW
+        # A small clip is what a user waits on; a bulky one can wait its turn
+        if endpoint == 'receive_clipboard' and (length or 0) <= RATE_BYTES_PER_TOKEN:
+            return self.CLIP
+        return self.NORMAL
+
+    def enter(self, priority):
+        """Waits for a turn, behind anyone waiting with a better priority;
+        False if none came within ADMIT_WAIT[priority]"""
+        deadline = time.monotonic() + ADMIT_WAIT[priority]
+        with self.turn_free:
+            self.waiting[priority] += 1
+            try:
+                while self.running >= ADMIT_RUNNING or any(self.waiting[:priority]):
+                    remaining = deadline - time.monotonic()
+                    if remaining <= 0:
+                        self.turn_free.notify_all()  # those behind us may go now
+                        return False
+                    self.turn_free.wait(remaining)
+                self.running += 1
+                return True
+            finally:
+                self.waiting[priority] -= 1
+
+    def leave(self):
+        with self.turn_free:
+            self.running -= 1
+            self.turn_free.notify_all()
+
+admission = AdmissionControl(RATE_USER, RATE_USER_BURST, RATE_GLOBAL, RATE_GLOBAL_BURST)
+
+def turned_away(status, error, wait):
+    """Small 429/503 answer; Retry-After in whole seconds"""
+    retry = max(1, math.ceil(wait))
+    return Response(json.dumps({'error': error, 'retry_after': retry}), status=status,
+                    content_type='application/json', headers={'Retry-After': str(retry)})
+
+class StackSampler:
+    """On-demand sampling profiler behind /profile. Nothing runs between
+    profiles: the requesting thread itself snapshots every other thread's
+    Python stack at a fixed rate and counts folded stacks.
+
+    Stacks ending in a blocking call are dropped, and where threads have CPU
+    clocks (Linux, macOS) so are threads that used no CPU since the previous
+    sample, so the profile shows where time is burned rather than where
+    threads wait. CPU clocks are read once before the first sample; a thread
+    started after that counts from zero, so a request thread that lives for
+    less than one interval still shows up."""
+
+    IDLE_LEAVES = {'wait', 'select', 'poll', 'accept', 'sleep', 'readinto', 'recv_into',
+                   '_wait_for_tstate_lock', 'serve_forever'}
+
+    def __init__(self):
+        self.busy = threading.Lock()
+
+    @staticmethod
+    def fold(frame):
+        names = []
+        while frame is not None:
+            code = frame.f_code
+            names.append(f'{code.co_name} ({os.path.basename(code.co_filename)}:{code.co_firstlineno})')
+            frame = frame.f_back
+        return ';'.join(reversed(names))
+
+    @staticmethod
+    def cpu_ns(ident):
+        try:
+            return time.clock_gettime_ns(time.pthread_getcpuclockid(ident))
+        except (AttributeError, OSError):
+            return None
+
+    def running(self, ident, frame, cpu_seen):
+        """Whether a thread is doing work rather than waiting"""
+        cpu = self.cpu_ns(ident)
+        previous = cpu_seen.get(ident, 0)  # not seen before: started during the profile
+        cpu_seen[ident] = cpu
+        # A lower clock than last time is a new thread that reused the ident
+        if cpu is not None and cpu == previous:
+            return False
+        return frame.f_code.co_name not in self.IDLE_LEAVES
+
+    def profile(self, seconds, hz, include_idle=False):
+        """Samples for `seconds`; returns (Counter of folded stacks, samples
+        taken), or None if another profile is already running"""
+        if not self.busy.acquire(blocking=False):
+            return None
+        try:
+            me = threading.get_ident()
+            counts = Counter()
+            cpu_seen = {ident: self.cpu_ns(ident) for ident in sys._current_frames()}
+            interval = 1.0 / hz
+            deadline = time.monotonic() + seconds
+            tick = time.monotonic()
+            samples = 0
+            while tick < deadline:
+                for ident, frame in sys._current_frames().items():
+                    if ident == me:
+                        continue
+                    if include_idle or self.running(ident, frame, cpu_seen):
+                        counts[self.fold(frame)] += 1
+                samples += 1
+                tick += interval
+                delay = tick - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+            return counts, samples
+        finally:
+            self.busy.release()
+
+stack_sampler = StackSampler()
+
+SERVER_STARTED = datetime.now()
+SERVER_STARTED_MONOTONIC = time.monotonic()
+
+# Records are written by ClipStore with these two keys first
+RECORD_USER_RE = re.compile(rb'\{"broadcast_number":\d+,"user_id":("(?:[^"\\]|\\.)*")')
+# Only the real key is followed by an unescaped quote; inside a string it would be \"
+RECORD_TIME_RE = re.compile(rb'"server_timestamp":"([^"]*)"')
+# Characters whose casefold() has ASCII in it (ß -> ss, Kelvin sign -> k, ligatures);
+# anywhere else, ASCII text folds the same way with bytes.lower()
+ASCII_FOLDING_CHARS = '\u00df\u0130\u0149\u017f\u01f0\u1e96\u1e97\u1e98\u1e99\u1e9a\u1e9e\u212a' \
+                      '\ufb00\ufb01\ufb02\ufb03\ufb04\ufb05\ufb06'
+
+def open_shared_region(name, size):
+    """Named shared memory of `size` bytes: a pagefile-backed mapping on
+    Windows, a file under /dev/shm (or the temp dir) elsewhere. Returns the
+    mmap and the file to remove afterwards, if any."""
+    if sys.platform == 'win32':
+        return mmap.mmap(-1, size, tagname='Local\\' + name), None
+    base = '/dev/shm' if os.path.isdir('/dev/shm') else tempfile.gettempdir()
+    path = os.path.join(base, name)
+    fd = os.open(path, os.O_RDWR | os.O_CREAT | os.O_TRUNC, 0o600)
+    try:
+        os.ftruncate(fd, size)
+        return mmap.mmap(fd, size), path
+    finally:
+        os.close(fd)
+
+def ring_ordered_cpu():
+    """True on x86/x64, whose stores become visible in the order they were
+    made: the one guarantee the Python ends of the clip ring rely on"""
+    return platform.machine().lower() in ('x86_64', 'amd64', 'x86', 'i386', 'i686')
+
+class RingDoorbell:
+    """What the ring's consumer sleeps on: a named auto-reset event on
+    Windows, a FIFO elsewhere"""
+
+    def __init__(self, name):
+        self.path = None
+        if sys.platform == 'win32':
+            import win32event
+            self.event = win32event.CreateEvent(None, False, False, 'Local\\' + name + '-doorbell')
+            return
+        self.path = os.path.join(tempfile.gettempdir(), name + '.doorbell')
+        if os.path.exists(self.path):
+            os.unlink(self.path)
+        os.mkfifo(self.path, 0o600)
+        self.fd = os.open(self.path, os.O_RDONLY | os.O_NONBLOCK)
+        # Keep a writer open, or select() reports EOF whenever the client has none
+        self.keepalive = os.open(self.path, os.O_WRONLY | os.O_NONBLOCK)
+
+    def wait(self, timeout):
+        if self.path is None:
+            import win32event
+            win32event.WaitForSingleObject(self.event, int(timeout * 1000))
+            return
+        if select.select([self.fd], [], [], timeout)[0]:
+            try:
+                os.read(self.fd, 4096)
+            except BlockingIOError:
+                pass
+
+    def close(self):
+        if self.path is not None:
+            os.close(self.fd)
+            os.close(self.keepalive)
+            os.unlink(self.path)
+
+class ClipRing:
+    """Consumer end of the shared-memory clip ring (layout in shm_ring.h).
+    A local client writes the JSON it would otherwise POST; each record is
+    decoded straight out of the mapping and takes the same path as an HTTP
+    clip. Both ends are CPython, which has no fences: a record is only
+    complete when head says so because x86/x64 make stores visible in
+    program order, so the ring is only set up on those CPUs (see
+    ring_ordered_cpu). The bounded wait covers a missed signal."""
+
+    MAGIC = 0x47525053
+    VERSION = 1
+    HEADER = 192
+    HEAD, REFUSED, TAIL, SLEEPING = 8, 9, 16, 17  # 64-bit word indexes
+    WRAP = 0xFFFFFFFF
+    WAIT_SECONDS = 0.5
+
+    def __init__(self, name, capacity):
+        self.name = name
+        self.capacity = capacity
+        self.region, self.path = open_shared_region(name, self.HEADER + capacity)
+        view = memoryview(self.region)
+        self.words = view[:self.HEADER].cast('Q')
+        self.data = view[self.HEADER:]
+        self.doorbell = RingDoorbell(name)
+        for i in range(len(self.words)):
+            self.words[i] = 0
+        self.words[1] = capacity
+        self.words[0] = self.MAGIC | self.VERSION << 32  # last: the ring is ready
+
+    def refused(self):
+        """Clips the client had to send over HTTP because the ring was full"""
+        return self.words[self.REFUSED]
+
+    def drain(self, handle):
+        """handle(memoryview) for each waiting record; the views point into
+        the ring and are only valid during the call"""
+        words = self.words
+        tail, head = words[self.TAIL], words[self.HEAD]
+        mask = self.capacity - 1
+        while tail != head:
+            offset = tail & mask
+            length = int.from_bytes(self.data[offset:offset + 4], 'little')
+            if length == self.WRAP:
+                tail += self.capacity - offset
+                continue
+            if length > self.capacity // 2 - 4:
+                logging.error("Clip ring holds a bad record; dropping what is queued")
+                tail = head
+                break
+            handle(self.data[offset + 4:offset + 4 + length])
+            tail += (length + 11) & ~7
+        words[self.TAIL] = tail
+
+    def run(self, handle):
+        words = self.words
+        while True:
+            self.drain(handle)
+            words[self.SLEEPING] = 1
+            if words[self.HEAD] == words[self.TAIL]:
+                self.doorbell.wait(self.WAIT_SECONDS)
+            words[self.SLEEPING] = 0
+
+    def close(self):
+        self.doorbell.close()
+        if self.path:
+            os.unlink(self.path)
+
+clip_ring = None  # set in __main__ when the GUI names a ring
+unix_server = None  # set in __main__ where Unix sockets carry peer credentials
+tls_context = None  # set in __main__ when there is a certificate
+
+def searchable_text(record):
+    """What search sees of a clip record: its first SEARCH_INDEX_CHARS
+    characters, and nothing of a sealed one. The index and the final check
+    both go by this, so a clip matches the same whether it has been
+    indexed yet or not."""
+    return '' if record.get('sealed') else record.get('content', '')[:SEARCH_INDEX_CHARS]
+
+class SearchIndex:
+    """Trigram index over each user's clips, for /<user_id>/search. A posting
+    list holds a user's clip positions (see ClipStore) in commit order, so
+    intersecting lists is a bisect per candidate, newest first. Trigrams
+    only narrow the field: each candidate is checked against its record.
+
+    Commits are indexed as they happen. Clips loaded from an existing log are
+    indexed by a background thread in batches; until it catches up, clips it
+    hasn't reached are scanned instead, so answers stay complete."""
+
+    BATCH = 512
+    TRIM_CHUNK = 4096  # Trigrams expire() trims per turn of the lock
+    EMPTY = array('I')
+    # Estimated cost of one distinct trigram: key, array header, dict slot
+    TRIGRAM_BYTES = sys.getsizeof('abc') + sys.getsizeof(array('I')) + 24
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.users = {}    # user_id -> {trigram: array('I') of positions}
+        self.indexed = {}  # user_id -> position up to which clips are indexed
+        self.floor = {}    # user_id -> position its postings were last trimmed to
+        self.generation = 0  # bumped by clear(), so a stale backfill batch is dropped
+        self.postings = 0
+        self.trigrams = 0
+
+    @staticmethod
+    def grams(text):
+        text = text[:SEARCH_INDEX_CHARS].casefold()
+        return {text[i:i + 3] for i in range(len(text) - 2)}
+
+    def memory_bytes(self):
+        return self.postings * 4 + self.trigrams * self.TRIGRAM_BYTES
+
+    def add(self, user_id, position, content):
+        """A clip just committed at `position`; left to the backfill thread
+        if that hasn't reached this user's newest clips yet"""
+        with self.lock:
+            if self.indexed.get(user_id, 0) == position:
+                self.insert(user_id, position, content)
+
+    def insert(self, user_id, position, content):
+        postings = self.users.setdefault(user_id, {})
+        grams = self.grams(content)
+        for gram in grams:
+            positions = postings.get(gram)
+            if positions is None:
+                positions = postings[gram] = array('I')
+                self.trigrams += 1
+            positions.append(position)
+        self.postings += len(grams)
+        self.indexed[user_id] = position + 1
+
+    def backfill(self, store):
+        """Indexes what the store loaded at startup, a batch at a time"""
+        for user_id in list(store.index):
+            while True:
+                with self.lock:
+                    start, generation = self.indexed.get(user_id, 0), self.generation
+                first, records = store.slice(user_id, start, self.BATCH)
+                if not records:
+                    break
+                contents = [searchable_text(json.loads(bytes(record))) for record in records]
+                with self.lock:
+                    if self.generation != generation:
+                        break
+                    if self.indexed.get(user_id, 0) != start:
+                        continue  # retention moved past this batch
+                    for i, content in enumerate(contents):
+                        self.insert(user_id, first + i, content)
+        logging.info(f"Search index ready: {sum(len(entries) for entries in list(store.index.values()))} clips, "
+                     f"{self.trigrams} trigrams, ~{self.memory_bytes() // 1024} KB")
+
+    def candidates(self, user_id, needle, total):
+        """Runs of positions (start, stop) that may contain needle, newest
+        first: whole ranges where the index can't help, single clips where
+        it can"""
+        with self.lock:
+            indexed = min(self.indexed.get(user_id, 0), total)
+            postings = self.users.get(user_id, {})
+            grams = self.grams(needle)
+            # Snapshot the lengths; lists only grow, and clear() swaps them out
+            lists = sorted(((postings.get(gram, self.EMPTY), len(postings.get(gram, self.EMPTY)))
+                            for gram in grams), key=lambda item: item[1])
+        if indexed < total:
+            yield indexed, total  # not indexed yet
+        if not lists:
+            if indexed:
+                yield 0, indexed  # under three characters
+            return
+        rarest, count = lists[0]
+        others = lists[1:]
+        for i in range(count - 1, -1, -1):
+            position = rarest[i]
+            if position >= indexed:
+                continue  # scanned above
+            for positions, length in others:
+                j = bisect_left(positions, position, 0, length)
+                if j == length or positions[j] != position:
+                    break
+            else:
+                yield position, position + 1
+
+    def expire(self, user_id, base):
+        """Drops a user's postings below position base, which retention
+        removed. That walks all of the user's trigrams, so it waits until
+        at least half the positions indexed are gone (queries skip the rest
+        meanwhile), and takes the lock a chunk of trigrams at a time so
+        commits aren't held up. Trimmed lists are swapped in, like clear()
+        does, so a query holding the old ones stays consistent."""
+        with self.lock:
+            if user_id in self.indexed and self.indexed[user_id] < base:
+                self.indexed[user_id] = base  # nothing below base left to index
+            floor = self.floor.get(user_id, 0)
+            if base - floor < self.indexed.get(user_id, 0) - base:
+                return
+            self.floor[user_id] = base
+            postings = self.users.get(user_id)
+            grams = list(postings) if postings else []
+        for i in range(0, len(grams), self.TRIM_CHUNK):
+            with self.lock:
+                if self.users.get(user_id) is not postings:
+                    return  # forgotten or cleared meanwhile
+                self.trim(postings, grams[i:i + self.TRIM_CHUNK], base)
+
+    def trim(self, postings, grams, base):
+        for gram in grams:
+            positions = postings.get(gram, self.EMPTY)
+            j = bisect_left(positions, base)
+            if not j:
+                continue
+            if j == len(positions):
+                del postings[gram]
+                self.trigrams -= 1
+            else:
+                postings[gram] = positions[j:]
+            self.postings -= j
+
+    def forget(self, user_id):
+        with self.lock:
+            postings = self.users.pop(user_id, {})
+            self.indexed.pop(user_id, None)
+            self.floor.pop(user_id, None)
+            self.trigrams -= len(postings)
+            self.postings -= sum(len(positions) for positions in postings.values())
+
+    def clear(self):
+        with self.lock:
+            self.users = {}
+            self.indexed = {}
+            self.floor = {}
+            self.generation += 1
+            self.postings = 0
+            self.trigrams = 0
+
+class ClipTooLarge(ValueError):
+    """A clip whose record the ephemeral arena could never hold (over half
+    of it); answered with 413"""
+
+    def __init__(self, limit):
+        super().__init__(f'Clips over {limit} bytes do not fit the memory budget')
+
+class ClipArena:
+    """Ephemeral mode's clip log: one preallocated anonymous mapping, never
+    backed by a file, written as a ring. Offsets are logical (bytes written
+    since start), so an offset names one write for good; it lives at offset
+    % capacity, and a record never straddles the end. Anything below
+    `reclaimed` may have been overwritten, so a reader copies a record and
+    then checks its offset against it; the copy and the writer's store each
+    happen in one piece under the GIL."""
+
+    def __init__(self, capacity):
+        self.capacity = capacity
+        self.memory = mmap.mmap(-1, capacity)
+        for i in range(0, capacity, mmap.PAGESIZE):
+            self.memory[i] = 0  # commit every page now: the budget is what the process holds
+        self.view = memoryview(self.memory)
+        self.head = 0       # logical offset of the next write
+        self.reclaimed = 0  # logical offset below which bytes may be overwritten
+
+    def __getitem__(self, span):
+        """A copy of logical offsets span.start .. span.stop"""
+        start = span.start % self.capacity
+        return bytes(self.view[start:start + span.stop - span.start])
+
+    def place(self, length):
+        """Logical offset for a record of `length` bytes: the next lap if it
+        would run past the end of this one"""
+        used = self.head % self.capacity
+        return self.head if used + length <= self.capacity else self.head + self.capacity - used
+
+    def write(self, start, data):
+        physical = start % self.capacity
+        self.view[physical:physical + len(data)] = data
+        self.head = start + len(data)
+
+class ClipStore:
+    """Append-only JSON-lines clip log, indexed per user by (offset, length,
+    time) and served straight out of a read-only memory map of the file, or
+    in ephemeral mode out of a ClipArena, oldest records evicted to make room.
+
+    Retention takes a user's oldest clips out of the index; the compactor
+    rewrites the file without them later. A clip's position counts every
+    clip its user stored, dropped ones included, so entry i of a user is at
+    position base + i and dropping clips renumbers nothing the search index
+    holds. Index lists are replaced, never shortened in place, so a reader
+    holding one keeps a consistent view."""
+
+    def __init__(self, path, arena_bytes=0):
+        self.path = path
+        self.arena = ClipArena(arena_bytes) if arena_bytes else None
+        self.lock = threading.Lock()
+        self.index = {}       # user_id -> [(offset, length, unix time), ...]
+        self.base = {}        # user_id -> position of its first entry
+        self.user_bytes = {}  # user_id -> bytes of its indexed records
+        self.size = 0
+        self.live = 0         # bytes of indexed records; the rest of the file is dead
+        self.generation = 0   # bumped by clear(), so a rewrite in progress is dropped
+        self.map = None
+        self.evicted = set()  # arena: users eviction left with no clips, for the compactor to pass on
+        self.untrimmed = {}   # arena: user_id -> base its search postings are yet to be trimmed to
+        self.search_index = SearchIndex()
+        if not self.arena:
+            self.migrate(LEGACY_JSON_LOG_FILE)
+            self.load()
+        # Before the backfill, so it doesn't index what retention drops anyway
+        dropped, _ = self.expire(time.time())
+        for reason, count in dropped.items():
+            metrics.inc('spill_retention_dropped_total', (('reason', reason),), count)
+        if self.index:
+            threading.Thread(target=self.search_index.backfill, args=(self,), name='search-backfill',
+                             daemon=True).start()
+
+    def migrate(self, legacy):
+        """Moves the clips of a clipboard_log.json left by an older version
+        in front of the records already in the log (they are older), then
+        renames it to .migrated so it is read only once"""
+        if not os.path.exists(legacy):
+            return
+        try:
+            with open(legacy, 'r', encoding='utf-8') as f:
+                broadcasts = json.load(f).get('broadcasts', [])
+        except (OSError, ValueError, AttributeError) as e:
+            logging.error(f"Could not migrate {legacy}, left in place: {e}")
+            return
+        temp = self.path + '.migrating'
+        with open(temp, 'wb') as out:
+            for entry in broadcasts:
+                if not isinstance(entry, dict) or 'user_id' not in entry:
+                    continue
+                # The leading keys are what load() matches on
+                record = {'broadcast_number': int(entry.get('broadcast_number') or 0),
+                          'user_id': str(entry['user_id'])}
+                record.update((k, v) for k, v in entry.items() if k not in record)
+                out.write(json.dumps(record, ensure_ascii=False, separators=(',', ':')).encode('utf-8') + b'\n')
+            if os.path.exists(self.path):
+                with open(self.path, 'rb') as f:
+                    shutil.copyfileobj(f, out)
+        os.replace(temp, self.path)
+        os.replace(legacy, legacy + '.migrated')
+        logging.info(f"Migrated {len(broadcasts)} clips from {legacy} to {self.path}")
+
+    def load(self):
+        """Rebuild the index from an existing log without decoding contents"""
+        if not os.path.exists(self.path):
+            return
+        offset = 0
+        written = os.path.getmtime(self.path)  # for records without a readable time
+        with open(self.path, 'rb') as f:
+            for line in f:
+                match = RECORD_USER_RE.match(line)
+                if match:
+                    user_id = json.loads(match.group(1))
+                    length = len(line.rstrip(b'\n'))
+                    self.index.setdefault(user_id, []).append((offset, length, self.record_time(line, written)))
+                    self.user_bytes[user_id] = self.user_bytes.get(user_id, 0) + length + 1
+                    self.live += length + 1
+                offset += len(line)
+        self.size = offset
+
+    @staticmethod
+    def record_time(line, default):
+        match = RECORD_TIME_RE.search(line)
+        try:
+            return datetime.fromisoformat(match.group(1).decode('ascii')).timestamp()
+        except (AttributeError, UnicodeDecodeError, ValueError):
+            return default
+
+    def encode(self, entry):
+        """The record stored for entry; ClipTooLarge if the arena can't take it"""
+        record = json.dumps(entry, ensure_ascii=False, separators=(',', ':')).encode('utf-8')
+        if self.arena and len(record) + 1 > self.arena.capacity // 2:
+            raise ClipTooLarge(self.arena.capacity // 2)
+        return record
+
+    def append(self, user_id, entry, record=None):
+        """Stores entry, or its record as encode() made it"""
+        if record is None:
+            record = self.encode(entry)
+        with self.lock:
+            if self.arena:
+                offset = self.write_arena(record)
+            else:
+                with open(self.path, 'ab') as f:
+                    f.write(record + b'\n')
+                offset = self.size
+                self.size += len(record) + 1
+            entries = self.index.setdefault(user_id, [])
+            entries.append((offset, len(record), time.time()))
+            position = self.base.get(user_id, 0) + len(entries) - 1
+            self.live += len(record) + 1
+            self.user_bytes[user_id] = self.user_bytes.get(user_id, 0) + len(record) + 1
+        self.search_index.add(user_id, position, searchable_text(entry))
+        return record, offset
+
+    def write_arena(self, record):
+        """Stores a record in the arena, first evicting the oldest records
+        in its way (and then some, so most appends evict nothing). Trimming
+        the search postings walks every trigram of a user, so that is left
+        to the compactor; searches skip evicted positions meanwhile."""
+        arena = self.arena
+        length = len(record) + 1  # at most half the arena (see encode)
+        start = arena.place(length)
+        if start + length - arena.capacity > arena.reclaimed:
+            limit = start + length - arena.capacity + arena.capacity // ARENA_EVICT_SHARE
+            arena.reclaimed = limit  # before any byte below it is overwritten
+            trimmed, emptied = [], []
+            evicted = 0
+            for user_id, entries in self.index.items():
+                keep = freed = 0
+                while keep < len(entries) and entries[keep][0] < limit:
+                    freed += entries[keep][1] + 1
+                    keep += 1
+                evicted += keep
+                self.drop_oldest(user_id, entries, keep, freed, trimmed, emptied)
+            self.forget_emptied(emptied)
+            self.evicted.update(emptied)
+            self.untrimmed.update(trimmed)
+            metrics.inc('spill_retention_dropped_total', (('reason', 'evicted'),), evicted)
+            compactor.wake()
+        arena.write(start, record + b'\n')
+        return start
+
+    def view(self):
+        return self.arena if self.arena else memoryview(self.mapping())
+
+    def content_at(self, offset, length):
+        """Arena: the content of the record at offset as UTF-8, or None once
+        it has been evicted"""
+        record = self.arena[offset:offset + length]
+        if offset < self.arena.reclaimed:
+            return None
+        return json.loads(record)['content'].encode('utf-8')
+
+    def mapping(self):
+        """Current map of the log, remapped once the file has grown past it"""
+        if self.map is None or len(self.map) < self.size:
+            with open(self.path, 'rb') as f:
+                self.map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        return self.map
+
+    def records(self, user_id, limit):
+        """(total, [record bytes]) for a user's most recent records"""
+        with self.lock:
+            entries = self.index.get(user_id, [])
+            if not entries:
+                return 0, []
+            view = self.view()
+            return len(entries), [view[o:o + n] for o, n, _ in entries[-limit:]]
+
+    def slice(self, user_id, start, count):
+        """(first position, record views) for up to count of a user's clips
+        from position start, or from the oldest kept if that is later"""
+        with self.lock:
+            base = self.base.get(user_id, 0)
+            first = max(start, base)
+            entries = self.index.get(user_id, [])[first - base:first - base + count]
+            if not entries:
+                return first, []
+            view = self.view()
+            return first, [view[o:o + n] for o, n, _ in entries]
+
+    @staticmethod
+    def scan_block(view, entries, start, stop, key):
+        """Positions in start .. stop whose record contains key (the needle
+        as lower-case ASCII bytes), newest first, from one lower() and
+        find() pass over the records instead of one decode per clip. None
+        where that isn't exact or isn't cheaper: the block has characters
+        that casefold() turns into ASCII (ß -> ss), or other users' records
+        make up most of it."""
+        first = entries[start][0]
+        last_offset, last_length, _ = entries[stop - 1]
+        end = last_offset + last_length
+        if end - first > 2 * sum(length + 1 for _, length, _ in entries[start:stop]):
+            return None
+        block = bytes(view[first:end])
+        if not block.isascii():
+            text = str(block, 'utf-8')
+            if any(c in text for c in ASCII_FOLDING_CHARS):
+                return None
+        block = block.lower()
+        starts = [offset - first for offset, _, _ in entries[start:stop]]
+        hits = []
+        i = block.find(key)
+        while i >= 0:
+            k = bisect_right(starts, i) - 1
+            record_end = starts[k] + entries[start + k][1] if k >= 0 else 0
+            if i + len(key) <= record_end:
+                hits.append(start + k)
+                i = block.find(key, record_end)
+            else:
+                i = block.find(key, i + 1)  # in another user's record
+        hits.reverse()
+        return hits
+
+    def search(self, user_id, query, limit):
+        """(clips, [record views], complete) for a user's newest clips that
+        contain query, ignoring case"""
+        needle = query.casefold()
+        with self.lock:
+            entries = self.index.get(user_id, [])
+            base = self.base.get(user_id, 0)
+            total = len(entries)
+            view = self.view() if total else None
+        # Content appears verbatim in its JSON record unless the needle has
+        # characters JSON escapes, so the raw line rules most candidates out
+        # without decoding it
+        raw_check = needle.isprintable() and '"' not in needle and '\\' not in needle
+        key = needle.encode('ascii') if raw_check and needle.isascii() else None
+        matches = []
+        checked = 0
+        complete = True
+
+        def positions():
+            """(position, still needs the raw check) for candidates, newest
+            first; runs the index can't narrow go through scan_block"""
+            nonlocal checked, complete
+            for start, stop in self.search_index.candidates(user_id, needle, base + total):
+                start, stop = max(start, base) - base, stop - base  # positions to entries
+                while stop > start:
+                    low = max(start, stop - SEARCH_SCAN_BLOCK)
+                    hits = None
+                    if key and stop - low > 1 and checked + stop - low <= SEARCH_SCAN_BUDGET and not self.arena:
+                        hits = self.scan_block(view, entries, low, stop, key)
+                    if hits is None:
+                        for position in range(stop - 1, low - 1, -1):
+                            if checked == SEARCH_SCAN_BUDGET:
+                                complete = False
+                                return
+                            checked += 1
+                            yield position, raw_check
+                    else:
+                        checked += stop - low
+                        for position in hits:
+                            yield position, False
+                    stop = low
+
+        for position, prefilter in positions():
+            offset, length, _ = entries[position]
+            record = view[offset:offset + length]
+            if self.arena and offset < self.arena.reclaimed:
+                continue  # evicted, and maybe overwritten, since the snapshot
+            text = str(record, 'utf-8')
+            if prefilter and needle not in text.casefold():
+                continue
+            if needle in searchable_text(json.loads(text)).casefold():
+                matches.append(record)
+                if len(matches) == limit:
+                    break
+        metrics.observe('spill_search_candidates', checked)
+        return total, matches, complete
+
+    def expire(self, now):
+        """Takes clips past RETAIN_AGE, RETAIN_CLIPS or RETAIN_BYTES out of
+        the index, oldest first. Returns ({reason: clips}, users left with
+        none, by this or by arena eviction since the last call)."""
+        cutoff = now - RETAIN_AGE if RETAIN_AGE > 0 else None
+        dropped = Counter()
+        emptied = []
+        with self.lock:
+            evicted, self.evicted = self.evicted, set()
+            trimmed, self.untrimmed = list(self.untrimmed.items()), {}
+            for user_id, entries in self.index.items():
+                keep = freed = 0
+                while cutoff is not None and keep < len(entries) and entries[keep][2] < cutoff:
+                    freed += entries[keep][1] + 1
+                    keep += 1
+                dropped['age'] += keep
+                if RETAIN_CLIPS > 0 and len(entries) - keep > RETAIN_CLIPS:
+                    dropped['count'] += len(entries) - keep - RETAIN_CLIPS
+                    while len(entries) - keep > RETAIN_CLIPS:
+                        freed += entries[keep][1] + 1
+                        keep += 1
+                while RETAIN_BYTES > 0 and keep < len(entries) and self.user_bytes[user_id] - freed > RETAIN_BYTES:
+                    freed += entries[keep][1] + 1
+                    keep += 1
+                    dropped['bytes'] += 1
+                self.drop_oldest(user_id, entries, keep, freed, trimmed, emptied)
+            self.forget_emptied(emptied)
+            emptied += [user_id for user_id in evicted if user_id not in self.index]
+            # A user cleared since starts again from base 0; its new postings stay
+            trimmed = [(user_id, base) for user_id, base in trimmed if self.base.get(user_id, 0) >= base]
+        # Searches skip positions below base already; this only frees memory
+        for user_id, base in trimmed:
+            self.search_index.expire(user_id, base)
+        return dropped, emptied
+
+    def drop_oldest(self, user_id, entries, keep, freed, trimmed, emptied):
+        """Takes a user's first `keep` entries (`freed` bytes) out of the
+        index; notes the user in trimmed (with its new base) or emptied"""
+        if not keep:
+            return
+        self.live -= freed
+        self.user_bytes[user_id] -= freed
+        if keep == len(entries):
+            emptied.append(user_id)
+        else:
+            self.index[user_id] = entries[keep:]
+            self.base[user_id] = self.base.get(user_id, 0) + keep
+            trimmed.append((user_id, self.base[user_id]))
+
+    def forget_emptied(self, users):
+        for user_id in users:
+            del self.index[user_id]
+            self.base.pop(user_id, None)
+            self.user_bytes.pop(user_id, None)
+            self.search_index.forget(user_id)
+
+    def forget(self, user_id):
+        """Takes all of a user's clips out of the index; returns how many"""
+        with self.lock:
+            entries = self.index.pop(user_id, [])
+            self.base.pop(user_id, None)
+            self.live -= self.user_bytes.pop(user_id, 0)
+            self.search_index.forget(user_id)
+        return len(entries)
+
+    def compact(self):
+        """Rewrites the log without the records taken out of the index, once
+        they are COMPACT_DEAD_RATIO of it. Records are copied with the lock
+        released, so clips keep arriving; the lock is only held to copy the
+        few appended meanwhile and swap the files. Returns bytes reclaimed."""
+        if self.arena:
+            return 0  # the ring reuses space as it goes
+        with self.lock:
+            dead = self.size - self.live
+            if dead < COMPACT_MIN_BYTES or dead < self.size * COMPACT_DEAD_RATIO:
+                return 0
+            generation, end = self.generation, self.size
+            live = sorted((o, n) for entries in self.index.values() for o, n, _ in entries)
+            view = memoryview(self.mapping())
+        temp = self.path + '.compact'
+        out = open(temp, 'wb')
+        try:
+            moved = {}  # old offset -> new
+            written = 0
+            for offset, length in live:
+                out.write(view[offset:offset + length + 1])
+                moved[offset] = written
+                written += length + 1
+            with self.lock:
+                if self.generation != generation:
+                    return 0
+                # Appended since the snapshot: all indexed, copied as one run
+                if self.size > end:
+                    with open(self.path, 'rb') as f:
+                        f.seek(end)
+                        out.write(f.read(self.size - end))
+                out.close()
+                view.release()
+                if self.map is not None:
+                    try:
+                        self.map.close()
+                    except BufferError:
+                        # A response still holds views. Elsewhere it keeps the
+                        # old file alive until GC; Windows can't replace a
+                        # mapped file, so try again next pass.
+                        if sys.platform == 'win32':
+                            return 0
+                    self.map = None
+                os.replace(temp, self.path)
+                shift = end - written
+                for user_id, entries in self.index.items():
+                    self.index[user_id] = [(moved[o] if o < end else o - shift, n, t) for o, n, t in entries]
+                self.size -= shift
+                return shift
+        finally:
+            out.close()
+            if os.path.exists(temp):
+                os.remove(temp)
+
+    def clear(self):
+        """Empties the store. The log is renamed aside rather than deleted,
+        which can take a while for a large file; returns the new name for
+        the caller to delete, or None if there was no log."""
+        with self.lock:
+            self.search_index.clear()
+            self.index.clear()
+            self.base.clear()
+            self.user_bytes.clear()
+            self.size = self.live = 0
+            self.generation += 1
+            if self.arena:
+                self.arena.reclaimed = self.arena.head
+                return None
+            if self.map is not None:
+                try:
+                    self.map.close()
+                except BufferError:
+                    pass  # a response still holds views; GC closes it later
+                self.map = None
+            if os.path.exists(self.path):
+                doomed = f'{self.path}.{time.time_ns()}.deleted'
+                os.replace(self.path, doomed)
+                return doomed
+            return None
+
+clip_store = ClipStore(JSON_LOG_FILE, EPHEMERAL_MB * 1024 * 1024)
+
 class ClipboardLogger:
     def __init__(self):
         self.lock = threading.Lock()
         self.total_broadcasts = 0
+        self.clips = {}   # user_id -> OrderedDict(broadcast_number -> clip)
+        self.heads = {}   # user_id -> (etag, record) of the latest clip
+        self.changed = {}  # user_id -> [condition, sleepers] for that user's long-polls
+        self.want_serial = 0  # numbers format requests, so a source can poll for new ones
 
-    def log_clipboard_data(self, user_id, data):
+    def log_clipboard_data(self, user_id, data, trace_id=None):
+        commit_start = time.perf_counter_ns()
         with self.lock:
-            self.total_broadcasts += 1
             timestamp = datetime.now().isoformat()
             content = data.get('content', '')
             original_timestamp = data.get('timestamp', timestamp)
-            try:
-                with open(LOG_FILE, 'a', encoding='utf-8') as f:
-                    f.write(f"\n{'='*80}\n")
-                    f.write(f"Broadcast #{self.total_broadcasts}\n")
-                    f.write(f"User ID: {user_id}\n")
-                    f.write(f"Timestamp: {original_timestamp}\n")
-                    f.write(f"Server Received: {timestamp}\n")
-                    f.write(f"Content Length: {len(content)} characters\n")
-                    f.write(f"Content:\n{content}\n")
-            except Exception as e:
-                logging.error(f"Error writing to text log: {e}")
+            primary, formats = self.clip_formats(data)
+            json_entry = {
+                'broadcast_number': self.total_broadcasts + 1,
+                'user_id': user_id,
+                'client_timestamp': original_timestamp,
+                'server_timestamp': timestamp,
+                'content': content,
+                'content_length': len(content),
+                'format': primary,
+                'formats': formats
+            }
+            if data.get('sealed'):
+                json_entry['sealed'] = str(data['sealed'])  # cipher; content is ciphertext
+            # Sized before anything changes: a clip the arena can't hold is
+            # refused (ClipTooLarge) rather than half taken
+            record = clip_store.encode(json_entry)
+            self.total_broadcasts += 1
+            self.store_clip(user_id, self.total_broadcasts, primary, formats, content)
+            if not EPHEMERAL_MB:  # ephemeral mode writes nothing to disk
+                try:
+                    with open(LOG_FILE, 'a', encoding='utf-8') as f:
+                        f.write(f"\n{'='*80}\n")
+                        f.write(f"Broadcast #{self.total_broadcasts}\n")
+                        f.write(f"User ID: {user_id}\n")
+                        f.write(f"Timestamp: {original_timestamp}\n")
+                        f.write(f"Server Received: {timestamp}\n")
+                        f.write(f"Content Length: {len(content)} characters\n")
+                        f.write(f"Format: {primary}\n")
+                except Exception as e:
+                    logging.error(f"Error writing to text log: {e}")
 
             try:
-                json_entry = {
-                    'broadcast_number': self.total_broadcasts,
-                    'user_id': user_id,
-                    'client_timestamp': original_timestamp,
-                    'server_timestamp': timestamp,
-                    'content': content,
-                    'content_length': len(content)
-                }
-                if os.path.exists(JSON_LOG_FILE):
-                    with open(JSON_LOG_FILE, 'r', encoding='utf-8') as f:
-                        log_data = json.load(f)
-                else:
-                    log_data = {'broadcasts': []}
-                log_data['broadcasts'].append(json_entry)
-                with open(JSON_LOG_FILE, 'w', encoding='utf-8') as f:
-                    json.dump(log_data, f, indent=2, ensure_ascii=False)
+                record, offset = clip_store.append(user_id, json_entry, record)
+                if clip_store.arena:
+                    self.clips[user_id][self.total_broadcasts]['at'] = (offset, len(record))
+                fanout_start = time.perf_counter_ns()
+                metrics.observe('spill_commit_latency_us', (fanout_start - commit_start) // 1000)
+                # Strong: a hash of the exact bytes /latest sends, number and times included
+                digest = hashlib.blake2b(record, digest_size=16).hexdigest()
+                self.heads[user_id] = (f'"{digest}"', record)
+                self.notify_changed(user_id)
+                if trace_id:
+                    trace_recorder.record(trace_id, 'server', 'commit', commit_start, fanout_start)
+                    trace_recorder.record(trace_id, 'server', 'fan-out', fanout_start, time.perf_counter_ns())
             except Exception as e:
                 logging.error(f"Error writing JSON log: {e}")
+            return self.total_broadcasts
+
+    def clip_formats(self, data):
+        """Primary (inline) format and the ordered list the source offered"""
+        offered = data.get('formats') or []
+        formats = [f for f in CLIP_FORMATS if f in offered]
+        primary = data.get('format', 'text')
+        if primary not in CLIP_FORMATS:
+            primary = 'text'
+        if primary not in formats:
+            formats.insert(0, primary)
+        return primary, formats
+
+    def store_clip(self, user_id, number, primary, formats, content):
+        """Keep each format of a clip separately; only the primary is filled"""
+        clips = self.clips.setdefault(user_id, OrderedDict())
+        if clips:
+            # The source's clipboard has moved on: formats it never uploaded
+            # for the previous clip can't be had any more
+            previous = clips[next(reversed(clips))]
+            previous['formats'] = [f for f in previous['formats']
+                                   if f == previous['primary'] or f in previous['data']]
+            previous['wanted'].clear()
+        clips[number] = {
+            'formats': formats,
+            'primary': primary,
+            # Ephemeral mode reads the primary out of the arena (see get_format)
+            'data': {} if EPHEMERAL_MB else {primary: content.encode('utf-8')},
+            'wanted': {},  # format -> serial of a consumer's request, until uploaded
+            'stamp': time.time()
+        }
+        while len(clips) > MAX_CLIPS_PER_USER:
+            clips.popitem(last=False)
+
+    def expire(self, now, users):
+        """Forgets format payloads past RETAIN_AGE, and everything held for
+        users whose last stored clip retention has removed"""
+        with self.lock:
+            for user_id in users:
+                if user_id not in clip_store.index:  # unless a new clip came in meanwhile
+                    self.forget_locked(user_id)
+            if RETAIN_AGE > 0:
+                for user_id, clips in list(self.clips.items()):
+                    while clips and next(iter(clips.values()))['stamp'] < now - RETAIN_AGE:
+                        clips.popitem(last=False)
+                    if not clips:
+                        del self.clips[user_id]
+
+    def forget_locked(self, user_id):
+        self.clips.pop(user_id, None)
+        self.heads.pop(user_id, None)
+
+    def memory_bytes(self):
+        """Clip bytes held besides the log: format payloads and each user's
+        latest record"""
+        with self.lock:
+            return (sum(len(payload) for clips in self.clips.values() for clip in clips.values()
+                        for payload in clip['data'].values())
+                    + sum(len(record) for _, record in self.heads.values()))
+
+    def set_aside_text_logs(self):
+        """Renames LOG_FILE and its older file aside for the compactor to
+        delete; returns the paths that were there. Caller holds self.lock"""
+        cleared = []
+        for path in () if EPHEMERAL_MB else (LOG_FILE + '.1', LOG_FILE):
+            if os.path.exists(path):
+                doomed = f'{path}.{time.time_ns()}.deleted'
+                os.replace(path, doomed)
+                compactor.discard(doomed)
+                cleared.append(path)
+        return cleared
+
+    def rotate_text_log(self, now):
+        """Keeps LOG_FILE under TEXT_LOG_MAX_BYTES with one older file beside
+        it, and deletes either once its last write is past RETAIN_AGE"""
+        older = LOG_FILE + '.1'
+        with self.lock:
+            for path in (older, LOG_FILE):
+                if RETAIN_AGE > 0 and os.path.exists(path) and os.path.getmtime(path) < now - RETAIN_AGE:
+                    os.remove(path)
+            if os.path.exists(LOG_FILE) and os.path.getsize(LOG_FILE) > TEXT_LOG_MAX_BYTES:
+                os.replace(LOG_FILE, older)
+
+    def wait_for_wanted(self, user_id, after, timeout):
+        """Formats consumers asked for since request serial `after`, as
+        (latest serial, [(broadcast number, [formats])]); blocks up to
+        `timeout` seconds while there are none, so the source client can
+        long-poll for them"""
+        deadline = time.monotonic() + timeout
+        with self.lock:
+            while True:
+                wanted = []
+                for number, clip in self.clips.get(user_id, {}).items():
+                    formats = [f for f, serial in clip['wanted'].items() if serial > after]
+                    if formats:
+                        wanted.append((number, formats))
+                remaining = deadline - time.monotonic()
+                if wanted or remaining <= 0:
+                    return self.want_serial, wanted
+                self.wait_changed(user_id, remaining)
+
+    def put_format(self, user_id, number, fmt, payload):
+        """Stores an uploaded format; a None payload (dropped for holding a
+        secret) withdraws the format instead"""
+        with self.lock:
+            clip = self.clips.get(user_id, {}).get(number)
+            if clip is None or fmt not in clip['formats']:
+                return False
+            clip['wanted'].pop(fmt, None)
+            if payload is None:
+                clip['formats'].remove(fmt)
+            else:
+                clip['data'][fmt] = payload
+            return True
+
+    def get_format(self, user_id, number, fmt):
+        """Returns (payload, offered); asking for a format not uploaded yet
+        requests it of the source client for this clip"""
+        with self.lock:
+            clip = self.clips.get(user_id, {}).get(number)
+            if clip is None or fmt not in clip['formats']:
+                return None, False
+            payload = clip['data'].get(fmt)
+            if payload is None and fmt == clip['primary']:
+                payload = clip_store.content_at(*clip['at']) if 'at' in clip else None
+                return payload, payload is not None  # evicted: gone, not pending
+            if payload is None and fmt not in clip['wanted']:
+                self.want_serial += 1
+                clip['wanted'][fmt] = self.want_serial
+                self.notify_changed(user_id)
+            return payload, True
+
+    def wait_changed(self, user_id, timeout):
+        """Sleeps (lock held) until this user's latest clip or format
+        requests change, so a commit wakes only its own user's long-polls"""
+        sleeper = self.changed.get(user_id)
+        if sleeper is None:
+            sleeper = self.changed[user_id] = [threading.Condition(self.lock), 0]
+        sleeper[1] += 1
+        try:
+            sleeper[0].wait(timeout)
+        finally:
+            sleeper[1] -= 1
+            if not sleeper[1] and self.changed.get(user_id) is sleeper:
+                del self.changed[user_id]
+
+    def notify_changed(self, user_id):
+        sleeper = self.changed.get(user_id)
+        if sleeper:
+            sleeper[0].notify_all()
+
+    def wait_for_head(self, user_id, seen_etags, timeout):
+        """Latest (etag, record) for a user, blocking up to `timeout` seconds
+        while the client already has it. Waiters sleep on a condition, so
+        idle long-polls cost no CPU."""
+        deadline = time.monotonic() + timeout
+        with self.lock:
+            while True:
+                head = self.heads.get(user_id)
+                if head is not None and head[0] not in seen_etags:
+                    return head
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    return head
+                self.wait_changed(user_id, remaining)
 
     def get_stats(self):
         try:
-            file_size = os.path.getsize(LOG_FILE) if os.path.exists(LOG_FILE) else 0
-            json_size = os.path.getsize(JSON_LOG_FILE) if os.path.exists(JSON_LOG_FILE) else 0
+            if EPHEMERAL_MB:
+                file_size = json_size = 0  # no files, and no disk access here
+            else:
+                file_size = os.path.getsize(LOG_FILE) if os.path.exists(LOG_FILE) else 0
+                json_size = os.path.getsize(JSON_LOG_FILE) if os.path.exists(JSON_LOG_FILE) else 0
             return {
                 'total_broadcasts': self.total_broadcasts,
                 'log_file_size': file_size,
                 'json_log_size': json_size,
-                'uptime': datetime.now().isoformat()
+                'started': SERVER_STARTED.isoformat(),
+                'uptime_seconds': round(time.monotonic() - SERVER_STARTED_MONOTONIC, 3)
             }
         except Exception:
             return {'error': 'Could not retrieve stats'}
 
 clipboard_logger = ClipboardLogger()
 
+class Compactor:
+    """Retention in the background, so requests never wait on the disk for
+    it: every COMPACT_INTERVAL seconds, or when woken, it drops clips past
+    their age, count or byte limit, rewrites the clip log once enough of it
+    is dead, rotates the text log and deletes the files /clear-logs set
+    aside"""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.doomed = []  # paths to delete
+        self.wakeup = threading.Event()
+
+    def wake(self):
+        self.wakeup.set()
+
+    def discard(self, path):
+        with self.lock:
+            self.doomed.append(path)
+        self.wake()
+
+    def run(self):
+        while True:
+            try:
+                self.step()
+            except Exception as e:
+                logging.error(f"Retention pass failed: {e}")
+            time.sleep(COMPACT_MIN_GAP)
+            self.wakeup.wait(COMPACT_INTERVAL - COMPACT_MIN_GAP)
+            self.wakeup.clear()
+
+    def step(self):
+        with self.lock:
+            doomed, self.doomed = self.doomed, []
+        for path in doomed:
+            try:
+                os.remove(path)
+            except FileNotFoundError:
+                pass
+            except OSError:
+                with self.lock:
+                    self.doomed.append(path)  # still mapped on Windows; next pass
+        now = time.time()
+        dropped, emptied = clip_store.expire(now)
+        for reason, count in dropped.items():
+            metrics.inc('spill_retention_dropped_total', (('reason', reason),), count)
+        clipboard_logger.expire(now, emptied)
+        start = time.perf_counter_ns()
+        reclaimed = clip_store.compact()
+        if reclaimed:
+            metrics.observe('spill_compaction_us', (time.perf_counter_ns() - start) // 1000)
+            metrics.inc('spill_compacted_bytes_total', (), reclaimed)
+            logging.info(f"Compacted {JSON_LOG_FILE}: {reclaimed // 1024} KB reclaimed, "
+                         f"{clip_store.size // 1024} KB kept")
+        if not EPHEMERAL_MB:
+            clipboard_logger.rotate_text_log(now)
+
+compactor = Compactor()
+
+# Characters of generated tokens (base64url, API keys); anything else ends a run
+SECRET_KEY_CHARS = b'ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_+-'
+
+class SecretRedactor:
+    """Finds credentials in a clip before it is stored or fanned out.
+
+    Matching one regex alternation of every rule at every position runs at a
+    few MB/s in sre, so the clip is instead swept with C-speed primitives
+    once: translate() marks key characters and find() jumps between runs of
+    them long enough to hold a token; the format rules and the entropy check
+    only look inside those runs. Rules anchored on a keyword (passwords,
+    private keys, JWTs) jump between find() hits on the lower-cased clip. On
+    code and prose that is ~100 MB/s, a few microseconds for a typical clip."""
+
+    KEY_MASK = bytes(0x6B if c in SECRET_KEY_CHARS else 0x20 for c in range(256))  # key characters -> 'k'
+    MIN_RUN = 20
+    RUN = b'k' * MIN_RUN
+    # Formats that sit inside one run of key characters
+    RUN_RULES = [
+        ('aws_access_key', rb'(?:AKIA|ASIA)[0-9A-Z]{16}'),
+        ('github_token', rb'gh[pousr]_[A-Za-z0-9]{36,}|github_pat_[A-Za-z0-9_]{22,}'),
+        ('slack_token', rb'xox[abposr]-[A-Za-z0-9-]{10,}'),
+        ('api_key', rb'(?:sk|rk)[-_](?:live[-_]|test[-_]|proj-|ant-)?[A-Za-z0-9_-]{20,}'),
+        ('google_api_key', rb'AIza[0-9A-Za-z_-]{35}'),
+    ]
+    # (kind, keyword in the lower-cased clip, pattern matched where it occurs);
+    # for 'password' only the assigned value is masked
+    KEYWORD_RULES = [
+        ('private_key', b'-----begin',
+         rb'-----BEGIN[A-Z ]{0,32} PRIVATE KEY-----[\s\S]*?(?:-----END[A-Z ]{0,32} PRIVATE KEY-----|\Z)'),
+        ('jwt', b'eyj', rb'eyJ[A-Za-z0-9_-]{8,}\.eyJ[A-Za-z0-9_-]{8,}\.[A-Za-z0-9_-]{8,}'),
+    ] + [('password', keyword, rb'(?i:' + re.escape(keyword) + rb')[A-Za-z_]*["\']?[ \t]{0,4}[:=][ \t]{0,4}["\']?'
+          rb'(?P<value>[^\s"\'`,;()\[\]{}<>]{6,200})(?=[\s"\'`,;]|\Z)')
+         for keyword in (b'password', b'passwd', b'secret', b'token', b'api_key', b'apikey', b'api-key', b'access_key')]
+
+    def __init__(self, extra_patterns=()):
+        self.run_rules = re.compile(b'|'.join(b'(?P<%s>%s)' % (kind.encode(), pattern)
+                                              for kind, pattern in self.RUN_RULES))
+        self.keyword_rules = [(kind, keyword, re.compile(pattern)) for kind, keyword, pattern in self.KEYWORD_RULES]
+        self.extra = list(extra_patterns)
+
+    @staticmethod
+    def looks_random(run):
+        """Upper case, lower case, digits and high entropy: a generated token
+        rather than an identifier, a constant name or a hex digest"""
+        if not 32 <= len(run) <= 512 or run.lower() == run or run.upper() == run:
+            return False
+        if len(run.translate(None, b'0123456789')) == len(run):
+            return False
+        n = len(run)
+        entropy = -sum(c / n * math.log2(c / n) for c in Counter(run).values())
+        return entropy >= REDACT_MIN_ENTROPY
+
+    def find(self, data):
+        """[(start, end, kind)] of the secrets in data (UTF-8 bytes)"""
+        spans = []
+        mask = data.translate(self.KEY_MASK)
+        i = mask.find(self.RUN)
+        while i >= 0:
+            end = mask.find(b' ', i)
+            if end < 0:
+                end = len(data)
+            claimed = False
+            for match in self.run_rules.finditer(data, i, end):
+                spans.append((match.start(), match.end(), match.lastgroup))
+                claimed = True
+            if not claimed and self.looks_random(data[i:end]):
+                spans.append((i, end, 'token'))
+            i = mask.find(self.RUN, end)
+        lowered = data.lower()
+        for kind, keyword, pattern in self.keyword_rules:
+            i = lowered.find(keyword)
+            while i >= 0:
+                match = pattern.match(data, i)
+                if match:
+                    start = match.start('value') if 'value' in pattern.groupindex else i
+                    spans.append((start, match.end(), kind))
+                    i = lowered.find(keyword, match.end())
+                else:
+                    i = lowered.find(keyword, i + len(keyword))
+        for pattern in self.extra:
+            spans += [(m.start(), m.end(), 'custom') for m in pattern.finditer(data) if m.end() > m.start()]
+        return spans
+
+    def redact(self, data):
+        """(data with each secret replaced by [redacted:kind], sorted kinds found)"""
+        spans = sorted(self.find(data))
+        if not spans:
+            return data, []
+        out = []
+        kinds = set()
+        position = 0
+        for start, end, kind in spans:
+            if end <= position:
+                continue  # inside one already masked
+            out.append(data[position:max(start, position)])
+            out.append(b'[redacted:' + kind.encode() + b']')
+            kinds.add(kind)
+            position = end
+        out.append(data[position:])
+        return b''.join(out), sorted(kinds)
+
+def load_redact_patterns(path):
+    """Compiled extra patterns from `path`; blank lines and '#' comments are
+    skipped, and so (with a warning) is anything that doesn't compile"""
+    patterns = []
+    try:
+        with open(path, encoding='utf-8') as f:
+            lines = f.read().splitlines()
+    except FileNotFoundError:
+        return patterns
+    for number, line in enumerate(lines, 1):
+        if not line.strip() or line.lstrip().startswith('#'):
+            continue
+        try:
+            patterns.append(re.compile(line.encode('utf-8')))
+        except re.error as e:
+            logging.warning(f"{path}:{number}: skipping pattern ({e})")
+    return patterns
+
+secret_redactor = SecretRedactor(load_redact_patterns(REDACT_PATTERNS_FILE)) if REDACT_MODE != 'off' else None
+
+def make_tls_context():
+    """Server TLS for the TCP listener, or None without a certificate.
+    Resumption comes from stateless tickets (TLS 1.2 and 1.3) and OpenSSL's
+    session cache (TLS 1.2 ids); the ticket key lives in memory, so after a
+    restart each client does one full handshake again."""
+    if not (TLS_CERT and os.path.exists(TLS_CERT) and os.path.exists(TLS_KEY)):
+        return None
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    context.minimum_version = ssl.TLSVersion.TLSv1_2
+    context.load_cert_chain(TLS_CERT, TLS_KEY)
+    context.set_alpn_protocols(['http/1.1'])  # all werkzeug speaks
+    context.options &= ~ssl.OP_NO_TICKET
+    context.num_tickets = TLS_TICKETS
+    if ssl.OPENSSL_VERSION_INFO >= (3,):
+        # Records are encrypted by the kernel where it has the tls module;
+        # OpenSSL quietly keeps doing it itself where it doesn't
+        context.options |= getattr(ssl, 'OP_ENABLE_KTLS', 1 << 3)
+    return context
+
+def kernel_tls_available():
+    """True if the kernel's tls module is loaded, so kTLS can take over"""
+    return os.path.exists('/proc/net/tls_stat')
+
+def serve_tls(server, context):
+    """Puts TLS on server's listener. Handshakes run on the connection's own
+    thread rather than in accept(), so one slow client doesn't stall the rest."""
+    server.socket = context.wrap_socket(server.socket, server_side=True, do_handshake_on_connect=False)
+    server.ssl_context = context  # werkzeug: https:// in the environ, SSL errors logged quietly
+    finish_request = server.finish_request
+
+    def handshake_then_finish(connection, client_address):
+        start = time.perf_counter_ns()
+        # The response goes out as separate small records (headers, body);
+        # with Nagle each one after the first waits for the client's delayed ACK
+        connection.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        connection.settimeout(TLS_HANDSHAKE_TIMEOUT)
+        try:
+            connection.do_handshake()
+        except (ssl.SSLError, OSError) as e:
+            metrics.inc('spill_tls_handshakes_total', (('result', 'failed'), ('version', '')))
+            logging.debug(f"TLS handshake with {client_address[0]} failed: {e}")
+            return  # the server closes the connection
+        connection.settimeout(None)
+        result = 'resumed' if connection.session_reused else 'full'
+        metrics.inc('spill_tls_handshakes_total', (('result', result), ('version', connection.version())))
+        metrics.observe('spill_tls_handshake_us', (time.perf_counter_ns() - start) // 1000, (('result', result),))
+        try:
+            finish_request(connection, client_address)
+        finally:
+            # Send close_notify without waiting for the client's; a session
+            # closed without one is dropped from OpenSSL's cache
+            try:
+                connection.setblocking(False)
+                connection.unwrap()
+            except (ssl.SSLError, OSError, ValueError):
+                pass
+
+    server.finish_request = handshake_then_finish
+
+def peer_credentials():
+    """(pid, uid, gid) of the process on the other end of a Unix socket
+    request, from the kernel; None for TCP"""
+    sock = request.environ.get('werkzeug.socket')
+    if sock is None or sock.family != socket.AF_UNIX:
+        return None
+    creds = sock.getsockopt(socket.SOL_SOCKET, socket.SO_PEERCRED, struct.calcsize('3i'))
+    return struct.unpack('3i', creds)
+
+@app.before_request
+def start_request_metrics():
+    g.request_start = time.perf_counter_ns()
+    if traffic_capture:
+        g.request_arrived_us = time.time_ns() // 1000
+    metrics.inflight.add(threading.get_ident())
+    metrics.observe('spill_queue_depth', len(metrics.inflight) - 1)
+    if request.method in ('POST', 'PUT') and request.content_length is not None:
+        metrics.observe('spill_payload_bytes', request.content_length)
+    g.peer = peer_credentials() if unix_server else None
+    if g.peer:
+        # The socket file is 0600 already; this also holds if someone loosens it
+        if g.peer[1] not in (0, os.getuid()):
+            return Response('forbidden\n', status=403, content_type='text/plain')
+        metrics.inc('spill_unix_requests_total', (('uid', g.peer[1]),))
+    # Admission: decided from the headers, before anything reads the body
+    if request.endpoint not in UNLIMITED_ENDPOINTS:
+        limited = admission.limit((request.view_args or {}).get('user_id'), admission.cost(request.content_length))
+        if limited:
+            scope, wait = limited
+            metrics.inc('spill_rate_limited_total', (('scope', scope), ('source', 'http')))
+            return turned_away(429, f'Rate limit ({scope}) exceeded', wait)
+    if request.endpoint not in UNGATED_ENDPOINTS:
+        if not admission.enter(admission.priority(request.endpoint, request.content_length)):
+            metrics.inc('spill_shed_total', (('endpoint', request.endpoint or 'none'),))
+            return turned_away(503, 'Server overloaded, try again later', 1)
+        g.admitted = True
+
+@app.after_request
+def finish_request_metrics(response):
+    labels = (('endpoint', request.endpoint or 'none'), ('status', response.status_code))
+    metrics.inc('spill_requests_total', labels)
+    elapsed_us = (time.perf_counter_ns() - g.request_start) // 1000
+    metrics.observe('spill_request_latency_us', elapsed_us, labels[:1])
+    if traffic_capture:
+        try:
+            traffic_capture.record(g.request_arrived_us, response)
+        except Exception as e:
+            logging.error(f"Error capturing request: {e}")
+    return response
+
+@app.teardown_request
+def end_request_metrics(exc):
+    metrics.inflight.discard(threading.get_ident())
+    if g.pop('admitted', False):
+        admission.leave()
+
+def retention_summary():
+    age = f'{RETAIN_AGE / 3600:g} h' if RETAIN_AGE >= 3600 else f'{RETAIN_AGE:g} s'
+    limits = [age if RETAIN_AGE > 0 else None,
+              f'{RETAIN_CLIPS} clips' if RETAIN_CLIPS > 0 else None,
+              f'{RETAIN_BYTES // (1024 * 1024)} MB' if RETAIN_BYTES > 0 else None]
+    limits = [limit for limit in limits if limit]
+    return ', '.join(limits) + ' per user' if limits else 'keep everything'
+
 @app.route('/', methods=['GET'])
 def home():
     stats = clipboard_logger.get_stats()
@@ -130,21 +1955,37 @@ def home():
             <li>Total Broadcasts Received: <strong>{stats.get('total_broadcasts', 0)}</strong></li>
             <li>Log File Size: <strong>{stats.get('log_file_size', 0)} bytes</strong></li>
             <li>JSON Log Size: <strong>{stats.get('json_log_size', 0)} bytes</strong></li>
-            <li>Server Started: <strong>{stats.get('uptime', 'Unknown')}</strong></li>
+            <li>Server Started: <strong>{stats.get('started', 'Unknown')}</strong></li>
+            <li>Secrets in Clips: <strong>{REDACT_MODE}</strong> (<code>SPILL_REDACT</code>=mask|drop|off)</li>
+            <li>Rate Limits: <strong>{RATE_USER:g}/s per user, {RATE_GLOBAL:g}/s in all</strong> (<code>SPILL_RATE_USER</code>, <code>SPILL_RATE_GLOBAL</code>; 0 = none); {ADMIT_RUNNING} requests run at once, clips first, logs and search shed first</li>
+            <li>Storage: <strong>{f'memory only, {clip_store.live} of {clip_store.arena.capacity} arena bytes in use' if clip_store.arena else 'log files below'}</strong> (<code>SPILL_EPHEMERAL_MB</code>: keep clips in a memory arena and write no files)</li>
+            <li>Retention: <strong>{retention_summary()}</strong> (<code>SPILL_RETAIN_AGE</code>, <code>SPILL_RETAIN_CLIPS</code>, <code>SPILL_RETAIN_BYTES</code>; 0 = no limit); the clip log is compacted in the background</li>
+            <li>TLS: <strong>{'on' if tls_context else 'off'}</strong> (<code>{TLS_CERT}</code> + <code>{TLS_KEY}</code>; session resumption, ALPN http/1.1)</li>
         </ul>
 
         <h3>Endpoints:</h3>
         <ul>
             <li><code>POST /&lt;user_id&gt;</code> - Receive clipboard broadcasts</li>
             <li><code>GET /stats</code> - Get server statistics (JSON)</li>
+            <li><code>GET /healthz</code> - Readiness probe</li>
+            <li><code>GET /whoami</code> - Transport (with TLS, the version, cipher and whether the session was resumed) and, over the Unix socket ({UNIX_SOCKET}), the caller's pid/uid</li>
+            <li><code>GET /metrics</code> - Counters and latency histograms (Prometheus text)</li>
+            <li><code>GET /trace</code> - Recent clip stage spans (Chrome trace JSON)</li>
+            <li><code>GET /trace/stats</code> - Per-stage latency summary (JSON)</li>
+            <li><code>GET /profile?seconds=10</code> - Sample stacks for N seconds (folded, for flamegraphs)</li>
             <li><code>GET /logs/&lt;user_id&gt;</code> - Get recent logs for user (JSON)</li>
+            <li><code>GET /&lt;user_id&gt;/clips/&lt;n&gt;/&lt;format&gt;</code> - Get one format of a clip (202 while the source client is asked to upload it)</li>
+            <li><code>GET /&lt;user_id&gt;/wanted?after=n</code> - Formats asked of the source client (<code>&amp;wait=30s</code> long-poll)</li>
+            <li><code>GET /&lt;user_id&gt;/latest</code> - Latest clip (ETag, <code>?wait=30s</code> long-poll)</li>
+            <li><code>GET /&lt;user_id&gt;/search?q=text</code> - Clips containing text, newest first (<code>&amp;limit=</code> up to {MAX_SEARCH_RESULTS})</li>
+            <li><code>POST /clear-logs</code> - Clear all logs (<code>?user_id=</code>: one user's clips)</li>
         </ul>
 
         <h3>Log Files:</h3>
         <ul>
-            <li><strong>clipboard_log.txt</strong> - Human readable log</li>
-            <li><strong>clipboard_log.json</strong> - Structured JSON log</li>
-            <li><strong>server.log</strong> - Server activity log</li>
+            <li><strong>clipboard_log.txt</strong> - Human readable log of who sent what size when, without clip text (rotated to <code>.1</code> past {TEXT_LOG_MAX_BYTES // (1024 * 1024)} MB, deleted once older than the age limit or when any user is cleared)</li>
+            <li><strong>clipboard_log.jsonl</strong> - Structured JSON log (one record per line; what retention keeps)</li>
+            <li><strong>server.log</strong> - Server activity log (rotated to <code>.1</code> past {SERVER_LOG_MAX_BYTES // (1024 * 1024)} MB)</li>
         </ul>
 
         <p><em>Refresh this page to see updated statistics.</em></p>
@@ -153,34 +1994,272 @@ def home():
     """
     return html
 
+@app.route('/healthz', methods=['GET'])
+def healthz():
+    """Readiness probe for remote bring-up: answers as soon as requests are served"""
+    return Response('ok\n', content_type='text/plain')
+
+@app.route('/whoami', methods=['GET'])
+def whoami():
+    """How this request reached the server; over the Unix socket, who sent it"""
+    if g.peer:
+        pid, uid, gid = g.peer
+        return jsonify({'transport': 'unix', 'socket': UNIX_SOCKET, 'pid': pid, 'uid': uid, 'gid': gid})
+    sock = request.environ.get('werkzeug.socket')
+    if isinstance(sock, ssl.SSLSocket):
+        return jsonify({'transport': 'tls', 'remote_addr': request.remote_addr, 'version': sock.version(),
+                        'cipher': sock.cipher()[0], 'alpn': sock.selected_alpn_protocol(),
+                        'resumed': sock.session_reused})
+    return jsonify({'transport': 'tcp', 'remote_addr': request.remote_addr})
+
+def redact_payload(user_id, payload, what):
+    """(payload with secrets masked, kinds found); with REDACT_MODE 'drop',
+    a payload holding any secret comes back as None"""
+    if secret_redactor is None:
+        return payload, []
+    masked, kinds = secret_redactor.redact(payload)
+    if not kinds:
+        return payload, []
+    action = 'drop' if REDACT_MODE == 'drop' else 'mask'
+    for kind in kinds:
+        metrics.inc('spill_redactions_total', (('kind', kind), ('action', action)))
+    logging.warning(f"[CLIPBOARD] [{user_id}] {'Dropped' if action == 'drop' else 'Masked'} {what}: "
+                    f"contains {', '.join(kinds)}")
+    return (None if action == 'drop' else masked), kinds
+
+def client_trace(trace):
+    """(id, stages, send_ns) of the trace a client sent with its clip. The
+    client is not trusted: stages with an unknown name or that aren't a
+    (name, start, end) of nanosecond counts are dropped, not the clip, as
+    are repeats of a stage (the first is kept), and a trace without a
+    usable id is ignored (id None)."""
+    def is_ns(value):
+        return isinstance(value, int) and not isinstance(value, bool) and 0 <= value < 1 << 63
+
+    if not isinstance(trace, dict):
+        return None, [], None
+    trace_id = trace.get('id')
+    if not isinstance(trace_id, str) or not 0 < len(trace_id) <= 64:
+        return None, [], None
+    stages, seen, dropped = [], set(), 0
+    raw = trace.get('stages')
+    for entry in raw if isinstance(raw, list) else []:
+        if (isinstance(entry, list) and len(entry) == 3 and isinstance(entry[0], str)
+                and entry[0] in TRACE_CLIENT_STAGES and entry[0] not in seen
+                and is_ns(entry[1]) and is_ns(entry[2]) and entry[1] <= entry[2]):
+            seen.add(entry[0])
+            stages.append(tuple(entry))
+        else:
+            dropped += 1
+    if dropped:
+        metrics.inc('spill_trace_dropped_total', (), dropped)
+    send_ns = trace.get('send_ns')
+    return trace_id, stages, send_ns if is_ns(send_ns) else None
+
+def accept_clip(user_id, data, parse_start):
+    """Redacts, traces, stores and logs one clip, from HTTP or the ring;
+    returns (broadcast number, kinds of secrets found). The number is None
+    when the clip was dropped for holding a secret."""
+    content = data.get('content', '')
+    if not isinstance(content, str):
+        content = str(content)
+    redacted = []
+    if not data.get('sealed'):  # ciphertext from the client has nothing to redact
+        masked, redacted = redact_payload(user_id, content.encode('utf-8', 'surrogatepass'), 'clip')
+        if masked is None:
+            return None, redacted
+        if redacted:
+            # The richer formats carry the same secret; only the masked text goes out
+            content = data['content'] = masked.decode('utf-8', 'surrogatepass')
+            data['formats'] = [data.get('format', 'text')]
+    trace_id, stages, send_ns = client_trace(data.pop('trace', None))
+    if trace_id:
+        for stage, start_ns, end_ns in stages:
+            trace_recorder.record(trace_id, 'client', stage, start_ns, end_ns)
+        if send_ns:
+            # Only meaningful when client and server share a clock (local mode)
+            trace_recorder.record(trace_id, 'client', 'send', send_ns, parse_start)
+        trace_recorder.record(trace_id, 'server', 'parse', parse_start, time.perf_counter_ns())
+    broadcast_number = clipboard_logger.log_clipboard_data(user_id, data, trace_id)
+    if data.get('sealed'):
+        logging.info(f"[CLIPBOARD] [{user_id}] Received sealed clip ({len(content)} chars, {data['sealed']})")
+        return broadcast_number, redacted
+    content_preview = content[:MAX_CONTENT_DISPLAY]
+    if len(content) > MAX_CONTENT_DISPLAY:
+        content_preview += "..."
+    try:
+        log_msg = f"[CLIPBOARD] [{user_id}] Received ({len(content)} chars): {repr(content_preview)}"
+        logging.info(log_msg)
+    except Exception as e:
+        logging.info(f"[CLIPBOARD] [{user_id}] Received ({len(content)} chars) [display error: {e}]")
+    return broadcast_number, redacted
+
+def receive_ring_clip(view):
+    """One record from the clip ring: the client's POST body, read in place"""
+    parse_start = time.perf_counter_ns()
+    try:
+        metrics.observe('spill_payload_bytes', len(view))
+        data = json.loads(str(view, 'utf-8'))
+        user_id = str(data['user_id'])
+        # Same buckets as HTTP: a script copying in a loop is held to its rate here too
+        limited = admission.limit(user_id, admission.cost(len(view)))
+        if limited:
+            metrics.inc('spill_rate_limited_total', (('scope', limited[0]), ('source', 'ring')))
+            return
+        accept_clip(user_id, data, parse_start)  # a dropped clip is only logged
+        metrics.inc('spill_ring_clips_total')
+    except Exception as e:
+        logging.error(f"Error processing clip from the ring: {e}")
+
 @app.route('/<user_id>', methods=['POST'])
 def receive_clipboard(user_id):
     try:
+        parse_start = time.perf_counter_ns()
+        if clip_store.arena and (request.content_length or 0) > clip_store.arena.capacity // 2:
+            return jsonify({'error': str(ClipTooLarge(clip_store.arena.capacity // 2))}), 413
         data = request.get_json()
         if not data:
             return jsonify({'error': 'No JSON data received'}), 400
-        content = data.get('content', '')
-        timestamp = data.get('timestamp', datetime.now().isoformat())
-        clipboard_logger.log_clipboard_data(user_id, data)
-        content_preview = content[:MAX_CONTENT_DISPLAY]
-        if len(content) > MAX_CONTENT_DISPLAY:
-            content_preview += "..."
-        try:
-            log_msg = f"[CLIPBOARD] [{user_id}] Received ({len(content)} chars): {repr(content_preview)}"
-            logging.info(log_msg)
-        except Exception as e:
-            logging.info(f"[CLIPBOARD] [{user_id}] Received ({len(content)} chars) [display error: {e}]")
+        try:
+            broadcast_number, redacted = accept_clip(user_id, data, parse_start)
+        except ClipTooLarge as e:  # its record, escaping and all, is over the limit
+            return jsonify({'error': str(e)}), 413
+        if broadcast_number is None:
+            return jsonify({'error': 'Clip contains a secret and was dropped', 'redacted': redacted}), 422
+        g.broadcast_number = broadcast_number
         return jsonify({
             'status': 'success',
             'message': 'Clipboard data received and logged',
             'user_id': user_id,
-            'content_length': len(content),
-            'broadcast_number': clipboard_logger.total_broadcasts
+            'content_length': len(data.get('content', '')),
+            'broadcast_number': broadcast_number,
+            'redacted': redacted
         }), 200
     except Exception as e:
         logging.error(f"Error processing clipboard from {user_id}: {e}")
         return jsonify({'error': str(e)}), 500
 
+@app.route('/<user_id>/clips/<int:number>/<fmt>', methods=['PUT'])
+def put_clip_format(user_id, number, fmt):
+    if fmt not in CLIP_FORMATS:
+        return jsonify({'error': f'Unknown format: {fmt}'}), 400
+    payload, redacted = redact_payload(user_id, request.get_data(), f'{fmt} for #{number}')
+    if not clipboard_logger.put_format(user_id, number, fmt, payload):
+        return jsonify({'error': 'Clip not found or format not offered'}), 404
+    if payload is None:
+        return jsonify({'error': 'Format contains a secret and was dropped', 'redacted': redacted}), 422
+    logging.info(f"[CLIPBOARD] [{user_id}] Materialized {fmt} for #{number}")
+    return jsonify({'status': 'success', 'broadcast_number': number, 'format': fmt})
+
+@app.route('/<user_id>/clips/<int:number>/<fmt>', methods=['GET'])
+def get_clip_format(user_id, number, fmt):
+    payload, offered = clipboard_logger.get_format(user_id, number, fmt)
+    if not offered:
+        return jsonify({'error': 'Clip not found or format not offered'}), 404
+    if payload is None:
+        return jsonify({
+            'status': 'pending',
+            'message': f'{fmt} not materialized; requested from the source client'
+        }), 202
+    return Response(payload, content_type=CLIP_FORMATS[fmt])
+
+@app.route('/<user_id>/wanted', methods=['GET'])
+def get_wanted(user_id):
+    """Long-polled by the source client: formats consumers asked for that
+    it hasn't uploaded, for requests numbered above ?after="""
+    after = request.args.get('after', 0, type=int)
+    if g.pop('admitted', False):
+        admission.leave()  # parked like /latest
+    serial, wanted = clipboard_logger.wait_for_wanted(user_id, after, parse_wait(request.args.get('wait')))
+    return jsonify({'serial': serial,
+                    'wanted': [{'broadcast_number': n, 'formats': formats} for n, formats in wanted]})
+
+def parse_wait(value):
+    """'30s', '500ms' or plain seconds, clamped to MAX_LATEST_WAIT"""
+    if not value:
+        return 0
+    try:
+        if value.endswith('ms'):
+            seconds = float(value[:-2]) / 1000
+        else:
+            seconds = float(value.rstrip('s'))
+    except ValueError:
+        return 0
+    return max(0, min(seconds, MAX_LATEST_WAIT))
+
+@app.route('/<user_id>/latest', methods=['GET'])
+def get_latest(user_id):
+    seen = {tag.strip() for tag in request.headers.get('If-None-Match', '').split(',')}
+    if g.pop('admitted', False):
+        admission.leave()  # a parked long-poll is no load; answering it is cheap
+    head = clipboard_logger.wait_for_head(user_id, seen, parse_wait(request.args.get('wait')))
+    if head is None:
+        return jsonify({'error': 'No clips for user'}), 404
+    etag, record = head
+    headers = {'ETag': etag, 'Cache-Control': 'no-cache'}
+    if etag in seen or '*' in seen:
+        return Response(status=304, headers=headers)
+    return Response(record, content_type='application/json', headers=headers)
+
+@app.route('/trace', methods=['GET'])
+def get_trace():
+    return jsonify(trace_recorder.chrome_trace())
+
+@app.route('/trace/stats', methods=['GET'])
+def get_trace_stats():
+    return jsonify(trace_recorder.summary())
+
+@app.route('/profile', methods=['GET'])
+def get_profile():
+    seconds = request.args.get('seconds', 10, type=float)
+    hz = request.args.get('hz', 97, type=float)
+    if not 0 < seconds <= MAX_PROFILE_SECONDS or not 1 <= hz <= 1000:
+        return jsonify({'error': f'Need 0 < seconds <= {MAX_PROFILE_SECONDS} and 1 <= hz <= 1000'}), 400
+    logging.info(f"Profiling for {seconds:g}s at {hz:g} Hz")
+    result = stack_sampler.profile(seconds, hz, request.args.get('idle') == '1')
+    if result is None:
+        return jsonify({'error': 'A profile is already running'}), 409
+    counts, samples = result
+    body = ''.join(f'{stack} {count}\n' for stack, count in counts.most_common())
+    return Response(body, content_type='text/plain; charset=utf-8',
+                    headers={'X-Profile-Samples': str(samples)})
+
+@app.route('/metrics', methods=['GET'])
+def get_metrics():
+    gauges = [
+        ('spill_uptime_seconds', 'Seconds since the server started',
+         round(time.monotonic() - SERVER_STARTED_MONOTONIC, 3)),
+        ('spill_start_time_seconds', 'Server start time (unix seconds)',
+         round(SERVER_STARTED.timestamp(), 3)),
+        ('spill_broadcasts', 'Clips received since start or last clear',
+         clipboard_logger.total_broadcasts),
+        ('spill_json_log_bytes', 'Size of the JSON clip log', clip_store.size),
+        ('spill_json_log_live_bytes', 'Bytes of the JSON clip log retention still keeps', clip_store.live),
+        ('spill_clips_kept', 'Clips retention still keeps (all users)',
+         sum(len(entries) for entries in list(clip_store.index.values()))),
+        ('spill_clip_users', 'Users with clips kept', len(clip_store.index)),
+        ('spill_arena_bytes', 'Memory preallocated for clip records in ephemeral mode',
+         clip_store.arena.capacity if clip_store.arena else 0),
+        ('spill_arena_used_bytes', 'Bytes of the arena holding clips still kept',
+         clip_store.live if clip_store.arena else 0),
+        ('spill_clip_memory_bytes', 'Clip bytes held besides the log (format payloads, latest clip per user)',
+         clipboard_logger.memory_bytes()),
+        ('spill_search_index_bytes', 'Estimated memory held by the search index',
+         clip_store.search_index.memory_bytes()),
+        ('spill_search_index_trigrams', 'Distinct trigrams in the search index (all users)',
+         clip_store.search_index.trigrams),
+        ('spill_search_index_postings', 'Trigram postings in the search index',
+         clip_store.search_index.postings),
+        ('spill_requests_in_flight', 'Requests currently being handled',
+         len(metrics.inflight)),
+        ('spill_ring_refused', 'Clips the shared-memory ring turned away (sent over HTTP)',
+         clip_ring.refused() if clip_ring else 0),
+        ('spill_rate_limit_users', 'Users with a token bucket in use', len(admission.users)),
+        ('spill_admission_running', 'Requests holding one of the ADMIT_RUNNING turns', admission.running),
+        ('spill_admission_waiting', 'Requests waiting for a turn', sum(admission.waiting)),
+    ]
+    return Response(metrics.prometheus(gauges), content_type='text/plain; version=0.0.4')
+
 @app.route('/stats', methods=['GET'])
 def get_stats():
     return jsonify(clipboard_logger.get_stats())
@@ -188,33 +2267,86 @@ def get_stats():
 @app.route('/logs/<user_id>', methods=['GET'])
 def get_user_logs(user_id):
     try:
-        if not os.path.exists(JSON_LOG_FILE):
+        total, records = clip_store.records(user_id, 50)
+        if not total:
             return jsonify({'logs': [], 'message': 'No logs found'})
-        with open(JSON_LOG_FILE, 'r', encoding='utf-8') as f:
-            log_data = json.load(f)
-        user_logs = [
-            log for log in log_data.get('broadcasts', [])
-            if log.get('user_id') == user_id
-        ]
-        recent_logs = user_logs[-50:] if len(user_logs) > 50 else user_logs
-        return jsonify({
-            'user_id': user_id,
-            'total_logs': len(user_logs),
-            'recent_logs': recent_logs
-        })
+        # Stored records are already the JSON we send: frame them and pass
+        # the mapped bytes through without decoding. WSGI servers only take
+        # bytes objects, so each record costs one slice copy, nothing more.
+        head = '{"user_id":%s,"total_logs":%d,"recent_logs":[' % (
+            json.dumps(user_id, ensure_ascii=False), total)
+        chunks = [head.encode('utf-8')]
+        for i, record in enumerate(records):
+            if i:
+                chunks.append(b',')
+            chunks.append(bytes(record))
+        chunks.append(b']}')
+        length = sum(len(chunk) for chunk in chunks)
+        return Response(chunks, content_type='application/json',
+                        headers={'Content-Length': str(length)})
     except Exception as e:
         logging.error(f"Error retrieving logs for {user_id}: {e}")
         return jsonify({'error': str(e)}), 500
 
+@app.route('/<user_id>/search', methods=['GET'])
+def search_clips(user_id):
+    """Newest clips containing q (any case), in the /logs record format"""
+    query = request.args.get('q', '')
+    if not query:
+        return jsonify({'error': 'q is required'}), 400
+    try:
+        limit = min(max(int(request.args.get('limit', 20)), 1), MAX_SEARCH_RESULTS)
+    except ValueError:
+        return jsonify({'error': 'limit must be a number'}), 400
+    try:
+        total, records, complete = clip_store.search(user_id, query, limit)
+        head = '{"user_id":%s,"query":%s,"clips":%d,"complete":%s,"results":[' % (
+            json.dumps(user_id, ensure_ascii=False), json.dumps(query, ensure_ascii=False),
+            total, 'true' if complete else 'false')
+        chunks = [head.encode('utf-8')]
+        for i, record in enumerate(records):
+            if i:
+                chunks.append(b',')
+            chunks.append(bytes(record))
+        chunks.append(b']}')
+        length = sum(len(chunk) for chunk in chunks)
+        return Response(chunks, content_type='application/json',
+                        headers={'Content-Length': str(length)})
+    except Exception as e:
+        logging.error(f"Error searching clips for {user_id}: {e}")
+        return jsonify({'error': str(e)}), 500
+
 @app.route('/clear-logs', methods=['POST'])
 def clear_logs():
+    """Everything, or with ?user_id= one user's clips. Files are only
+    renamed aside here; the compactor deletes them, and rewrites the clip
+    log without a cleared user's records."""
     try:
-        files_cleared = []
-        for log_file in [LOG_FILE, JSON_LOG_FILE]:
-            if os.path.exists(log_file):
-                os.remove(log_file)
-                files_cleared.append(log_file)
-        clipboard_logger.total_broadcasts = 0
+        user_id = request.args.get('user_id')
+        if user_id is not None:
+            cleared = clip_store.forget(user_id)
+            # The text log has no per-user retention, so none of it outlives a clear
+            with clipboard_logger.lock:
+                clipboard_logger.forget_locked(user_id)
+                files_cleared = clipboard_logger.set_aside_text_logs()
+            metrics.inc('spill_retention_dropped_total', (('reason', 'cleared'),), cleared)
+            compactor.wake()
+            logging.info(f"Clips of {user_id} cleared by admin request")
+            return jsonify({
+                'status': 'success',
+                'message': f'{cleared} clips of {user_id} cleared',
+                'clips_cleared': cleared,
+                'files_cleared': files_cleared
+            })
+        with clipboard_logger.lock:
+            files_cleared = clipboard_logger.set_aside_text_logs()
+            clipboard_logger.total_broadcasts = 0
+            clipboard_logger.clips.clear()
+            clipboard_logger.heads.clear()
+        doomed = clip_store.clear()
+        if doomed:
+            compactor.discard(doomed)
+            files_cleared.append(JSON_LOG_FILE)
         logging.info("Log files cleared by admin request")
         return jsonify({
             'status': 'success',
@@ -229,15 +2361,85 @@ if __name__ == '__main__':
     print("=" * 60)
     print("Clipboard Broadcast Server")
     print("=" * 60)
-    print(f"Server will log clipboard data to:")
-    print(f"  • {LOG_FILE} (human readable)")
-    print(f"  • {JSON_LOG_FILE} (structured data)")
-    print(f"  • server.log (server activity)")
+    if EPHEMERAL_MB:
+        print(f"Ephemeral: clips are kept only in a {EPHEMERAL_MB} MB memory arena, oldest evicted first; "
+              f"nothing is written to disk")
+        if CAPTURE_FILE:
+            print(f"  • SPILL_CAPTURE ignored: it would write {CAPTURE_FILE}")
+        if UNIX_SOCKET:
+            print(f"  • SPILL_SOCKET is set: the Unix socket {UNIX_SOCKET} is created on disk")
+    else:
+        print(f"Server will log clipboard data to:")
+        print(f"  • {LOG_FILE} (human readable, no clip text)")
+        print(f"  • {JSON_LOG_FILE} (structured data)")
+        print(f"  • server.log (server activity)")
+        if CAPTURE_FILE:
+            print(f"  • {CAPTURE_FILE} (request capture for replay)")
+    extra_patterns = len(secret_redactor.extra) if secret_redactor else 0
+    print(f"Rate limits: {RATE_USER:g}/s per user (burst {RATE_USER_BURST}), {RATE_GLOBAL:g}/s in all "
+          f"(burst {RATE_GLOBAL_BURST}); 0 = none (SPILL_RATE_USER, SPILL_RATE_GLOBAL)")
+    print(f"Retention: {retention_summary()} (SPILL_RETAIN_AGE seconds, SPILL_RETAIN_CLIPS, "
+          f"SPILL_RETAIN_BYTES; 0 = no limit)")
+    print(f"Secrets in clips: {REDACT_MODE} (SPILL_REDACT=mask|drop|off; "
+          f"{extra_patterns} extra patterns from {REDACT_PATTERNS_FILE})")
+    try:
+        tls_context = make_tls_context()
+    except (ssl.SSLError, OSError) as e:
+        # Falling back to plain HTTP would send clips in the clear to clients expecting TLS
+        print(f"Cannot load {TLS_CERT} / {TLS_KEY}: {e}")
+        sys.exit(1)
+    if tls_context:
+        print(f"TLS: on ({TLS_CERT}; TLS 1.2+, session tickets, ALPN http/1.1, kernel TLS "
+              f"{'available' if kernel_tls_available() else 'unavailable (no tls module)'})")
+    else:
+        print(f"TLS: off (put {TLS_CERT} and {TLS_KEY} next to the server to turn it on)")
     print("\nEndpoints:")
     print(f"  • POST /<user_id> - Receive clipboard broadcasts")
     print(f"  • GET / - Server status and stats")
     print(f"  • GET /stats - Statistics (JSON)")
+    print(f"  • GET /healthz - Readiness probe")
+    print(f"  • GET /whoami - Transport (TLS version, cipher, resumption) and, over the Unix socket, the caller's pid/uid")
+    print(f"  • GET /metrics - Metrics (Prometheus text)")
+    print(f"  • GET /trace - Clip stage spans (Chrome trace JSON)")
+    print(f"  • GET /profile?seconds=10 - Sampled stacks (folded, for flamegraphs)")
     print(f"  • GET /logs/<user_id> - User logs (JSON)")
+    print(f"  • GET /<user_id>/clips/<n>/<format> - One format of a clip")
+    print(f"  • GET /<user_id>/latest - Latest clip (ETag, ?wait=30s)")
+    print(f"  • GET /<user_id>/search?q=text - Clips containing text, newest first")
+    print(f"  • POST /clear-logs[?user_id=] - Clear all logs, or one user's clips")
     print("=" * 60)
-    app.run(host='0.0.0.0', port=8000, debug=False, threaded=True)
+    if RING_NAME and not ring_ordered_cpu():
+        logging.warning(f"No shared-memory clip ring on {platform.machine()} (it needs x86/x64 store "
+                        f"ordering); local clips use HTTP")
+    elif RING_NAME:
+        try:
+            clip_ring = ClipRing(RING_NAME, RING_CAPACITY)
+            atexit.register(clip_ring.close)
+            threading.Thread(target=clip_ring.run, args=(receive_ring_clip,), name='clip-ring',
+                             daemon=True).start()
+            logging.info(f"Local clips arrive through shared memory ({RING_NAME}, "
+                         f"{RING_CAPACITY // (1024 * 1024)} MB ring)")
+        except Exception as e:
+            logging.warning(f"Shared-memory clip ring unavailable, local clips use HTTP: {e}")
+    threading.Thread(target=compactor.run, name='compactor', daemon=True).start()
+    # Bind before announcing, so "ready" means requests are accepted from here on
+    from werkzeug.serving import make_server
+    server = make_server('0.0.0.0', 8000, app, threaded=True)
+    if tls_context:
+        serve_tls(server, tls_context)
+    # Same protocol on a Unix socket, for same-host tools: no TCP, no port,
+    # and the kernel vouches for the caller (SO_PEERCRED)
+    if UNIX_SOCKET and hasattr(socket, 'SO_PEERCRED'):
+        umask = os.umask(0o177)  # socket file 0600
+        try:
+            unix_server = make_server('unix://' + UNIX_SOCKET, 0, app, threaded=True)
+            threading.Thread(target=unix_server.serve_forever, name='unix-listener', daemon=True).start()
+            logging.info(f"Also listening on {unix_server.server_address} (owner only)")
+        except (Exception, SystemExit) as e:  # werkzeug exits on bind errors
+            unix_server = None
+            logging.warning(f"No Unix socket listener: {e}")
+        finally:
+            os.umask(umask)
+    logging.info(f"Listening on port 8000{' (TLS)' if tls_context else ''}", extra={'event': 'ready'})
+    server.serve_forever()
 )py";
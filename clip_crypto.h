@@ -0,0 +1,906 @@
+#pragma once
+
+// End-to-end encryption of clip content: the client seals a clip with its
+// user's key before it leaves the machine, so the server (and anything
+// between, over plain HTTP) only ever holds ciphertext.
+//
+// Two AEADs with 256-bit keys. AES-256-GCM runs on AES-NI and PCLMULQDQ
+// (eight counter blocks in flight, GHASH over four blocks per reduction);
+// where the CPU lacks them, ChaCha20-Poly1305 is the faster choice, so that
+// is what PreferredClipCipher() picks there. Each cipher opens anything the
+// other machine sealed: AES also has a portable (slow) path.
+//
+// A sealed clip is a 12-byte header and then chunks of up to 64 KiB, each
+// sealed on its own (the STREAM construction), so a large clip is handled a
+// chunk at a time with constant memory on both ends:
+//
+//   'S' 'P' version cipher chunk_shift nonce_prefix[7]
+//   chunk: ciphertext + 16-byte tag; the last one may be short or empty
+//
+// Chunk i is sealed with the nonce prefix || be32(i) || last (0 or 1) and
+// with the header and the user id as associated data, so chunks can't be
+// reordered, dropped off the end or replayed under another user. The prefix
+// is random per clip. The Python client writes the same format with the
+// `cryptography` package. Nothing here depends on Win32.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define CLIP_CRYPTO_SSE2 1
+#endif
+
+#if CLIP_CRYPTO_SSE2 && (defined(__GNUC__) || defined(__clang__))
+#define CLIP_CRYPTO_AESNI 1
+#endif
+
+enum class ClipCipher : uint8_t { Aes256Gcm = 1, ChaCha20Poly1305 = 2 };
+
+const size_t kClipKeySize = 32;
+const size_t kClipTagSize = 16;
+const size_t kClipNonceSize = 12;
+const size_t kClipHeaderSize = 12;
+const size_t kClipNoncePrefixSize = 7;
+
+namespace clip_crypto_detail {
+
+inline uint32_t Load32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline void Store32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+inline uint64_t Load64Be(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v = (v << 8) | p[i];
+    return v;
+}
+
+inline void Store64Be(uint8_t* p, uint64_t v) {
+    for (int i = 7; i >= 0; i--, v >>= 8) p[i] = (uint8_t)v;
+}
+
+inline void Store32Be(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+// Tag comparison that takes the same time wherever the first difference is
+inline bool TagsEqual(const uint8_t* a, const uint8_t* b) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < kClipTagSize; i++) diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+// --- ChaCha20 (RFC 8439) ---
+
+inline uint32_t Rotl(uint32_t v, int n) { return (v << n) | (v >> (32 - n)); }
+
+#define CLIP_CHACHA_QR(a, b, c, d)              \
+    a += b; d ^= a; d = Rotl(d, 16);            \
+    c += d; b ^= c; b = Rotl(b, 12);            \
+    a += b; d ^= a; d = Rotl(d, 8);             \
+    c += d; b ^= c; b = Rotl(b, 7);
+
+inline void ChaChaBlock(const uint32_t state[16], uint8_t out[64]) {
+    uint32_t x[16];
+    memcpy(x, state, sizeof(x));
+    for (int i = 0; i < 10; i++) {
+        CLIP_CHACHA_QR(x[0], x[4], x[8], x[12])
+        CLIP_CHACHA_QR(x[1], x[5], x[9], x[13])
+        CLIP_CHACHA_QR(x[2], x[6], x[10], x[14])
+        CLIP_CHACHA_QR(x[3], x[7], x[11], x[15])
+        CLIP_CHACHA_QR(x[0], x[5], x[10], x[15])
+        CLIP_CHACHA_QR(x[1], x[6], x[11], x[12])
+        CLIP_CHACHA_QR(x[2], x[7], x[8], x[13])
+        CLIP_CHACHA_QR(x[3], x[4], x[9], x[14])
+    }
+    for (int i = 0; i < 16; i++) Store32(out + 4 * i, x[i] + state[i]);
+}
+
+#undef CLIP_CHACHA_QR
+
+#if CLIP_CRYPTO_SSE2
+inline __m128i Rotl32x4(__m128i v, int n) {
+    return _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - n));
+}
+
+// By 16: swap the halves of each word, without a temporary register
+inline __m128i Rotl32x4By16(__m128i v) {
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+}
+
+#define CLIP_CHACHA_QR4(a, b, c, d)                                      \
+    a = _mm_add_epi32(a, b); d = Rotl32x4By16(_mm_xor_si128(d, a));      \
+    c = _mm_add_epi32(c, d); b = Rotl32x4(_mm_xor_si128(b, c), 12);     \
+    a = _mm_add_epi32(a, b); d = Rotl32x4(_mm_xor_si128(d, a), 8);      \
+    c = _mm_add_epi32(c, d); b = Rotl32x4(_mm_xor_si128(b, c), 7);
+
+// Four blocks (counters state[12] .. +3) at once, one state word of all four
+// per register; XORs 256 bytes of `in` into `out`
+inline void ChaChaXor4(const uint32_t state[16], const uint8_t* in, uint8_t* out) {
+    __m128i x[16], start[16];
+    for (int i = 0; i < 16; i++) start[i] = _mm_set1_epi32((int)state[i]);
+    start[12] = _mm_add_epi32(start[12], _mm_set_epi32(3, 2, 1, 0));
+    for (int i = 0; i < 16; i++) x[i] = start[i];
+    for (int i = 0; i < 10; i++) {
+        CLIP_CHACHA_QR4(x[0], x[4], x[8], x[12])
+        CLIP_CHACHA_QR4(x[1], x[5], x[9], x[13])
+        CLIP_CHACHA_QR4(x[2], x[6], x[10], x[14])
+        CLIP_CHACHA_QR4(x[3], x[7], x[11], x[15])
+        CLIP_CHACHA_QR4(x[0], x[5], x[10], x[15])
+        CLIP_CHACHA_QR4(x[1], x[6], x[11], x[12])
+        CLIP_CHACHA_QR4(x[2], x[7], x[8], x[13])
+        CLIP_CHACHA_QR4(x[3], x[4], x[9], x[14])
+    }
+    for (int i = 0; i < 16; i++) x[i] = _mm_add_epi32(x[i], start[i]);
+    // Transpose each group of four words into 16 bytes of each block
+    for (int j = 0; j < 4; j++) {
+        __m128i t0 = _mm_unpacklo_epi32(x[4 * j], x[4 * j + 1]);
+        __m128i t1 = _mm_unpacklo_epi32(x[4 * j + 2], x[4 * j + 3]);
+        __m128i t2 = _mm_unpackhi_epi32(x[4 * j], x[4 * j + 1]);
+        __m128i t3 = _mm_unpackhi_epi32(x[4 * j + 2], x[4 * j + 3]);
+        __m128i rows[4] = {_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1),
+                           _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3)};
+        for (int b = 0; b < 4; b++) {
+            size_t at = 64 * b + 16 * j;
+            __m128i v = _mm_loadu_si128((const __m128i*)(in + at));
+            _mm_storeu_si128((__m128i*)(out + at), _mm_xor_si128(v, rows[b]));
+        }
+    }
+}
+
+#undef CLIP_CHACHA_QR4
+#endif
+
+inline void ChaChaInit(uint32_t state[16], const uint8_t key[32], uint32_t counter, const uint8_t nonce[12]) {
+    state[0] = 0x61707865;
+    state[1] = 0x3320646e;
+    state[2] = 0x79622d32;
+    state[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) state[4 + i] = Load32(key + 4 * i);
+    state[12] = counter;
+    for (int i = 0; i < 3; i++) state[13 + i] = Load32(nonce + 4 * i);
+}
+
+inline void ChaChaXor(uint32_t state[16], const uint8_t* in, uint8_t* out, size_t len) {
+#if CLIP_CRYPTO_SSE2
+    while (len >= 256) {
+        ChaChaXor4(state, in, out);
+        state[12] += 4;
+        in += 256;
+        out += 256;
+        len -= 256;
+    }
+#endif
+    uint8_t block[64];
+    while (len) {
+        ChaChaBlock(state, block);
+        state[12]++;
+        size_t n = len < 64 ? len : 64;
+        for (size_t i = 0; i < n; i++) out[i] = in[i] ^ block[i];
+        in += n;
+        out += n;
+        len -= n;
+    }
+}
+
+// --- Poly1305, 26-bit limbs ---
+
+class Poly1305 {
+public:
+    explicit Poly1305(const uint8_t key[32]) {
+        r_[0] = Load32(key + 0) & 0x3ffffff;
+        r_[1] = (Load32(key + 3) >> 2) & 0x3ffff03;
+        r_[2] = (Load32(key + 6) >> 4) & 0x3ffc0ff;
+        r_[3] = (Load32(key + 9) >> 6) & 0x3f03fff;
+        r_[4] = (Load32(key + 12) >> 8) & 0x00fffff;
+        for (int i = 0; i < 4; i++) pad_[i] = Load32(key + 16 + 4 * i);
+    }
+
+    void Update(const uint8_t* data, size_t len) {
+        if (used_) {
+            size_t n = 16 - used_ < len ? 16 - used_ : len;
+            memcpy(buffer_ + used_, data, n);
+            used_ += n;
+            data += n;
+            len -= n;
+            if (used_ < 16) return;
+            Blocks(buffer_, 16, 1u << 24);
+            used_ = 0;
+        }
+        size_t whole = len & ~(size_t)15;
+        if (whole) Blocks(data, whole, 1u << 24);
+        if (len > whole) {
+            memcpy(buffer_, data + whole, len - whole);
+            used_ = len - whole;
+        }
+    }
+
+    // Zeros up to the next 16-byte boundary, as the AEAD pads AAD and text
+    void PadTo16() {
+        static const uint8_t zeros[16] = {};
+        if (used_) Update(zeros, 16 - used_);
+    }
+
+    void Finish(uint8_t tag[16]) {
+        if (used_) {
+            buffer_[used_] = 1;
+            memset(buffer_ + used_ + 1, 0, 15 - used_);
+            Blocks(buffer_, 16, 0);
+        }
+        const uint32_t mask = 0x3ffffff;
+        uint32_t h0 = h_[0], h1 = h_[1], h2 = h_[2], h3 = h_[3], h4 = h_[4];
+        uint32_t c = h1 >> 26; h1 &= mask;
+        h2 += c; c = h2 >> 26; h2 &= mask;
+        h3 += c; c = h3 >> 26; h3 &= mask;
+        h4 += c; c = h4 >> 26; h4 &= mask;
+        h0 += c * 5; c = h0 >> 26; h0 &= mask;
+        h1 += c;
+        // h - p, kept if it didn't borrow
+        uint32_t g0 = h0 + 5; c = g0 >> 26; g0 &= mask;
+        uint32_t g1 = h1 + c; c = g1 >> 26; g1 &= mask;
+        uint32_t g2 = h2 + c; c = g2 >> 26; g2 &= mask;
+        uint32_t g3 = h3 + c; c = g3 >> 26; g3 &= mask;
+        uint32_t g4 = h4 + c - (1u << 26);
+        uint32_t keep = (g4 >> 31) - 1;  // all ones if h >= p
+        h0 = (h0 & ~keep) | (g0 & keep);
+        h1 = (h1 & ~keep) | (g1 & keep);
+        h2 = (h2 & ~keep) | (g2 & keep);
+        h3 = (h3 & ~keep) | (g3 & keep);
+        h4 = (h4 & ~keep) | (g4 & keep);
+        uint32_t w0 = h0 | (h1 << 26);
+        uint32_t w1 = (h1 >> 6) | (h2 << 20);
+        uint32_t w2 = (h2 >> 12) | (h3 << 14);
+        uint32_t w3 = (h3 >> 18) | (h4 << 8);
+        uint64_t f = (uint64_t)w0 + pad_[0];
+        Store32(tag + 0, (uint32_t)f);
+        f = (uint64_t)w1 + pad_[1] + (f >> 32);
+        Store32(tag + 4, (uint32_t)f);
+        f = (uint64_t)w2 + pad_[2] + (f >> 32);
+        Store32(tag + 8, (uint32_t)f);
+        f = (uint64_t)w3 + pad_[3] + (f >> 32);
+        Store32(tag + 12, (uint32_t)f);
+    }
+
+private:
+    void Blocks(const uint8_t* m, size_t len, uint32_t hibit) {
+        const uint32_t mask = 0x3ffffff;
+        const uint64_t r0 = r_[0], r1 = r_[1], r2 = r_[2], r3 = r_[3], r4 = r_[4];
+        const uint64_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+        uint32_t h0 = h_[0], h1 = h_[1], h2 = h_[2], h3 = h_[3], h4 = h_[4];
+        for (; len >= 16; m += 16, len -= 16) {
+            h0 += Load32(m + 0) & mask;
+            h1 += (Load32(m + 3) >> 2) & mask;
+            h2 += (Load32(m + 6) >> 4) & mask;
+            h3 += (Load32(m + 9) >> 6) & mask;
+            h4 += (Load32(m + 12) >> 8) | hibit;
+            uint64_t d0 = h0 * r0 + h1 * s4 + h2 * s3 + h3 * s2 + h4 * s1;
+            uint64_t d1 = h0 * r1 + h1 * r0 + h2 * s4 + h3 * s3 + h4 * s2;
+            uint64_t d2 = h0 * r2 + h1 * r1 + h2 * r0 + h3 * s4 + h4 * s3;
+            uint64_t d3 = h0 * r3 + h1 * r2 + h2 * r1 + h3 * r0 + h4 * s4;
+            uint64_t d4 = h0 * r4 + h1 * r3 + h2 * r2 + h3 * r1 + h4 * r0;
+            uint32_t c = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & mask;
+            d1 += c; c = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & mask;
+            d2 += c; c = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & mask;
+            d3 += c; c = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & mask;
+            d4 += c; c = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & mask;
+            h0 += c * 5; c = h0 >> 26; h0 &= mask;
+            h1 += c;
+        }
+        h_[0] = h0; h_[1] = h1; h_[2] = h2; h_[3] = h3; h_[4] = h4;
+    }
+
+    uint32_t r_[5];
+    uint32_t h_[5] = {};
+    uint32_t pad_[4];
+    uint8_t buffer_[16];
+    size_t used_ = 0;
+};
+
+// --- AES-256 ---
+
+const uint8_t kSbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+inline uint8_t Xtime(uint8_t b) { return (uint8_t)((b << 1) ^ ((b >> 7) * 0x1b)); }
+
+// FIPS-197 key schedule: 15 round keys, in the byte order AES-NI takes too
+inline void Aes256ExpandKey(const uint8_t key[32], uint8_t roundKeys[240]) {
+    memcpy(roundKeys, key, 32);
+    uint8_t rcon = 1;
+    for (int i = 8; i < 60; i++) {
+        uint8_t t[4];
+        memcpy(t, roundKeys + 4 * (i - 1), 4);
+        if (i % 8 == 0) {
+            uint8_t first = t[0];
+            t[0] = (uint8_t)(kSbox[t[1]] ^ rcon);
+            t[1] = kSbox[t[2]];
+            t[2] = kSbox[t[3]];
+            t[3] = kSbox[first];
+            rcon = Xtime(rcon);
+        } else if (i % 8 == 4) {
+            for (int k = 0; k < 4; k++) t[k] = kSbox[t[k]];
+        }
+        for (int k = 0; k < 4; k++) roundKeys[4 * i + k] = roundKeys[4 * (i - 8) + k] ^ t[k];
+    }
+}
+
+// Byte-at-a-time AES for CPUs without AES-NI. The S-box lookups depend on
+// the data, so it is neither fast nor timing-safe; such machines seal with
+// ChaCha20 and only come here to open what an AES machine sent.
+inline void Aes256EncryptBlock(const uint8_t roundKeys[240], const uint8_t in[16], uint8_t out[16]) {
+    uint8_t s[16];
+    for (int i = 0; i < 16; i++) s[i] = in[i] ^ roundKeys[i];
+    for (int round = 1; round <= 14; round++) {
+        uint8_t t[16];
+        // SubBytes + ShiftRows (the state is column-major)
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 4; r++) t[4 * c + r] = kSbox[s[4 * ((c + r) & 3) + r]];
+        }
+        if (round < 14) {
+            for (int c = 0; c < 4; c++) {
+                uint8_t* col = t + 4 * c;
+                uint8_t all = col[0] ^ col[1] ^ col[2] ^ col[3];
+                uint8_t first = col[0];
+                col[0] ^= all ^ Xtime(col[0] ^ col[1]);
+                col[1] ^= all ^ Xtime(col[1] ^ col[2]);
+                col[2] ^= all ^ Xtime(col[2] ^ col[3]);
+                col[3] ^= all ^ Xtime(col[3] ^ first);
+            }
+        }
+        for (int i = 0; i < 16; i++) s[i] = t[i] ^ roundKeys[16 * round + i];
+    }
+    memcpy(out, s, 16);
+}
+
+// GHASH multiply in GF(2^128), bit by bit (NIST SP 800-38D, algorithm 1)
+inline void GhashMultiply(uint64_t& xHi, uint64_t& xLo, uint64_t hHi, uint64_t hLo) {
+    uint64_t zHi = 0, zLo = 0, vHi = hHi, vLo = hLo;
+    for (int i = 0; i < 128; i++) {
+        uint64_t bit = i < 64 ? (xHi >> (63 - i)) & 1 : (xLo >> (127 - i)) & 1;
+        uint64_t take = 0 - bit;
+        zHi ^= vHi & take;
+        zLo ^= vLo & take;
+        uint64_t reduce = 0 - (vLo & 1);
+        vLo = (vLo >> 1) | (vHi << 63);
+        vHi = (vHi >> 1) ^ (0xe100000000000000ull & reduce);
+    }
+    xHi = zHi;
+    xLo = zLo;
+}
+
+inline void GhashPortable(const uint8_t h[16], uint8_t x[16], const uint8_t* data, size_t len) {
+    uint64_t hHi = Load64Be(h), hLo = Load64Be(h + 8);
+    uint64_t xHi = Load64Be(x), xLo = Load64Be(x + 8);
+    for (; len; ) {
+        uint8_t block[16] = {};
+        size_t n = len < 16 ? len : 16;
+        memcpy(block, data, n);
+        xHi ^= Load64Be(block);
+        xLo ^= Load64Be(block + 8);
+        GhashMultiply(xHi, xLo, hHi, hLo);
+        data += n;
+        len -= n;
+    }
+    Store64Be(x, xHi);
+    Store64Be(x + 8, xLo);
+}
+
+inline void AesCtrPortable(const uint8_t roundKeys[240], const uint8_t nonce[12], uint32_t counter,
+                           const uint8_t* in, uint8_t* out, size_t len) {
+    uint8_t block[16], stream[16];
+    memcpy(block, nonce, 12);
+    while (len) {
+        Store32Be(block + 12, counter++);
+        Aes256EncryptBlock(roundKeys, block, stream);
+        size_t n = len < 16 ? len : 16;
+        for (size_t i = 0; i < n; i++) out[i] = in[i] ^ stream[i];
+        in += n;
+        out += n;
+        len -= n;
+    }
+}
+
+#if CLIP_CRYPTO_AESNI
+inline bool HasAesNi() {
+    static const bool aesni = __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul") &&
+                              __builtin_cpu_supports("ssse3");
+    return aesni;
+}
+
+#define CLIP_AESNI_TARGET __attribute__((target("aes,pclmul,ssse3")))
+
+CLIP_AESNI_TARGET inline __m128i ByteSwap128(__m128i v) {
+    return _mm_shuffle_epi8(v, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+// Carry-less product of two byte-swapped blocks, unreduced: 256 bits in lo, hi
+CLIP_AESNI_TARGET inline void ClMul(__m128i a, __m128i b, __m128i& lo, __m128i& hi) {
+    __m128i l = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i h = _mm_clmulepi64_si128(a, b, 0x11);
+    __m128i m = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+    lo = _mm_xor_si128(lo, _mm_xor_si128(l, _mm_slli_si128(m, 8)));
+    hi = _mm_xor_si128(hi, _mm_xor_si128(h, _mm_srli_si128(m, 8)));
+}
+
+// Reduction of a 256-bit product modulo the GCM polynomial, in the
+// bit-reflected form of Intel's carry-less multiplication white paper
+CLIP_AESNI_TARGET inline __m128i GhashReduce(__m128i lo, __m128i hi) {
+    // Shift the product left by one: the operands are bit-reflected
+    __m128i carryLo = _mm_srli_epi32(lo, 31);
+    __m128i carryHi = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    __m128i cross = _mm_srli_si128(carryLo, 12);
+    carryHi = _mm_slli_si128(carryHi, 4);
+    carryLo = _mm_slli_si128(carryLo, 4);
+    lo = _mm_or_si128(lo, carryLo);
+    hi = _mm_or_si128(_mm_or_si128(hi, carryHi), cross);
+    __m128i a = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)),
+                              _mm_slli_epi32(lo, 25));
+    __m128i b = _mm_srli_si128(a, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(a, 12));
+    __m128i c = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)),
+                              _mm_srli_epi32(lo, 7));
+    c = _mm_xor_si128(c, b);
+    lo = _mm_xor_si128(lo, c);
+    return _mm_xor_si128(hi, lo);
+}
+
+// Powers H^1..H^4, byte-swapped, for four blocks per reduction
+struct GhashKey {
+    __m128i h[4];
+};
+
+CLIP_AESNI_TARGET inline void GhashKeyInit(const uint8_t hBytes[16], GhashKey& key) {
+    key.h[0] = ByteSwap128(_mm_loadu_si128((const __m128i*)hBytes));
+    for (int i = 1; i < 4; i++) {
+        __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+        ClMul(key.h[i - 1], key.h[0], lo, hi);
+        key.h[i] = GhashReduce(lo, hi);
+    }
+}
+
+// x (byte-swapped) absorbs data, zero-padded to whole blocks
+CLIP_AESNI_TARGET inline __m128i GhashAesNi(const GhashKey& key, __m128i x, const uint8_t* data, size_t len) {
+    while (len >= 64) {
+        __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+        __m128i b0 = ByteSwap128(_mm_loadu_si128((const __m128i*)data));
+        ClMul(_mm_xor_si128(x, b0), key.h[3], lo, hi);
+        ClMul(ByteSwap128(_mm_loadu_si128((const __m128i*)(data + 16))), key.h[2], lo, hi);
+        ClMul(ByteSwap128(_mm_loadu_si128((const __m128i*)(data + 32))), key.h[1], lo, hi);
+        ClMul(ByteSwap128(_mm_loadu_si128((const __m128i*)(data + 48))), key.h[0], lo, hi);
+        x = GhashReduce(lo, hi);
+        data += 64;
+        len -= 64;
+    }
+    while (len) {
+        uint8_t block[16] = {};
+        size_t n = len < 16 ? len : 16;
+        memcpy(block, data, n);
+        __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+        ClMul(_mm_xor_si128(x, ByteSwap128(_mm_loadu_si128((const __m128i*)block))), key.h[0], lo, hi);
+        x = GhashReduce(lo, hi);
+        data += n;
+        len -= n;
+    }
+    return x;
+}
+
+CLIP_AESNI_TARGET inline __m128i AesEncryptAesNi(const __m128i rk[15], __m128i block) {
+    block = _mm_xor_si128(block, rk[0]);
+    for (int i = 1; i < 14; i++) block = _mm_aesenc_si128(block, rk[i]);
+    return _mm_aesenclast_si128(block, rk[14]);
+}
+
+#define CLIP_AES_EACH8(op) op(b0, 0) op(b1, 1) op(b2, 2) op(b3, 3) op(b4, 4) op(b5, 5) op(b6, 6) op(b7, 7)
+
+// CTR mode from `counter`, eight blocks in flight so the AES units stay
+// busy. Named variables rather than an array: that keeps all eight in
+// registers through the rounds.
+CLIP_AESNI_TARGET inline void AesCtrAesNi(const __m128i rk[15], const uint8_t nonce[12], uint32_t counter,
+                                          const uint8_t* in, uint8_t* out, size_t len) {
+    const int n0 = (int)Load32(nonce), n1 = (int)Load32(nonce + 4), n2 = (int)Load32(nonce + 8);
+    while (len >= 128) {
+        __m128i b0, b1, b2, b3, b4, b5, b6, b7;
+#define CLIP_AES_START(b, i) b = _mm_xor_si128(_mm_set_epi32((int)__builtin_bswap32(counter + i), n2, n1, n0), rk[0]);
+#define CLIP_AES_ROUND(b, i) b = _mm_aesenc_si128(b, key);
+#define CLIP_AES_LAST(b, i)                                                   \
+        b = _mm_aesenclast_si128(b, rk[14]);                                  \
+        _mm_storeu_si128((__m128i*)(out + 16 * i),                            \
+                         _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + 16 * i)), b));
+        CLIP_AES_EACH8(CLIP_AES_START)
+        for (int r = 1; r < 14; r++) {
+            __m128i key = rk[r];
+            CLIP_AES_EACH8(CLIP_AES_ROUND)
+        }
+        CLIP_AES_EACH8(CLIP_AES_LAST)
+#undef CLIP_AES_START
+#undef CLIP_AES_ROUND
+#undef CLIP_AES_LAST
+        counter += 8;
+        in += 128;
+        out += 128;
+        len -= 128;
+    }
+    while (len) {
+        uint8_t stream[16];
+        __m128i block = _mm_set_epi32((int)__builtin_bswap32(counter++), n2, n1, n0);
+        _mm_storeu_si128((__m128i*)stream, AesEncryptAesNi(rk, block));
+        size_t n = len < 16 ? len : 16;
+        for (size_t i = 0; i < n; i++) out[i] = in[i] ^ stream[i];
+        in += n;
+        out += n;
+        len -= n;
+    }
+}
+
+#undef CLIP_AES_EACH8
+#endif
+
+}  // namespace clip_crypto_detail
+
+inline const char* ClipCipherName(ClipCipher cipher) {
+    return cipher == ClipCipher::Aes256Gcm ? "aes-256-gcm" : "chacha20-poly1305";
+}
+
+inline bool ParseClipCipher(std::string_view name, ClipCipher& cipher) {
+    if (name == "aes-256-gcm") cipher = ClipCipher::Aes256Gcm;
+    else if (name == "chacha20-poly1305") cipher = ClipCipher::ChaCha20Poly1305;
+    else return false;
+    return true;
+}
+
+// True if AES-GCM runs on AES-NI + PCLMULQDQ here
+inline bool ClipAesAccelerated() {
+#if CLIP_CRYPTO_AESNI
+    return clip_crypto_detail::HasAesNi();
+#else
+    return false;
+#endif
+}
+
+// AES-GCM where the CPU accelerates it, ChaCha20-Poly1305 elsewhere
+inline ClipCipher PreferredClipCipher() {
+    return ClipAesAccelerated() ? ClipCipher::Aes256Gcm : ClipCipher::ChaCha20Poly1305;
+}
+
+// One AEAD key; seals and opens single messages (the chunks of a clip)
+class ClipAead {
+public:
+    // `accelerated` = false forces the portable AES path (for comparisons)
+    ClipAead(ClipCipher cipher, const uint8_t key[kClipKeySize], bool accelerated = ClipAesAccelerated())
+        : cipher_(cipher), accelerated_(accelerated && ClipAesAccelerated()) {
+        using namespace clip_crypto_detail;
+        memcpy(key_, key, kClipKeySize);
+        if (cipher_ != ClipCipher::Aes256Gcm) return;
+        Aes256ExpandKey(key, roundKeys_);
+        static const uint8_t zero[16] = {};
+        Aes256EncryptBlock(roundKeys_, zero, h_);
+#if CLIP_CRYPTO_AESNI
+        if (accelerated_) InitAesNi();
+#endif
+    }
+
+    ClipCipher Cipher() const { return cipher_; }
+
+    // Writes len + kClipTagSize bytes to out; in and out may be the same
+    void Seal(const uint8_t nonce[kClipNonceSize], const uint8_t* aad, size_t aadLen,
+              const uint8_t* in, size_t len, uint8_t* out) const {
+        Crypt(nonce, in, out, len);
+        Tag(nonce, aad, aadLen, out, len, out + len);
+    }
+
+    // `len` includes the tag; writes len - kClipTagSize bytes, and only
+    // once the tag has checked out
+    bool Open(const uint8_t nonce[kClipNonceSize], const uint8_t* aad, size_t aadLen,
+              const uint8_t* in, size_t len, uint8_t* out) const {
+        if (len < kClipTagSize) return false;
+        len -= kClipTagSize;
+        uint8_t tag[kClipTagSize];
+        Tag(nonce, aad, aadLen, in, len, tag);
+        if (!clip_crypto_detail::TagsEqual(tag, in + len)) return false;
+        Crypt(nonce, in, out, len);
+        return true;
+    }
+
+private:
+    void Crypt(const uint8_t* nonce, const uint8_t* in, uint8_t* out, size_t len) const {
+        using namespace clip_crypto_detail;
+        if (cipher_ == ClipCipher::ChaCha20Poly1305) {
+            uint32_t state[16];
+            ChaChaInit(state, key_, 1, nonce);
+            ChaChaXor(state, in, out, len);
+            return;
+        }
+#if CLIP_CRYPTO_AESNI
+        if (accelerated_) return AesCtrAesNi((const __m128i*)roundKeysAesNi_, nonce, 2, in, out, len);
+#endif
+        AesCtrPortable(roundKeys_, nonce, 2, in, out, len);
+    }
+
+    void Tag(const uint8_t* nonce, const uint8_t* aad, size_t aadLen, const uint8_t* text, size_t len,
+             uint8_t tag[kClipTagSize]) const {
+        using namespace clip_crypto_detail;
+        if (cipher_ == ClipCipher::ChaCha20Poly1305) {
+            uint32_t state[16];
+            uint8_t block[64];
+            ChaChaInit(state, key_, 0, nonce);
+            ChaChaBlock(state, block);
+            Poly1305 mac(block);
+            mac.Update(aad, aadLen);
+            mac.PadTo16();
+            mac.Update(text, len);
+            mac.PadTo16();
+            uint8_t lengths[16];
+            Store32(lengths, (uint32_t)aadLen);
+            Store32(lengths + 4, (uint32_t)((uint64_t)aadLen >> 32));
+            Store32(lengths + 8, (uint32_t)len);
+            Store32(lengths + 12, (uint32_t)((uint64_t)len >> 32));
+            mac.Update(lengths, 16);
+            mac.Finish(tag);
+            return;
+        }
+        uint8_t lengths[16], j0[16], mask[16];
+        Store64Be(lengths, (uint64_t)aadLen * 8);
+        Store64Be(lengths + 8, (uint64_t)len * 8);
+        memcpy(j0, nonce, 12);
+        Store32Be(j0 + 12, 1);
+#if CLIP_CRYPTO_AESNI
+        if (accelerated_) {
+            const GhashKey& key = *(const GhashKey*)ghashKey_;
+            __m128i x = _mm_setzero_si128();
+            x = GhashAesNi(key, x, aad, aadLen);
+            x = GhashAesNi(key, x, text, len);
+            x = GhashAesNi(key, x, lengths, 16);
+            __m128i e = AesEncryptAesNi((const __m128i*)roundKeysAesNi_, _mm_loadu_si128((const __m128i*)j0));
+            _mm_storeu_si128((__m128i*)tag, _mm_xor_si128(ByteSwap128(x), e));
+            return;
+        }
+#endif
+        uint8_t x[16] = {};
+        GhashPortable(h_, x, aad, aadLen);
+        GhashPortable(h_, x, text, len);
+        GhashPortable(h_, x, lengths, 16);
+        Aes256EncryptBlock(roundKeys_, j0, mask);
+        for (int i = 0; i < 16; i++) tag[i] = x[i] ^ mask[i];
+    }
+
+#if CLIP_CRYPTO_AESNI
+    CLIP_AESNI_TARGET void InitAesNi() {
+        using namespace clip_crypto_detail;
+        __m128i* rk = (__m128i*)roundKeysAesNi_;
+        for (int i = 0; i < 15; i++) rk[i] = _mm_loadu_si128((const __m128i*)(roundKeys_ + 16 * i));
+        GhashKeyInit(h_, *(GhashKey*)ghashKey_);
+    }
+
+    alignas(16) uint8_t roundKeysAesNi_[240];
+    alignas(16) uint8_t ghashKey_[64];
+#endif
+
+    ClipCipher cipher_;
+    bool accelerated_;
+    uint8_t key_[kClipKeySize];
+    uint8_t roundKeys_[240];
+    uint8_t h_[16] = {};
+};
+
+// Writes a sealed clip a chunk at a time
+class ClipSealer {
+public:
+    // noncePrefix must not repeat under one key: take it from the OS's
+    // random source for every clip
+    ClipSealer(ClipCipher cipher, const uint8_t key[kClipKeySize], std::string_view userId,
+               const uint8_t noncePrefix[kClipNoncePrefixSize], int chunkShift = 16)
+        : aead_(cipher, key), chunk_((size_t)1 << chunkShift) {
+        header_[0] = 'S';
+        header_[1] = 'P';
+        header_[2] = 1;
+        header_[3] = (uint8_t)cipher;
+        header_[4] = (uint8_t)chunkShift;
+        memcpy(header_ + 5, noncePrefix, kClipNoncePrefixSize);
+        aad_.assign((const char*)header_, kClipHeaderSize);
+        aad_.append(userId.data(), userId.size());
+        pending_.reserve(chunk_);
+    }
+
+    // Appends the header (first call) and every chunk `data` completes to out
+    void Update(const void* data, size_t len, std::string& out) {
+        StartOnce(out);
+        const char* p = (const char*)data;
+        while (len) {
+            // A full chunk is held back: only Finish knows whether it is the last
+            if (pending_.size() == chunk_) {
+                Emit(pending_.data(), chunk_, false, out);
+                pending_.clear();
+            }
+            if (pending_.empty() && len > chunk_) {
+                Emit(p, chunk_, false, out);  // straight from the input, more follows
+                p += chunk_;
+                len -= chunk_;
+                continue;
+            }
+            size_t n = chunk_ - pending_.size() < len ? chunk_ - pending_.size() : len;
+            pending_.append(p, n);
+            p += n;
+            len -= n;
+        }
+    }
+
+    // Seals what is left as the last chunk (empty for an empty clip)
+    void Finish(std::string& out) {
+        StartOnce(out);
+        Emit(pending_.data(), pending_.size(), true, out);
+        pending_.clear();
+    }
+
+    // Sealed size of a clip of `len` bytes
+    size_t SealedSize(size_t len) const {
+        size_t chunks = len / chunk_ + 1;
+        if (len && len % chunk_ == 0) chunks--;
+        return kClipHeaderSize + len + chunks * kClipTagSize;
+    }
+
+private:
+    void StartOnce(std::string& out) {
+        if (started_) return;
+        out.append((const char*)header_, kClipHeaderSize);
+        started_ = true;
+    }
+
+    void Emit(const char* chunk, size_t len, bool last, std::string& out) {
+        using namespace clip_crypto_detail;
+        uint8_t nonce[kClipNonceSize];
+        memcpy(nonce, header_ + 5, kClipNoncePrefixSize);
+        Store32Be(nonce + 7, index_++);
+        nonce[11] = last ? 1 : 0;
+        size_t at = out.size();
+        out.resize(at + len + kClipTagSize);
+        aead_.Seal(nonce, (const uint8_t*)aad_.data(), aad_.size(), (const uint8_t*)chunk, len,
+                   (uint8_t*)&out[at]);
+    }
+
+    ClipAead aead_;
+    size_t chunk_;
+    uint8_t header_[kClipHeaderSize];
+    std::string aad_;
+    std::string pending_;
+    uint32_t index_ = 0;
+    bool started_ = false;
+};
+
+// Reads a sealed clip a chunk at a time; nothing unauthenticated comes out
+class ClipOpener {
+public:
+    ClipOpener(const uint8_t key[kClipKeySize], std::string_view userId) : userId_(userId) {
+        memcpy(key_, key, kClipKeySize);
+    }
+
+    // Appends the plaintext of each chunk that authenticates; false once
+    // the input is not a sealed clip for this key and user (see Error())
+    bool Update(const void* data, size_t len, std::string& out) {
+        if (error_) return false;
+        const char* p = (const char*)data;
+        if (!aead_) {
+            pending_.append(p, len);
+            if (!ReadHeader()) return !error_;
+            len = 0;  // the rest is in pending_ now
+        }
+        // A full chunk with more behind it can't be the last one
+        size_t sealedChunk = chunk_ + kClipTagSize;
+        size_t used = 0;
+        while (pending_.size() - used > sealedChunk) {
+            if (!OpenChunk(pending_.data() + used, sealedChunk, false, out)) return false;
+            used += sealedChunk;
+        }
+        pending_.erase(0, used);
+        if (!pending_.empty() && len) {
+            size_t n = sealedChunk - pending_.size() < len ? sealedChunk - pending_.size() : len;
+            pending_.append(p, n);
+            p += n;
+            len -= n;
+            if (!len) return true;
+            if (!OpenChunk(pending_.data(), sealedChunk, false, out)) return false;
+            pending_.clear();
+        }
+        // Whole chunks straight from the input
+        for (; len > sealedChunk; p += sealedChunk, len -= sealedChunk) {
+            if (!OpenChunk(p, sealedChunk, false, out)) return false;
+        }
+        pending_.append(p, len);
+        return true;
+    }
+
+    // The rest is the last chunk; true if the whole clip authenticated
+    bool Finish(std::string& out) {
+        if (error_) return false;
+        if (!aead_) return Fail("truncated header");
+        if (done_) return true;
+        if (!OpenChunk(pending_.data(), pending_.size(), true, out)) return false;
+        pending_.clear();
+        done_ = true;
+        return true;
+    }
+
+    const char* Error() const { return error_ ? error_ : ""; }
+
+private:
+    bool ReadHeader() {
+        if (pending_.size() < kClipHeaderSize) return false;
+        const uint8_t* h = (const uint8_t*)pending_.data();
+        if (h[0] != 'S' || h[1] != 'P' || h[2] != 1) return Fail("not a sealed clip");
+        if (h[3] != (uint8_t)ClipCipher::Aes256Gcm && h[3] != (uint8_t)ClipCipher::ChaCha20Poly1305) {
+            return Fail("unknown cipher");
+        }
+        if (h[4] < 10 || h[4] > 24) return Fail("bad chunk size");
+        chunk_ = (size_t)1 << h[4];
+        memcpy(prefix_, h + 5, kClipNoncePrefixSize);
+        aad_.assign(pending_.data(), kClipHeaderSize);
+        aad_ += userId_;
+        aead_.reset(new ClipAead((ClipCipher)h[3], key_));
+        pending_.erase(0, kClipHeaderSize);
+        return true;
+    }
+
+    bool OpenChunk(const char* sealed, size_t len, bool last, std::string& out) {
+        using namespace clip_crypto_detail;
+        if (len < kClipTagSize) return Fail("truncated chunk");
+        uint8_t nonce[kClipNonceSize];
+        memcpy(nonce, prefix_, kClipNoncePrefixSize);
+        Store32Be(nonce + 7, index_++);
+        nonce[11] = last ? 1 : 0;
+        size_t at = out.size();
+        out.resize(at + len - kClipTagSize);
+        if (!aead_->Open(nonce, (const uint8_t*)aad_.data(), aad_.size(), (const uint8_t*)sealed, len,
+                         (uint8_t*)&out[at])) {
+            out.resize(at);
+            return Fail("authentication failed (wrong key or user, or tampered)");
+        }
+        return true;
+    }
+
+    bool Fail(const char* error) {
+        error_ = error;
+        return false;
+    }
+
+    uint8_t key_[kClipKeySize];
+    std::string userId_;
+    std::unique_ptr<ClipAead> aead_;
+    size_t chunk_ = 0;
+    uint8_t prefix_[kClipNoncePrefixSize];
+    std::string aad_;
+    std::string pending_;
+    uint32_t index_ = 0;
+    bool done_ = false;
+    const char* error_ = nullptr;
+};
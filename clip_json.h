@@ -0,0 +1,286 @@
+#pragma once
+
+// JSON fast path for clip payloads ({"content", "timestamp", "user_id"}) and
+// other flat records such as log lines, for the native tools (loadgen,
+// replay). The Python server does not use it; its JSON goes through the
+// json module, made cheaper by appending each record once to a JSON-lines
+// log and serving stored records without re-encoding them.
+//
+// Escaping and unescaping skip over plain bytes 16 at a time with SSE2.
+// Parsing happens in place: string values are unescaped into the input
+// buffer and handed out as views, so no field allocates.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CLIP_JSON_SSE2 1
+#endif
+
+struct ClipJson {
+    std::string_view content;
+    std::string_view timestamp;
+    std::string_view userId;
+};
+
+namespace clip_json_detail {
+
+// Offset of the first byte in [s, s+len) that is '"', '\\' or a control
+// character, or len if there is none
+inline size_t FindSpecial(const char* s, size_t len) {
+    size_t i = 0;
+#if CLIP_JSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i slash = _mm_set1_epi8('\\');
+    const __m128i ctrlMax = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= len; i += 16) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(in, quote), _mm_cmpeq_epi8(in, slash));
+        // unsigned x <= 0x1F  <=>  min(x, 0x1F) == x
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_min_epu8(in, ctrlMax), in));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask) return i + __builtin_ctz(mask);
+    }
+#endif
+    for (; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\' || c < 0x20) return i;
+    }
+    return len;
+}
+
+inline int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+inline bool ReadHex4(const char* p, const char* end, uint32_t& v) {
+    if (end - p < 4) return false;
+    v = 0;
+    for (int k = 0; k < 4; k++) {
+        int h = HexValue(p[k]);
+        if (h < 0) return false;
+        v = (v << 4) | (uint32_t)h;
+    }
+    return true;
+}
+
+inline char* PutUtf8(char* out, uint32_t cp) {
+    if (cp < 0x80) {
+        *out++ = (char)cp;
+    } else if (cp < 0x800) {
+        *out++ = (char)(0xC0 | (cp >> 6));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *out++ = (char)(0xE0 | (cp >> 12));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    } else {
+        *out++ = (char)(0xF0 | (cp >> 18));
+        *out++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    }
+    return out;
+}
+
+// `p` points just past an opening quote. Unescapes the string into the same
+// buffer (output never outgrows input) and leaves `p` past the closing quote.
+inline bool UnescapeInPlace(char*& p, char* end, std::string_view& value) {
+    char* out = p;
+    char* start = p;
+    for (;;) {
+        size_t run = FindSpecial(p, end - p);
+        if (out != p) memmove(out, p, run);
+        out += run;
+        p += run;
+        if (p >= end) return false;
+
+        char c = *p++;
+        if (c == '"') break;
+        if (c != '\\' || p >= end) return false;  // raw control character
+
+        char e = *p++;
+        switch (e) {
+            case '"': *out++ = '"'; break;
+            case '\\': *out++ = '\\'; break;
+            case '/': *out++ = '/'; break;
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'u': {
+                uint32_t cp;
+                if (!ReadHex4(p, end, cp)) return false;
+                p += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    uint32_t lo;
+                    if (end - p >= 6 && p[0] == '\\' && p[1] == 'u' &&
+                        ReadHex4(p + 2, end, lo) && lo >= 0xDC00 && lo <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        p += 6;
+                    } else {
+                        cp = 0xFFFD;
+                    }
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    cp = 0xFFFD;
+                }
+                out = PutUtf8(out, cp);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    value = std::string_view(start, out - start);
+    return true;
+}
+
+// `p` points just past an opening quote; moves it past the closing quote
+// without touching the buffer
+inline bool SkipString(char*& p, char* end) {
+    for (;;) {
+        p += FindSpecial(p, end - p);
+        if (p >= end) return false;
+        char c = *p++;
+        if (c == '"') return true;
+        if (c != '\\' || p >= end) return false;
+        p++;
+    }
+}
+
+inline void SkipSpace(char*& p, char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+}
+
+// Skips a non-string value (number, literal, array or object)
+inline bool SkipValue(char*& p, char* end) {
+    int depth = 0;
+    while (p < end) {
+        char c = *p;
+        if (c == '"') {
+            p++;
+            if (!SkipString(p, end)) return false;
+            if (depth == 0) return true;
+            continue;
+        }
+        if (c == '[' || c == '{') depth++;
+        else if (c == ']' || c == '}') {
+            if (depth == 0) return true;  // end of the enclosing object
+            depth--;
+            p++;
+            if (depth == 0) return true;
+            continue;
+        } else if (depth == 0 && (c == ',' || c == ' ' || c == '\t' || c == '\n' || c == '\r')) {
+            return true;
+        }
+        p++;
+    }
+    return depth == 0;
+}
+
+} // namespace clip_json_detail
+
+// Appends `text` to `out` as a quoted JSON string
+inline void AppendJsonString(std::string& out, std::string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    out.reserve(out.size() + text.size() + 2);
+    out += '"';
+    const char* s = text.data();
+    size_t len = text.size();
+    while (len) {
+        size_t run = clip_json_detail::FindSpecial(s, len);
+        out.append(s, run);
+        if (run == len) break;
+        unsigned char c = (unsigned char)s[run];
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            default:
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xF];
+        }
+        s += run + 1;
+        len -= run + 1;
+    }
+    out += '"';
+}
+
+// Walks a JSON object in place, calling onField(key, value) for every member
+// whose value is a string and onRaw(key, text) with the literal text of every
+// other member (number, literal, array or object). Returns false on malformed
+// input; views handed out stay valid as long as `buf` does.
+template <typename OnField, typename OnRaw>
+bool ParseJsonObject(char* buf, size_t len, OnField onField, OnRaw onRaw) {
+    using namespace clip_json_detail;
+    char* p = buf;
+    char* end = buf + len;
+    SkipSpace(p, end);
+    if (p >= end || *p++ != '{') return false;
+    SkipSpace(p, end);
+    if (p < end && *p == '}') return true;
+
+    for (;;) {
+        SkipSpace(p, end);
+        if (p >= end || *p++ != '"') return false;
+        std::string_view key;
+        if (!UnescapeInPlace(p, end, key)) return false;
+        SkipSpace(p, end);
+        if (p >= end || *p++ != ':') return false;
+        SkipSpace(p, end);
+        if (p >= end) return false;
+        if (*p == '"') {
+            p++;
+            std::string_view value;
+            if (!UnescapeInPlace(p, end, value)) return false;
+            onField(key, value);
+        } else {
+            char* start = p;
+            if (!SkipValue(p, end)) return false;
+            onRaw(key, std::string_view(start, p - start));
+        }
+        SkipSpace(p, end);
+        if (p >= end) return false;
+        char c = *p++;
+        if (c == '}') return true;
+        if (c != ',') return false;
+    }
+}
+
+// String members only; everything else is skipped
+template <typename OnField>
+bool ParseJsonObject(char* buf, size_t len, OnField onField) {
+    return ParseJsonObject(buf, len, onField, [](std::string_view, std::string_view) {});
+}
+
+inline bool ParseClipJson(char* buf, size_t len, ClipJson& clip) {
+    clip = ClipJson();
+    return ParseJsonObject(buf, len, [&](std::string_view key, std::string_view value) {
+        if (key == "content") clip.content = value;
+        else if (key == "timestamp") clip.timestamp = value;
+        else if (key == "user_id") clip.userId = value;
+    });
+}
+
+inline void AppendClipJson(std::string& out, const ClipJson& clip) {
+    out += "{\"content\":";
+    AppendJsonString(out, clip.content);
+    out += ",\"timestamp\":";
+    AppendJsonString(out, clip.timestamp);
+    out += ",\"user_id\":";
+    AppendJsonString(out, clip.userId);
+    out += '}';
+}
@@ -9,10 +9,16 @@ import threading
 import time
 import requests
 import json
-import hashlib
+import mmap
+import struct
+import tempfile
+import base64
+import uuid
 from datetime import datetime
+from urllib.parse import urlparse
 import sys
 import os
+import platform
 
 if sys.platform == "win32":
     sys.stdout.reconfigure(encoding='utf-8')
@@ -21,6 +27,147 @@ if sys.platform == "win32":
 # Define WM_CLIPBOARDUPDATE if not available
 WM_CLIPBOARDUPDATE = 0x031D
 
+# Set by the spill GUI, which reads our stdout as one JSON record per line
+LOG_JSON = bool(os.environ.get('SPILL_LOG_JSON'))
+# Chosen by the GUI from the CPU: AES-GCM where AES-NI is present
+CIPHER = os.environ.get('SPILL_CIPHER', 'chacha20-poly1305')
+# Certificate to trust for an https:// server, e.g. its self-signed spill.crt;
+# unset means the system's CA store
+TLS_CA = os.environ.get('SPILL_TLS_CA') or True
+
+def log(level, *parts, event=None):
+    """print() for status lines, tagged with a level for the GUI's log channel"""
+    message = ' '.join(str(part) for part in parts)
+    if LOG_JSON:
+        record = {'ts': round(time.time(), 3), 'level': level, 'source': 'client', 'msg': message.strip('\n')}
+        if event:
+            record['event'] = event
+        print(json.dumps(record), flush=True)
+    else:
+        print(message, flush=True)
+
+class ClipRing:
+    """Producer end of the local server's shared-memory clip ring (layout in
+    shm_ring.h). The per-clip broadcast threads share it behind a lock.
+    Storing head after the record publishes it only because x86/x64 keep
+    stores in program order; open_clip_ring doesn't use it elsewhere."""
+
+    MAGIC = 0x47525053
+    VERSION = 1
+    HEADER = 192
+    HEAD, REFUSED, TAIL = 8, 9, 16  # 64-bit word indexes
+    WRAP = (0xFFFFFFFF).to_bytes(4, 'little')
+
+    def __init__(self, name):
+        header = self.open_region(name, self.HEADER)
+        ready, capacity = struct.unpack_from('<QQ', header, 0)
+        header.close()
+        if ready != self.MAGIC | self.VERSION << 32 or capacity < 64 or capacity & (capacity - 1):
+            raise ValueError("the server has not set up the ring")
+        self.capacity = capacity
+        self.region = self.open_region(name, self.HEADER + capacity)
+        view = memoryview(self.region)
+        self.words = view[:self.HEADER].cast('Q')
+        self.data = view[self.HEADER:]
+        self.lock = threading.Lock()
+        if sys.platform == 'win32':
+            import win32event
+            self.event = win32event.CreateEvent(None, False, False, 'Local\\' + name + '-doorbell')
+        else:
+            self.event = None
+            self.fifo = os.open(os.path.join(tempfile.gettempdir(), name + '.doorbell'),
+                                os.O_WRONLY | os.O_NONBLOCK)
+
+    @staticmethod
+    def open_region(name, size):
+        if sys.platform == 'win32':
+            return mmap.mmap(-1, size, tagname='Local\\' + name)
+        base = '/dev/shm' if os.path.isdir('/dev/shm') else tempfile.gettempdir()
+        fd = os.open(os.path.join(base, name), os.O_RDWR)
+        try:
+            return mmap.mmap(fd, size)
+        finally:
+            os.close(fd)
+
+    def try_write(self, payload):
+        """Copies one record in and publishes it; False if it doesn't fit
+        right now (the server counts those)"""
+        length = len(payload)
+        need = (length + 11) & ~7
+        with self.lock:
+            words = self.words
+            head = words[self.HEAD]
+            offset = head & (self.capacity - 1)
+            room = self.capacity - offset
+            skip = room if room < need else 0
+            if length > self.capacity // 2 - 4 or head + skip + need - words[self.TAIL] > self.capacity:
+                words[self.REFUSED] += 1
+                return False
+            if skip:
+                self.data[offset:offset + 4] = self.WRAP
+                head += skip
+                offset = 0
+            self.data[offset:offset + 4] = length.to_bytes(4, 'little')
+            self.data[offset + 4:offset + 4 + length] = payload
+            words[self.HEAD] = head + need
+        # CPython can't order the head store before a read of the server's
+        # sleep flag, so ring every time; it is one cheap call per clip
+        if self.event is not None:
+            import win32event
+            win32event.SetEvent(self.event)
+        else:
+            try:
+                os.write(self.fifo, b'\0')
+            except BlockingIOError:
+                pass  # already rung
+        return True
+
+class ClipSealer:
+    """Encrypts clips before they leave this machine, in the sealed format of
+    clip_crypto.h: a 12-byte header (b'SP', version, cipher, chunk shift,
+    7-byte nonce prefix), then 64 KiB chunks each sealed with the nonce
+    prefix || chunk index || last flag and the header + user id as AAD.
+    The server only ever sees the ciphertext."""
+
+    CIPHERS = {'aes-256-gcm': 1, 'chacha20-poly1305': 2}
+    VERSION = 1
+    CHUNK_SHIFT = 16
+
+    def __init__(self, key, user_id, cipher):
+        from cryptography.hazmat.primitives.ciphers.aead import AESGCM, ChaCha20Poly1305
+        self.cipher = cipher
+        self.cipher_id = self.CIPHERS[cipher]
+        self.aead = (AESGCM if cipher == 'aes-256-gcm' else ChaCha20Poly1305)(key)
+        self.user_id = user_id.encode('utf-8')
+
+    def seal(self, data):
+        """data (bytes) sealed, header included"""
+        prefix = os.urandom(7)
+        header = b'SP' + bytes([self.VERSION, self.cipher_id, self.CHUNK_SHIFT]) + prefix
+        aad = header + self.user_id
+        chunk = 1 << self.CHUNK_SHIFT
+        count = max(1, -(-len(data) // chunk))  # an empty clip is one empty chunk
+        view = memoryview(data)
+        out = [header]
+        for i in range(count):
+            nonce = prefix + struct.pack('>IB', i, i == count - 1)
+            out.append(self.aead.encrypt(nonce, view[i * chunk:(i + 1) * chunk], aad))
+        return b''.join(out)
+
+    @classmethod
+    def load(cls, user_id):
+        """A sealer for the key in keys/<user_id>.key (64 hex digits) next to
+        this script; None means clips go out in the clear"""
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'keys', user_id + '.key')
+        try:
+            with open(path) as f:
+                key = bytes.fromhex(f.read().strip())
+        except FileNotFoundError:
+            return None
+        if len(key) != 32:
+            raise ValueError(f"{path} must hold a 256-bit key as 64 hex digits")
+        return cls(key, user_id, CIPHER if CIPHER in cls.CIPHERS else 'chacha20-poly1305')
+
 class ClipboardMonitor:
     def __init__(self, server_url, user_id):
         self.server_url = server_url.rstrip('/')
@@ -30,61 +177,190 @@ class ClipboardMonitor:
         self.running = False
         self.window_handle = None
         self.polling_mode = False
+        self.ring = None  # shared-memory path to a server on this machine
+        self.sealer = None  # set when the user has a key; clips go out encrypted
+        self.offered = None  # (broadcast number, clipboard sequence) of our clip with formats still to give
+        # Kept-alive connections, so over TLS a clip doesn't pay for a handshake
+        self.http = requests.Session()
+        self.http.verify = TLS_CA
+        # Clip formats we understand, cheapest first (matches the server)
+        self.formats = [
+            ('text', win32con.CF_UNICODETEXT),
+            ('html', win32clipboard.RegisterClipboardFormat("HTML Format")),
+            ('rtf', win32clipboard.RegisterClipboardFormat("Rich Text Format")),
+            ('files', win32con.CF_HDROP),
+        ]
         
-    def get_clipboard_text(self):
-        """Get text from Windows clipboard"""
+    def available_formats(self):
+        """Formats currently on the clipboard, in our order (clipboard must be open)"""
+        return [name for name, fmt in self.formats
+                if win32clipboard.IsClipboardFormatAvailable(fmt)]
+    
+    def read_format(self, name):
+        """Materialize one format as bytes (clipboard must be open)"""
+        data = win32clipboard.GetClipboardData(dict(self.formats)[name])
+        if name == 'text':
+            return data.encode('utf-8')
+        if name == 'files':
+            return '\n'.join(data).encode('utf-8')
+        return bytes(data).rstrip(b'\0')
+    
+    def get_clipboard_clip(self):
+        """Capture only the cheapest available format, plus what else is offered"""
         try:
             win32clipboard.OpenClipboard()
-            if win32clipboard.IsClipboardFormatAvailable(win32con.CF_UNICODETEXT):
-                data = win32clipboard.GetClipboardData(win32con.CF_UNICODETEXT)
-                win32clipboard.CloseClipboard()
-                return data
-            else:
+            try:
+                formats = self.available_formats()
+                if not formats:
+                    return None
+                if formats[0] == 'text':
+                    content = win32clipboard.GetClipboardData(win32con.CF_UNICODETEXT)
+                else:
+                    content = self.read_format(formats[0]).decode('utf-8', 'replace')
+                return {
+                    'format': formats[0],
+                    'formats': formats,
+                    'content': content,
+                    'sequence': win32clipboard.GetClipboardSequenceNumber()
+                }
+            finally:
                 win32clipboard.CloseClipboard()
-                return None
         except Exception as e:
-            print(f"Error reading clipboard: {e}")
+            log('error', f"Error reading clipboard: {e}")
             try:
                 win32clipboard.CloseClipboard()
             except:
                 pass
             return None
     
+    def upload_formats(self, broadcast_number, wanted, sequence):
+        """Send richer formats a consumer asked for, if the clip is still current"""
+        for name in wanted:
+            try:
+                win32clipboard.OpenClipboard()
+                try:
+                    if win32clipboard.GetClipboardSequenceNumber() != sequence:
+                        log('info', "Clipboard moved on; skipping lazy formats")
+                        return
+                    payload = self.read_format(name)
+                finally:
+                    win32clipboard.CloseClipboard()
+                response = self.http.put(
+                    f"{self.endpoint}/clips/{broadcast_number}/{name}",
+                    data=payload,
+                    headers={'Content-Type': 'application/octet-stream'},
+                    timeout=5
+                )
+                if response.status_code == 200:
+                    log('info', f"✓ Uploaded {name} for #{broadcast_number} ({len(payload)} bytes)")
+                elif response.status_code == 422:
+                    log('warning', f"Server dropped {name} for #{broadcast_number}, it contains secrets")
+                elif response.status_code in (429, 503):
+                    log('warning', f"Server turned {name} for #{broadcast_number} away ({response.status_code})")
+                    return
+                else:
+                    log('error', f"✗ Upload of {name} failed with status: {response.status_code}")
+            except Exception as e:
+                log('error', f"✗ Format upload error ({name}): {e}")
+    
+    def watch_wanted(self):
+        """Long-polls the server for formats consumers asked of our latest
+        clip and uploads them while it is still on the clipboard"""
+        after = 0
+        while self.running:
+            try:
+                response = self.http.get(f"{self.endpoint}/wanted",
+                                         params={'after': after, 'wait': '30s'}, timeout=40)
+                if response.status_code != 200:
+                    time.sleep(5)
+                    continue
+                result = response.json()
+                # A restarted server numbers its requests from zero again
+                after = result['serial'] if result['serial'] >= after else 0
+                for item in result['wanted']:
+                    if self.offered and item['broadcast_number'] == self.offered[0]:
+                        self.upload_formats(item['broadcast_number'], item['formats'], self.offered[1])
+            except Exception as e:
+                log('error', f"✗ Format request poll error: {e}")
+                time.sleep(5)
+    
     def hash_content(self, content):
         """Create hash of content to detect changes"""
         if content is None:
             return None
-        return hashlib.md5(content.encode('utf-8')).hexdigest()
+        # str hashes are computed natively and cached on the object, so no
+        # UTF-8 copy of the clip is made just to detect a change
+        return hash(content)
     
-    def broadcast_clipboard(self, content):
+    def broadcast_clipboard(self, clip):
         """Send clipboard content to server"""
+        content = clip['content']
+        trace = clip['trace']
+        send_start = time.perf_counter_ns()
+        trace['stages'].append(('queue', trace.pop('queued_ns'), send_start))
+        trace['send_ns'] = send_start
         try:
             payload = {
                 'content': content,
                 'timestamp': datetime.now().isoformat(),
-                'user_id': self.user_id
+                'user_id': self.user_id,
+                'format': clip['format'],
+                'formats': clip['formats'],
+                'trace': trace
             }
+            if self.sealer:
+                # Only the primary format is sealed; the server can't ask
+                # for richer ones it would see in the clear
+                sealed = self.sealer.seal(content.encode('utf-8', 'surrogatepass'))
+                payload['content'] = base64.b64encode(sealed).decode('ascii')
+                payload['sealed'] = self.sealer.cipher
+                payload['formats'] = clip['formats'] = [clip['format']]
+                sealed_ns = time.perf_counter_ns()
+                trace['stages'].append(('seal', send_start, sealed_ns))
+                trace['send_ns'] = sealed_ns
+            
+            body = json.dumps(payload)
+            # Clips with richer formats need the reply in case a consumer wants one
+            if self.ring and len(clip['formats']) == 1 and self.ring.try_write(body.encode('utf-8')):
+                elapsed_ms = (time.perf_counter_ns() - trace['stages'][0][1]) / 1e6
+                log('info', f"✓ Broadcasted clipboard content (length: {len(content)} chars, "
+                      f"{elapsed_ms:.1f} ms since copy, trace {trace['id']}, shared memory)")
+                return
             
             headers = {
                 'Content-Type': 'application/json'
             }
             
-            response = requests.post(
+            response = self.http.post(
                 self.endpoint, 
-                data=json.dumps(payload), 
+                data=body, 
                 headers=headers,
                 timeout=5
             )
             
             if response.status_code == 200:
-                print(f"✓ Broadcasted clipboard content (length: {len(content)} chars)")
+                elapsed_ms = (time.perf_counter_ns() - trace['stages'][0][1]) / 1e6
+                log('info', f"✓ Broadcasted clipboard content (length: {len(content)} chars, "
+                      f"{elapsed_ms:.1f} ms since copy, trace {trace['id']})")
+                result = response.json()
+                if result.get('redacted'):
+                    log('warning', f"Server masked secrets in the clip: {', '.join(result['redacted'])}")
+                if len(clip['formats']) > 1:
+                    self.offered = (result.get('broadcast_number'), clip['sequence'])
+            elif response.status_code == 422:
+                kinds = response.json().get('redacted') or []
+                log('warning', f"Server dropped the clip, it contains secrets: {', '.join(kinds)}")
+            elif response.status_code in (429, 503):
+                # Copying faster than the server admits; the next copy goes through
+                log('warning', f"Server turned the clip away ({response.status_code}), "
+                      f"retry after {response.headers.get('Retry-After', '?')} s")
             else:
-                print(f"✗ Server responded with status: {response.status_code}")
+                log('error', f"✗ Server responded with status: {response.status_code}")
                 
         except requests.exceptions.RequestException as e:
-            print(f"✗ Network error: {e}")
+            log('error', f"✗ Network error: {e}")
         except Exception as e:
-            print(f"✗ Broadcast error: {e}")
+            log('error', f"✗ Broadcast error: {e}")
     
     def clipboard_wndproc(self, hwnd, msg, wparam, lparam):
         """Windows message handler for clipboard changes"""
@@ -103,24 +379,35 @@ class ClipboardMonitor:
                     win32gui.SendMessage(wparam, msg, wparam, lparam)
             return 0
         except Exception as e:
-            print(f"Error in window procedure: {e}")
+            log('error', f"Error in window procedure: {e}")
             return win32gui.DefWindowProc(hwnd, msg, wparam, lparam)
     
     def on_clipboard_change(self):
         """Handle clipboard change event"""
-        content = self.get_clipboard_text()
-        if content is not None:
+        capture_start = time.perf_counter_ns()
+        clip = self.get_clipboard_clip()
+        if clip is not None:
+            hash_start = time.perf_counter_ns()
+            content = clip['content']
             content_hash = self.hash_content(content)
+            hashed = time.perf_counter_ns()
             
             # Only broadcast if content actually changed
             if content_hash != self.last_clipboard_hash:
                 self.last_clipboard_hash = content_hash
-                print(f"Clipboard changed: {content[:50]}{'...' if len(content) > 50 else ''}")
+                log('info', f"Clipboard changed: {content[:50]}{'...' if len(content) > 50 else ''}")
+                # Stage timestamps travel with the clip; the server records them
+                clip['trace'] = {
+                    'id': uuid.uuid4().hex[:16],
+                    'stages': [('capture', capture_start, hash_start),
+                               ('hash', hash_start, hashed)],
+                    'queued_ns': hashed
+                }
                 
                 # Broadcast in separate thread to avoid blocking
                 threading.Thread(
                     target=self.broadcast_clipboard, 
-                    args=(content,), 
+                    args=(clip,), 
                     daemon=True
                 ).start()
     
@@ -147,17 +434,20 @@ class ClipboardMonitor:
     
     def start_monitoring(self):
         """Start monitoring clipboard changes"""
-        print(f"Starting clipboard monitor...")
-        print(f"Broadcasting to: {self.endpoint}")
-        print(f"User ID: {self.user_id}")
-        print("Press Ctrl+C to stop\n")
+        log('info', f"Starting clipboard monitor...")
+        log('info', f"Broadcasting to: {self.endpoint}")
+        log('info', f"User ID: {self.user_id}")
+        log('info', "Press Ctrl+C to stop\n")
+        
+        self.running = True
+        threading.Thread(target=self.watch_wanted, daemon=True).start()
         
         # Try modern approach first, fallback to polling if needed
         try:
             self._start_event_monitoring()
         except Exception as e:
-            print(f"Event monitoring failed: {e}")
-            print("Falling back to polling mode...")
+            log('error', f"Event monitoring failed: {e}")
+            log('warning', "Falling back to polling mode...")
             self._start_polling_monitoring()
     
     def _start_event_monitoring(self):
@@ -177,22 +467,23 @@ class ClipboardMonitor:
                     success = user32.AddClipboardFormatListener(self.window_handle)
                     if not success:
                         raise Exception("AddClipboardFormatListener failed")
-                    print("✓ Using modern clipboard listener")
+                    log('info', "✓ Using modern clipboard listener", event='ready')
                 else:
                     raise Exception("AddClipboardFormatListener not available")
                     
             except Exception:
                 # Fallback to old clipboard viewer chain
-                print("✓ Using legacy clipboard viewer chain")
+                log('info', "✓ Using legacy clipboard viewer chain", event='ready')
                 win32clipboard.SetClipboardViewer(self.window_handle)
             
             self.running = True
             
             # Get initial clipboard content
-            initial_content = self.get_clipboard_text()
+            initial_clip = self.get_clipboard_clip()
+            initial_content = initial_clip['content'] if initial_clip else None
             if initial_content:
                 self.last_clipboard_hash = self.hash_content(initial_content)
-                print(f"Initial clipboard: {initial_content[:50]}{'...' if len(initial_content) > 50 else ''}")
+                log('info', f"Initial clipboard: {initial_content[:50]}{'...' if len(initial_content) > 50 else ''}")
             
             # Message loop
             while self.running:
@@ -206,9 +497,9 @@ class ClipboardMonitor:
                     break
                     
         except KeyboardInterrupt:
-            print("\nStopping clipboard monitor...")
+            log('info', "\nStopping clipboard monitor...")
         except Exception as e:
-            print(f"Event monitoring error: {e}")
+            log('error', f"Event monitoring error: {e}")
             raise
         finally:
             self.stop_monitoring()
@@ -218,45 +509,32 @@ class ClipboardMonitor:
         self.polling_mode = True
         self.running = True
         
-        print("✓ Using polling mode (checking every 0.5 seconds)")
+        log('info', "✓ Using polling mode (checking every 0.5 seconds)", event='ready')
         
         # Get initial clipboard content
-        initial_content = self.get_clipboard_text()
+        initial_clip = self.get_clipboard_clip()
+        initial_content = initial_clip['content'] if initial_clip else None
         if initial_content:
             self.last_clipboard_hash = self.hash_content(initial_content)
-            print(f"Initial clipboard: {initial_content[:50]}{'...' if len(initial_content) > 50 else ''}")
+            log('info', f"Initial clipboard: {initial_content[:50]}{'...' if len(initial_content) > 50 else ''}")
         
         try:
             while self.running:
                 try:
-                    current_content = self.get_clipboard_text()
-                    if current_content is not None:
-                        current_hash = self.hash_content(current_content)
-                        
-                        if current_hash != self.last_clipboard_hash:
-                            self.last_clipboard_hash = current_hash
-                            print(f"Clipboard changed: {current_content[:50]}{'...' if len(current_content) > 50 else ''}")
-                            
-                            # Broadcast in separate thread
-                            threading.Thread(
-                                target=self.broadcast_clipboard, 
-                                args=(current_content,), 
-                                daemon=True
-                            ).start()
-                    
+                    self.on_clipboard_change()
                     time.sleep(0.5)  # Check every 500ms
                     
                 except KeyboardInterrupt:
                     break
                 except Exception as e:
-                    print(f"Polling error: {e}")
+                    log('error', f"Polling error: {e}")
                     time.sleep(1)  # Wait longer on error
                     
         except KeyboardInterrupt:
-            print("\nStopping clipboard monitor...")
+            log('info', "\nStopping clipboard monitor...")
         finally:
             self.running = False
-            print("Clipboard monitoring stopped.")
+            log('info', "Clipboard monitoring stopped.")
     
     def stop_monitoring(self):
         """Stop monitoring and cleanup"""
@@ -274,10 +552,41 @@ class ClipboardMonitor:
                 
                 win32gui.DestroyWindow(self.window_handle)
             except Exception as e:
-                print(f"Cleanup warning: {e}")
+                log('warning', f"Cleanup warning: {e}")
         
         if not self.polling_mode:
-            print("Clipboard monitoring stopped.")
+            log('info', "Clipboard monitoring stopped.")
+
+def open_clip_ring(url):
+    """The local server's clip ring, if the GUI named one and url points at
+    this machine; None means HTTP for everything"""
+    name = os.environ.get('SPILL_RING')
+    if not name or urlparse(url).hostname not in ('localhost', '127.0.0.1', '::1'):
+        return None
+    if platform.machine().lower() not in ('x86_64', 'amd64', 'x86', 'i386', 'i686'):
+        log('info', f"No shared-memory ring on {platform.machine()} (it needs x86/x64 store ordering), using HTTP")
+        return None
+    try:
+        ring = ClipRing(name)
+    except Exception as e:
+        log('warning', f"Shared-memory ring unavailable, using HTTP: {e}")
+        return None
+    log('info', f"✓ Clips go to the server through shared memory ({ring.capacity // 1024} KB ring)")
+    return ring
+
+def wait_for_server(url, timeout=10.0):
+    """Polls url with a growing delay (50 ms doubling to 1 s) until it answers"""
+    deadline = time.monotonic() + timeout
+    delay = 0.05
+    while True:
+        try:
+            requests.get(url, timeout=5, verify=TLS_CA)
+            return True
+        except requests.exceptions.RequestException:
+            if time.monotonic() + delay > deadline:
+                return False
+            time.sleep(delay)
+            delay = min(delay * 2, 1.0)
 
 def main():
     # Configuration - modify these values
@@ -290,28 +599,36 @@ def main():
     if len(sys.argv) >= 3:
         USER_ID = sys.argv[2]
     
-    print("=" * 60)
-    print("Windows Clipboard Monitor & Broadcaster")
-    print("=" * 60)
+    log('info', "=" * 60)
+    log('info', "Windows Clipboard Monitor & Broadcaster")
+    log('info', "=" * 60)
     
-    # Test server connectivity
-    try:
-        test_url = SERVER_URL.rstrip('/')
-        response = requests.get(test_url, timeout=5)
-        print(f"✓ Server accessible at {SERVER_URL}")
-    except requests.exceptions.RequestException:
-        print(f"⚠ Warning: Cannot reach server at {SERVER_URL}")
-        print("  The app will still monitor clipboard but broadcasts may fail.")
+    # Test server connectivity. The GUI starts the server alongside us, so
+    # give it a moment to bind before concluding it is not there.
+    if wait_for_server(SERVER_URL.rstrip('/')):
+        log('info', f"✓ Server accessible at {SERVER_URL}")
+    else:
+        log('warning', f"⚠ Warning: Cannot reach server at {SERVER_URL}")
+        log('warning', "  The app will still monitor clipboard but broadcasts may fail.")
     
     # Create and start monitor
     monitor = ClipboardMonitor(SERVER_URL, USER_ID)
+    monitor.ring = open_clip_ring(SERVER_URL)
+    try:
+        monitor.sealer = ClipSealer.load(USER_ID)
+    except Exception as e:
+        # A key that can't be used must not mean clips quietly go out in the clear
+        log('error', f"Fatal error: cannot encrypt clips: {e}")
+        sys.exit(1)
+    if monitor.sealer:
+        log('info', f"✓ Clips are encrypted with {monitor.sealer.cipher} before they leave this machine")
     
     try:
         monitor.start_monitoring()
     except KeyboardInterrupt:
-        print("\nShutting down...")
+        log('info', "\nShutting down...")
     except Exception as e:
-        print(f"Fatal error: {e}")
+        log('error', f"Fatal error: {e}")
         sys.exit(1)
 
 if __name__ == "__main__":
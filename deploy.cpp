@@ -0,0 +1,139 @@
+// Brings the broadcast server up on a host over SSH, the way the GUI's
+// external mode does, then waits for it to answer /healthz (Linux).
+//
+// One ssh round trip stages the script, checks the venv against its stamp
+// and restarts the server; a ControlMaster socket is kept for a while so a
+// following run or --stop reuses the connection. --ssh=local swaps ssh for a
+// local `sh -s`, which runs the same pipeline against this machine.
+//
+//   deploy --host=example.org
+//   deploy --host=127.0.0.1 --ssh=local --dir=/tmp/spill-remote
+//   deploy --host=example.org --stop
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "broadcast_embed.h"
+#include "http_client.h"
+#include "posix_runner.h"
+#include "remote_deploy.h"
+
+struct Options {
+    std::string host;
+    std::string user = "root";
+    std::string dir = "/tmp";
+    std::string port = "8000";
+    std::string ssh = "ssh";       // "local" runs the script with sh on this machine
+    std::string packages = "flask requests";
+    int timeout = 600;             // seconds for the SSH step
+    int readyBudget = 15;          // seconds of /healthz polling
+    bool multiplex = true;
+    bool stop = false;
+    bool tls = false;              // the server has a certificate; probe over https
+    HttpTlsOptions tlsOptions;
+};
+
+static double MsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Usage() {
+    fprintf(stderr,
+        "usage: deploy --host=HOST [options]\n"
+        "  --host=HOST            machine to run the broadcast server on\n"
+        "  --user=NAME            SSH user (default root)\n"
+        "  --dir=PATH             remote working directory (default /tmp)\n"
+        "  --port=N               server port probed for /healthz (default 8000)\n"
+        "  --ssh=CMD|local        ssh command (default ssh); local runs the script\n"
+        "                         with sh on this machine instead\n"
+        "  --packages=LIST        pip packages for the remote venv (default \"flask requests\")\n"
+        "  --timeout=S            limit for the SSH step (default 600)\n"
+        "  --ready-timeout=S      how long to poll /healthz (default 15)\n"
+        "  --no-multiplex         don't keep a ControlMaster connection\n"
+        "  --tls                  probe /healthz over https (spill.crt + spill.key in --dir)\n"
+        HTTP_TLS_USAGE
+        "  --stop                 stop the server and remove its script instead\n");
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        bool ok = true;
+        if (key == "--host") opt.host = value;
+        else if (key == "--user") opt.user = value;
+        else if (key == "--dir") opt.dir = value;
+        else if (key == "--port") opt.port = value;
+        else if (key == "--ssh") opt.ssh = value;
+        else if (key == "--packages") opt.packages = value;
+        else if (key == "--timeout") { opt.timeout = atoi(value.c_str()); ok = opt.timeout > 0; }
+        else if (key == "--ready-timeout") { opt.readyBudget = atoi(value.c_str()); ok = opt.readyBudget >= 0; }
+        else if (key == "--no-multiplex") opt.multiplex = false;
+        else if (key == "--stop") opt.stop = true;
+        else if (key == "--tls") opt.tls = true;
+        else if (ParseHttpTlsOption(key, value, opt.tlsOptions)) {}
+        else if (key == "--help" || key == "-h") { Usage(); return 0; }
+        else ok = false;
+        if (!ok) {
+            fprintf(stderr, "deploy: bad argument '%s'\n", arg.c_str());
+            Usage();
+            return 2;
+        }
+    }
+    if (opt.host.empty() || opt.dir.empty()) {
+        Usage();
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    bool local = opt.ssh == "local";
+    RemoteTarget target;
+    target.host = opt.host;
+    target.user = opt.user;
+    target.dir = opt.dir;
+    target.sshCommand = local ? "ssh" : opt.ssh;
+    if (opt.multiplex && !local) target.controlPath = "~/.ssh/spill-%C";
+
+    PosixRunner runner(local);
+    RemoteDeployer deployer(runner, target);
+    auto start = std::chrono::steady_clock::now();
+
+    if (opt.stop) {
+        DeployStatus status = deployer.Stop(opt.timeout * 1000);
+        printf("stop: %s in %.0f ms\n", DeployStatusText(status), MsSince(start));
+        return status == DeployStatus::Ok ? 0 : 1;
+    }
+
+    DeployStatus status = deployer.BringUp(broadcast_py, opt.packages, opt.timeout * 1000);
+    double bringUpMs = MsSince(start);
+    if (status != DeployStatus::Ok) {
+        fprintf(stderr, "deploy: %s (exit %d) after %.0f ms\n", DeployStatusText(status),
+                deployer.ExitCode(), bringUpMs);
+        return 1;
+    }
+    printf("bring-up: one round trip in %.0f ms\n", bringUpMs);
+
+    HttpConnection connection(opt.host, opt.port);
+    if (opt.tls && !connection.UseTls(opt.tlsOptions)) {
+        fprintf(stderr, "deploy: cannot set up TLS (built without HTTP_CLIENT_TLS, or a bad --cafile)\n");
+        return 1;
+    }
+    auto probe = [&] {
+        HttpResponse response;
+        bool up = connection.Request("GET", "/healthz", "", nullptr, response) && response.status == 200;
+        if (!up) connection.Close();
+        return up;
+    };
+    int attempts = 0;
+    auto probeStart = std::chrono::steady_clock::now();
+    bool ready = WaitUntilReady(probe, Backoff(50, 1000, opt.readyBudget * 1000), &attempts);
+    printf("healthz: %s after %.0f ms (%d probes); %.0f ms from start\n", ready ? "ready" : "not ready",
+           MsSince(probeStart), attempts, MsSince(start));
+    return ready ? 0 : 1;
+}
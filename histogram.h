@@ -0,0 +1,68 @@
+#pragma once
+
+// Log-linear (HDR-style) histogram of non-negative integers. Same bucket
+// layout as the server's /metrics histograms: 32 sub-buckets per power of
+// two, so any recorded value is reported within ~3%.
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+class HdrHistogram {
+public:
+    static const int kSubBits = 5;
+    static const int kSubCount = 1 << kSubBits;
+    static const int kMagnitudes = 48;
+
+    HdrHistogram() : counts_(kSubCount * kMagnitudes, 0) {}
+
+    static int Index(uint64_t value) {
+        if (value < (uint64_t)kSubCount) return (int)value;
+        int shift = 63 - __builtin_clzll(value) - kSubBits;
+        int index = kSubCount * shift + (int)(value >> shift);
+        return std::min(index, kSubCount * kMagnitudes - 1);
+    }
+
+    // Upper edge of a bucket
+    static uint64_t ValueAt(int index) {
+        if (index < kSubCount) return (uint64_t)index;
+        int shift = index / kSubCount - 1;
+        return (((uint64_t)(index % kSubCount + kSubCount + 1)) << shift) - 1;
+    }
+
+    void Record(uint64_t value) {
+        counts_[Index(value)]++;
+        count_++;
+        sum_ += value;
+        max_ = std::max(max_, value);
+    }
+
+    void Merge(const HdrHistogram& other) {
+        for (size_t i = 0; i < counts_.size(); i++) counts_[i] += other.counts_[i];
+        count_ += other.count_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    uint64_t Quantile(double q) const {
+        if (!count_) return 0;
+        uint64_t rank = std::max<uint64_t>(1, (uint64_t)(q * count_ + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); i++) {
+            seen += counts_[i];
+            if (seen >= rank) return std::min(ValueAt((int)i), max_);
+        }
+        return max_;
+    }
+
+    uint64_t Count() const { return count_; }
+    uint64_t Sum() const { return sum_; }
+    uint64_t Max() const { return max_; }
+    double Mean() const { return count_ ? (double)sum_ / count_ : 0.0; }
+
+private:
+    std::vector<uint64_t> counts_;
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t max_ = 0;
+};
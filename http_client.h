@@ -0,0 +1,436 @@
+#pragma once
+
+// Minimal blocking HTTP/1.1 client over POSIX sockets, for the Linux-side
+// tools (load generator, replay). Keeps the connection alive when the server
+// allows it and reconnects transparently when it does not. Speaks TCP, or
+// the server's Unix socket for same-host runs, and https:// when built with
+// HTTP_CLIENT_TLS (OpenSSL): reconnects then offer the last session ticket,
+// and the handshakes are counted so their cost can be measured.
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef HTTP_CLIENT_TLS
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+struct HttpResponse {
+    int status = 0;
+    size_t bodyBytes = 0;
+    std::string body;  // only filled when the caller asks for it
+};
+
+// How https:// connections are made
+struct HttpTlsOptions {
+    std::string caFile;  // certificate to trust, e.g. the server's self-signed spill.crt; empty = system store
+    bool verify = true;  // false accepts any certificate
+    bool resume = true;  // offer the previous connection's session when reconnecting
+};
+
+// Handshakes made by one connection
+struct HttpTlsStats {
+    uint64_t full = 0, resumed = 0;
+    uint64_t fullNs = 0, resumedNs = 0;
+    uint64_t kernelSend = 0;  // handshakes after which the kernel encrypts what we send (kTLS)
+
+    void Merge(const HttpTlsStats& other) {
+        full += other.full;
+        resumed += other.resumed;
+        fullNs += other.fullNs;
+        resumedNs += other.resumedNs;
+        kernelSend += other.kernelSend;
+    }
+};
+
+// The tools' shared TLS flags; true if `key` was one of them
+inline bool ParseHttpTlsOption(const std::string& key, const std::string& value, HttpTlsOptions& tls) {
+    if (key == "--cafile") tls.caFile = value;
+    else if (key == "--insecure") tls.verify = false;
+    else if (key == "--no-resume") tls.resume = false;
+    else return false;
+    return true;
+}
+
+#define HTTP_TLS_USAGE \
+    "  --cafile=PATH          https://: trust this certificate (e.g. the server's spill.crt)\n" \
+    "  --insecure             https://: accept any certificate\n" \
+    "  --no-resume            https://: full handshake on every new connection\n"
+
+// Splits "http://host:port/prefix" into parts. "unix:/path/spill.sock" gives
+// the socket path as host and an empty port. "https://" is accepted when the
+// caller passes `tls` (set to true then). False for anything else.
+inline bool ParseHttpUrl(const std::string& url, std::string& host, std::string& port, std::string& prefix,
+                         bool* tls = nullptr) {
+    const std::string unixScheme = "unix:";
+    if (tls) *tls = false;
+    if (url.compare(0, unixScheme.size(), unixScheme) == 0) {
+        host = url.substr(unixScheme.size());
+        port.clear();
+        prefix.clear();
+        return !host.empty();
+    }
+    std::string scheme = "http://";
+    if (tls && url.compare(0, 8, "https://") == 0) {
+        scheme = "https://";
+        *tls = true;
+    }
+    if (url.compare(0, scheme.size(), scheme) != 0) return false;
+    std::string rest = url.substr(scheme.size());
+    size_t slash = rest.find('/');
+    std::string authority = rest.substr(0, slash);
+    prefix = slash == std::string::npos ? "" : rest.substr(slash);
+    while (!prefix.empty() && prefix.back() == '/') prefix.pop_back();
+    size_t colon = authority.rfind(':');
+    if (colon == std::string::npos) {
+        host = authority;
+        port = tls && *tls ? "443" : "80";
+    } else {
+        host = authority.substr(0, colon);
+        port = authority.substr(colon + 1);
+    }
+    return !host.empty();
+}
+
+class HttpConnection {
+public:
+    // An empty port means host is the path of a Unix socket
+    HttpConnection(std::string host, std::string port)
+        : host_(std::move(host)), port_(std::move(port)) {}
+    ~HttpConnection() {
+        Close();
+#ifdef HTTP_CLIENT_TLS
+        if (session_) SSL_SESSION_free(session_);
+        if (ctx_) SSL_CTX_free(ctx_);
+#endif
+    }
+
+    HttpConnection(const HttpConnection&) = delete;
+    HttpConnection& operator=(const HttpConnection&) = delete;
+
+    // Sends one request and reads the whole response. Retries once on a
+    // fresh connection if a kept-alive one turned out to be closed.
+    bool Request(const char* method, const std::string& path, std::string_view body,
+                 const char* contentType, HttpResponse& response, bool keepBody = false) {
+        for (int attempt = 0; attempt < 2; attempt++) {
+            bool reused = fd_ >= 0;
+            if (!reused && !Connect()) return false;
+            if (Exchange(method, path, body, contentType, response, keepBody)) return true;
+            Close();
+            if (!reused) return false;
+        }
+        return false;
+    }
+
+    // Makes every connection https://. False if the tools were built
+    // without HTTP_CLIENT_TLS or the CA file can't be loaded.
+    bool UseTls(const HttpTlsOptions& options) {
+#ifdef HTTP_CLIENT_TLS
+        // OpenSSL writes with write(), not send(MSG_NOSIGNAL)
+        signal(SIGPIPE, SIG_IGN);
+        tls_ = options;
+        ctx_ = SSL_CTX_new(TLS_client_method());
+        if (!ctx_) return false;
+        SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+        static const unsigned char alpn[] = "\x08http/1.1";
+        SSL_CTX_set_alpn_protos(ctx_, alpn, sizeof(alpn) - 1);
+#ifdef SSL_OP_ENABLE_KTLS
+        SSL_CTX_set_options(ctx_, SSL_OP_ENABLE_KTLS);
+#endif
+        if (options.verify) {
+            SSL_CTX_set_verify(ctx_, SSL_VERIFY_PEER, nullptr);
+            bool loaded = options.caFile.empty() ? SSL_CTX_set_default_verify_paths(ctx_)
+                                                 : SSL_CTX_load_verify_locations(ctx_, options.caFile.c_str(), nullptr);
+            if (!loaded) return false;
+        }
+        // TLS 1.3 tickets arrive after the handshake; keep the newest one
+        SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx_, [](SSL* ssl, SSL_SESSION* session) {
+            auto* self = (HttpConnection*)SSL_get_app_data(ssl);
+            if (self->session_) SSL_SESSION_free(self->session_);
+            self->session_ = session;
+            return 1;  // we keep the reference
+        });
+        return true;
+#else
+        (void)options;
+        return false;
+#endif
+    }
+
+    const HttpTlsStats& TlsStats() const { return tlsStats_; }
+
+    void Close() {
+#ifdef HTTP_CLIENT_TLS
+        if (ssl_) {
+            SSL_shutdown(ssl_);  // close_notify, without waiting for the server's
+            SSL_free(ssl_);
+            ssl_ = nullptr;
+        }
+#endif
+        if (fd_ >= 0) close(fd_);
+        fd_ = -1;
+        buffer_.clear();
+    }
+
+private:
+    bool Connect() {
+        if (port_.empty()) return ConnectUnix();
+        if (!ConnectTcp()) return false;
+#ifdef HTTP_CLIENT_TLS
+        if (ctx_ && !Handshake()) {
+            Close();
+            return false;
+        }
+#endif
+        return true;
+    }
+
+#ifdef HTTP_CLIENT_TLS
+    bool Handshake() {
+        ssl_ = SSL_new(ctx_);
+        if (!ssl_) return false;
+        SSL_set_app_data(ssl_, this);
+        SSL_set_fd(ssl_, fd_);
+        SSL_set_tlsext_host_name(ssl_, host_.c_str());
+        if (tls_.verify) SSL_set1_host(ssl_, host_.c_str());
+        if (tls_.resume && session_) SSL_set_session(ssl_, session_);
+        timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (SSL_connect(ssl_) != 1) {
+            ERR_print_errors_fp(stderr);
+            return false;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        uint64_t ns = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000 + end.tv_nsec - start.tv_nsec;
+        if (SSL_session_reused(ssl_)) {
+            tlsStats_.resumed++;
+            tlsStats_.resumedNs += ns;
+        } else {
+            tlsStats_.full++;
+            tlsStats_.fullNs += ns;
+        }
+#ifdef BIO_get_ktls_send
+        if (BIO_get_ktls_send(SSL_get_wbio(ssl_))) tlsStats_.kernelSend++;
+#endif
+        return true;
+    }
+#endif
+
+    bool ConnectTcp() {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(host_.c_str(), port_.c_str(), &hints, &result) != 0) return false;
+        for (addrinfo* ai = result; ai; ai = ai->ai_next) {
+            int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0) continue;
+            if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                fd_ = fd;
+                break;
+            }
+            close(fd);
+        }
+        freeaddrinfo(result);
+        return fd_ >= 0;
+    }
+
+    bool ConnectUnix() {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (host_.size() >= sizeof(addr.sun_path)) return false;
+        memcpy(addr.sun_path, host_.data(), host_.size());
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return false;
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return false;
+        }
+        fd_ = fd;
+        return true;
+    }
+
+    bool SendAll(const char* data, size_t len) {
+#ifdef HTTP_CLIENT_TLS
+        if (ssl_) return SSL_write(ssl_, data, (int)len) == (int)len;
+#endif
+        while (len) {
+            ssize_t n = send(fd_, data, len, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    // Reads more bytes into buffer_; false on error or orderly close
+    bool Fill() {
+        char chunk[16384];
+#ifdef HTTP_CLIENT_TLS
+        if (ssl_) {
+            int n = SSL_read(ssl_, chunk, sizeof(chunk));
+            if (n <= 0) return false;
+            buffer_.append(chunk, n);
+            return true;
+        }
+#endif
+        for (;;) {
+            ssize_t n = recv(fd_, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            buffer_.append(chunk, n);
+            return true;
+        }
+    }
+
+    // Consumes `len` body bytes from the stream
+    bool ReadBody(size_t len, HttpResponse& response, bool keepBody) {
+        while (buffer_.size() < len) {
+            if (keepBody || buffer_.size() < 65536) {
+                if (!Fill()) return false;
+            } else {
+                // Don't hold large bodies we are not going to look at
+                len -= buffer_.size();
+                response.bodyBytes += buffer_.size();
+                buffer_.clear();
+            }
+        }
+        if (keepBody) response.body.append(buffer_, 0, len);
+        response.bodyBytes += len;
+        buffer_.erase(0, len);
+        return true;
+    }
+
+    bool Exchange(const char* method, const std::string& path, std::string_view body,
+                  const char* contentType, HttpResponse& response, bool keepBody) {
+        std::string head;
+        head.reserve(256);
+        head += method;
+        head += ' ';
+        head += path;
+        head += " HTTP/1.1\r\nHost: ";
+        head += port_.empty() ? "localhost" : host_;
+        head += "\r\nConnection: keep-alive\r\n";
+        if (!body.empty() || strcmp(method, "POST") == 0 || strcmp(method, "PUT") == 0) {
+            head += "Content-Type: ";
+            head += contentType ? contentType : "application/octet-stream";
+            head += "\r\nContent-Length: ";
+            head += std::to_string(body.size());
+            head += "\r\n";
+        }
+        head += "\r\n";
+        if (body.size() <= 65536) {
+            // One segment for small requests instead of header + body
+            head.append(body.data(), body.size());
+            if (!SendAll(head.data(), head.size())) return false;
+        } else if (!SendAll(head.data(), head.size()) || !SendAll(body.data(), body.size())) {
+            return false;
+        }
+
+        size_t headerEnd;
+        while ((headerEnd = buffer_.find("\r\n\r\n")) == std::string::npos) {
+            if (!Fill()) return false;
+        }
+
+        response = HttpResponse();
+        std::string_view headers(buffer_.data(), headerEnd);
+        bool http10 = headers.compare(0, 8, "HTTP/1.0") == 0;
+        size_t space = headers.find(' ');
+        if (space == std::string_view::npos) return false;
+        response.status = atoi(buffer_.c_str() + space + 1);
+
+        long contentLength = -1;
+        bool chunked = false;
+        bool closeAfter = http10;
+        size_t lineStart = headers.find("\r\n");
+        while (lineStart != std::string_view::npos && lineStart < headers.size()) {
+            lineStart += 2;
+            size_t lineEnd = headers.find("\r\n", lineStart);
+            std::string_view line = headers.substr(lineStart, lineEnd - lineStart);
+            size_t colon = line.find(':');
+            if (colon != std::string_view::npos) {
+                std::string name(line.substr(0, colon));
+                std::string value(line.substr(colon + 1));
+                value.erase(0, value.find_first_not_of(' '));
+                if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+                    contentLength = atol(value.c_str());
+                } else if (strcasecmp(name.c_str(), "Transfer-Encoding") == 0) {
+                    chunked = strcasecmp(value.c_str(), "chunked") == 0;
+                } else if (strcasecmp(name.c_str(), "Connection") == 0) {
+                    closeAfter = strcasecmp(value.c_str(), "close") == 0 ||
+                                 (http10 && strcasecmp(value.c_str(), "keep-alive") != 0);
+                }
+            }
+            lineStart = lineEnd;
+        }
+        buffer_.erase(0, headerEnd + 4);
+
+        bool noBody = strcmp(method, "HEAD") == 0 || response.status == 204 ||
+                      response.status == 304 || (response.status >= 100 && response.status < 200);
+        if (noBody) {
+            // nothing to read
+        } else if (chunked) {
+            for (;;) {
+                size_t lineEnd;
+                while ((lineEnd = buffer_.find("\r\n")) == std::string::npos) {
+                    if (!Fill()) return false;
+                }
+                size_t size = strtoul(buffer_.c_str(), nullptr, 16);
+                buffer_.erase(0, lineEnd + 2);
+                if (size == 0) {
+                    while (buffer_.find("\r\n") == std::string::npos) {
+                        if (!Fill()) return false;
+                    }
+                    buffer_.erase(0, buffer_.find("\r\n") + 2);
+                    break;
+                }
+                if (!ReadBody(size + 2, response, keepBody)) return false;
+                response.bodyBytes -= 2;
+                if (keepBody) response.body.resize(response.body.size() - 2);
+            }
+        } else if (contentLength >= 0) {
+            if (!ReadBody((size_t)contentLength, response, keepBody)) return false;
+        } else {
+            // Body runs until the server closes the connection
+            while (Fill()) {}
+            response.bodyBytes += buffer_.size();
+            if (keepBody) response.body += buffer_;
+            buffer_.clear();
+            closeAfter = true;
+        }
+
+        if (closeAfter) Close();
+        return true;
+    }
+
+    std::string host_;
+    std::string port_;
+    int fd_ = -1;
+    std::string buffer_;
+    HttpTlsStats tlsStats_;
+#ifdef HTTP_CLIENT_TLS
+    HttpTlsOptions tls_;
+    SSL_CTX* ctx_ = nullptr;
+    SSL* ssl_ = nullptr;
+    SSL_SESSION* session_ = nullptr;  // newest from the server, offered on reconnect
+#endif
+};
@@ -0,0 +1,339 @@
+// Load generator for the spill broadcast server (Linux).
+//
+// Simulates N users copying on an open-loop schedule: every request has an
+// intended start time drawn from the configured copy rate and burst pattern,
+// and latency is measured from that intended time rather than from when the
+// request was actually sent. A stalled server therefore shows up as latency
+// instead of silently lowering the offered load (coordinated omission).
+//
+//   loadgen --url=http://localhost:8000 --users=50 --rate=2 --duration=30
+//           --size=lognormal:200:1.5 --burst=20:10 --logs-ratio=0.05 --json
+//   loadgen --url=unix:/tmp/spill.sock      same host, over the server's Unix socket
+//   loadgen --url=https://localhost:8000 --cafile=spill.crt --reconnect
+//                                           a TLS handshake per request, resumed
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "clip_json.h"
+#include "histogram.h"
+#include "http_client.h"
+
+struct SizeDistribution {
+    enum Kind { kFixed, kUniform, kLogNormal } kind = kLogNormal;
+    double a = 200, b = 1.5;
+
+    bool Parse(const std::string& spec) {
+        if (sscanf(spec.c_str(), "fixed:%lf", &a) == 1) { kind = kFixed; return a >= 0; }
+        if (sscanf(spec.c_str(), "uniform:%lf:%lf", &a, &b) == 2) { kind = kUniform; return a >= 0 && b >= a; }
+        if (sscanf(spec.c_str(), "lognormal:%lf:%lf", &a, &b) == 2) { kind = kLogNormal; return a > 0 && b >= 0; }
+        return false;
+    }
+
+    size_t Sample(std::mt19937_64& rng) const {
+        switch (kind) {
+            case kFixed: return (size_t)a;
+            case kUniform: return (size_t)std::uniform_real_distribution<double>(a, b)(rng);
+            default: return (size_t)std::lognormal_distribution<double>(std::log(a), b)(rng);
+        }
+    }
+};
+
+struct Options {
+    std::string url = "http://localhost:8000";
+    std::string userPrefix = "loadgen-";
+    int users = 10;
+    int connections = 0;  // 0 = min(users, 64)
+    double duration = 10;
+    double warmup = 0;
+    double rate = 1;         // clips per second per user
+    int burstCount = 0;      // clips per burst
+    double burstPeriod = 0;  // seconds between bursts
+    double logsRatio = 0;    // share of requests that are GET /logs/<user>
+    size_t maxSize = 1 << 20;
+    SizeDistribution size;
+    uint64_t seed = 1;
+    bool json = false;
+    bool tls = false;        // https:// URL
+    HttpTlsOptions tlsOptions;
+    bool reconnect = false;  // new connection for every request
+};
+
+struct Stats {
+    HdrHistogram postLatency, postService, logsLatency, logsService;
+    uint64_t ok = 0, errors = 0, limited = 0, bytesSent = 0, bytesReceived = 0;  // limited: 429 / 503
+    HttpTlsStats tls;
+
+    void Merge(const Stats& other) {
+        tls.Merge(other.tls);
+        postLatency.Merge(other.postLatency);
+        postService.Merge(other.postService);
+        logsLatency.Merge(other.logsLatency);
+        logsService.Merge(other.logsService);
+        ok += other.ok;
+        errors += other.errors;
+        limited += other.limited;
+        bytesSent += other.bytesSent;
+        bytesReceived += other.bytesReceived;
+    }
+};
+
+struct Event {
+    int64_t intendedNs;
+    int user;
+    bool burst;  // marker that expands into burstCount copies
+    bool chain;  // part of the user's Poisson copy stream; schedules the next
+    bool operator>(const Event& other) const { return intendedNs > other.intendedNs; }
+};
+
+static int64_t NowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void SleepUntil(int64_t ns) {
+    timespec ts = { (time_t)(ns / 1000000000), (long)(ns % 1000000000) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+}
+
+// Clip text with the characters that make JSON escaping expensive
+static std::string MakeCorpus(std::mt19937_64& rng, size_t size) {
+    static const char extra[] = "\"\\\n\t{}()<>;:=/";
+    std::string corpus(size, ' ');
+    for (char& c : corpus) {
+        uint64_t r = rng();
+        c = (r % 8 == 0) ? extra[(r >> 8) % (sizeof(extra) - 1)] : (char)('a' + (r >> 16) % 26);
+    }
+    return corpus;
+}
+
+static void RunWorker(const Options& opt, int worker, int workers, int64_t start,
+                      const std::string& host, const std::string& port, const std::string& prefix,
+                      const std::string& corpus, Stats& stats) {
+    std::mt19937_64 rng(opt.seed * 7919 + worker);
+    std::exponential_distribution<double> gap(opt.rate > 0 ? opt.rate : 1);
+    std::uniform_real_distribution<double> unit(0, 1);
+    const int64_t end = start + (int64_t)(opt.duration * 1e9);
+    const int64_t measureFrom = start + (int64_t)(opt.warmup * 1e9);
+
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> queue;
+    for (int user = worker; user < opt.users; user += workers) {
+        if (opt.rate > 0) queue.push({ start + (int64_t)(gap(rng) * 1e9), user, false, true });
+        if (opt.burstCount > 0 && opt.burstPeriod > 0) {
+            queue.push({ start + (int64_t)(unit(rng) * opt.burstPeriod * 1e9), user, true, false });
+        }
+    }
+
+    HttpConnection connection(host, port);
+    if (opt.tls && !connection.UseTls(opt.tlsOptions)) {
+        fprintf(stderr, "loadgen: cannot set up TLS (built without HTTP_CLIENT_TLS, or a bad --cafile)\n");
+        stats.errors++;
+        return;
+    }
+    HttpResponse response;
+    std::string body;
+    char timestamp[32];
+
+    while (!queue.empty() && queue.top().intendedNs < end) {
+        Event event = queue.top();
+        queue.pop();
+        if (event.burst) {
+            for (int i = 0; i < opt.burstCount; i++) queue.push({ event.intendedNs, event.user, false, false });
+            queue.push({ event.intendedNs + (int64_t)(opt.burstPeriod * 1e9), event.user, true, false });
+            continue;
+        }
+        if (event.chain) {
+            queue.push({ event.intendedNs + (int64_t)(gap(rng) * 1e9), event.user, false, true });
+        }
+
+        std::string user = opt.userPrefix + std::to_string(event.user);
+        bool logs = unit(rng) < opt.logsRatio;
+        SleepUntil(event.intendedNs);
+        int64_t sent = NowNs();
+        bool ok;
+        if (logs) {
+            ok = connection.Request("GET", prefix + "/logs/" + user, {}, nullptr, response);
+        } else {
+            size_t size = std::min(opt.size.Sample(rng), opt.maxSize);
+            size_t offset = corpus.size() > size ? rng() % (corpus.size() - size) : 0;
+            time_t wall = time(nullptr);
+            tm local;
+            strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", localtime_r(&wall, &local));
+            ClipJson clip;
+            clip.content = std::string_view(corpus).substr(offset, size);
+            clip.timestamp = timestamp;
+            clip.userId = user;
+            body.clear();
+            AppendClipJson(body, clip);
+            ok = connection.Request("POST", prefix + "/" + user, body, "application/json", response);
+            stats.bytesSent += body.size();
+        }
+        if (opt.reconnect) connection.Close();
+        int64_t done = NowNs();
+
+        ok = ok && response.status >= 200 && response.status < 300;
+        if (event.intendedNs >= measureFrom) {
+            if (ok) {
+                stats.ok++;
+                stats.bytesReceived += response.bodyBytes;
+                (logs ? stats.logsLatency : stats.postLatency).Record((done - event.intendedNs) / 1000);
+                (logs ? stats.logsService : stats.postService).Record((done - sent) / 1000);
+            } else if (response.status == 429 || response.status == 503) {
+                stats.limited++;
+            } else {
+                stats.errors++;
+            }
+        }
+    }
+    stats.tls = connection.TlsStats();
+}
+
+static void PrintHistogram(const char* name, const HdrHistogram& h) {
+    printf("  %-22s n=%-8llu p50=%-8llu p90=%-8llu p99=%-8llu p99.9=%-8llu max=%llu\n", name,
+           (unsigned long long)h.Count(), (unsigned long long)h.Quantile(0.5),
+           (unsigned long long)h.Quantile(0.9), (unsigned long long)h.Quantile(0.99),
+           (unsigned long long)h.Quantile(0.999), (unsigned long long)h.Max());
+}
+
+static void JsonHistogram(const char* name, const HdrHistogram& h, bool last) {
+    printf("\"%s\":{\"count\":%llu,\"mean\":%.1f,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,"
+           "\"p999\":%llu,\"max\":%llu}%s", name,
+           (unsigned long long)h.Count(), h.Mean(), (unsigned long long)h.Quantile(0.5),
+           (unsigned long long)h.Quantile(0.9), (unsigned long long)h.Quantile(0.99),
+           (unsigned long long)h.Quantile(0.999), (unsigned long long)h.Max(), last ? "" : ",");
+}
+
+static void Usage() {
+    fprintf(stderr,
+        "usage: loadgen [options]\n"
+        "  --url=URL              server base URL (default http://localhost:8000),\n"
+        "                         or unix:PATH for the server's Unix socket\n"
+        "  --users=N              simulated users (default 10)\n"
+        "  --connections=N        worker connections (default min(users, 64))\n"
+        "  --duration=S           seconds of load (default 10)\n"
+        "  --warmup=S             leading seconds excluded from results (default 0)\n"
+        "  --rate=R               clips per second per user (default 1)\n"
+        "  --size=SPEC            fixed:N | uniform:MIN:MAX | lognormal:MEDIAN:SIGMA\n"
+        "  --max-size=BYTES       cap on sampled clip sizes (default 1048576)\n"
+        "  --burst=COUNT:PERIOD   COUNT back-to-back clips per user every PERIOD s\n"
+        "  --logs-ratio=F         share of requests that are GET /logs/<user>\n"
+        "  --user-prefix=STR      user id prefix (default loadgen-)\n"
+        "  --seed=N               random seed (default 1)\n"
+        "  --reconnect            new connection (and TLS handshake) for every request\n"
+        HTTP_TLS_USAGE
+        "  --json                 print one JSON summary line instead of text\n");
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        bool ok = true;
+        if (key == "--url") opt.url = value;
+        else if (key == "--users") opt.users = atoi(value.c_str());
+        else if (key == "--connections") opt.connections = atoi(value.c_str());
+        else if (key == "--duration") opt.duration = atof(value.c_str());
+        else if (key == "--warmup") opt.warmup = atof(value.c_str());
+        else if (key == "--rate") opt.rate = atof(value.c_str());
+        else if (key == "--size") ok = opt.size.Parse(value);
+        else if (key == "--max-size") opt.maxSize = strtoull(value.c_str(), nullptr, 10);
+        else if (key == "--burst") ok = sscanf(value.c_str(), "%d:%lf", &opt.burstCount, &opt.burstPeriod) == 2;
+        else if (key == "--logs-ratio") opt.logsRatio = atof(value.c_str());
+        else if (key == "--user-prefix") opt.userPrefix = value;
+        else if (key == "--seed") opt.seed = strtoull(value.c_str(), nullptr, 10);
+        else if (key == "--reconnect") opt.reconnect = true;
+        else if (ParseHttpTlsOption(key, value, opt.tlsOptions)) {}
+        else if (key == "--json") opt.json = true;
+        else if (key == "--help" || key == "-h") { Usage(); return 0; }
+        else ok = false;
+        if (!ok) {
+            fprintf(stderr, "loadgen: bad argument '%s'\n", arg.c_str());
+            Usage();
+            return 2;
+        }
+    }
+
+    std::string host, port, prefix;
+    if (!ParseHttpUrl(opt.url, host, port, prefix, &opt.tls)) {
+        fprintf(stderr, "loadgen: only http://, https:// and unix: URLs are supported: %s\n", opt.url.c_str());
+        return 2;
+    }
+    if (opt.users <= 0 || opt.duration <= 0 || opt.warmup >= opt.duration) {
+        fprintf(stderr, "loadgen: need users > 0 and duration > warmup\n");
+        return 2;
+    }
+    int workers = opt.connections > 0 ? opt.connections : std::min(opt.users, 64);
+    workers = std::min(workers, opt.users);
+
+    std::mt19937_64 rng(opt.seed);
+    std::string corpus = MakeCorpus(rng, std::max<size_t>(std::min<size_t>(opt.maxSize, 8 << 20), 4096) * 2);
+
+    std::vector<Stats> stats(workers);
+    std::vector<std::thread> threads;
+    int64_t start = NowNs() + 50000000;  // let every worker get going first
+    for (int w = 0; w < workers; w++) {
+        threads.emplace_back(RunWorker, std::cref(opt), w, workers, start, std::cref(host),
+                             std::cref(port), std::cref(prefix), std::cref(corpus), std::ref(stats[w]));
+    }
+    for (std::thread& t : threads) t.join();
+    double measured = std::max(1e-9, (NowNs() - start) / 1e9 - opt.warmup);
+
+    Stats total;
+    for (const Stats& s : stats) total.Merge(s);
+    double throughput = total.ok / measured;
+
+    if (opt.json) {
+        printf("{\"url\":\"%s\",\"users\":%d,\"connections\":%d,\"duration_s\":%.3f,\"rate\":%g,"
+               "\"requests\":%llu,\"errors\":%llu,\"limited\":%llu,\"throughput_rps\":%.1f,"
+               "\"bytes_sent\":%llu,\"bytes_received\":%llu,",
+               opt.url.c_str(), opt.users, workers, measured, opt.rate,
+               (unsigned long long)(total.ok + total.errors + total.limited), (unsigned long long)total.errors,
+               (unsigned long long)total.limited, throughput,
+               (unsigned long long)total.bytesSent, (unsigned long long)total.bytesReceived);
+        JsonHistogram("post_latency_us", total.postLatency, false);
+        JsonHistogram("post_service_us", total.postService, false);
+        JsonHistogram("logs_latency_us", total.logsLatency, false);
+        JsonHistogram("logs_service_us", total.logsService, !opt.tls);
+        if (opt.tls) {
+            const HttpTlsStats& t = total.tls;
+            printf("\"tls\":{\"full\":%llu,\"resumed\":%llu,\"full_us\":%.1f,\"resumed_us\":%.1f,\"ktls_send\":%llu}",
+                   (unsigned long long)t.full, (unsigned long long)t.resumed, t.full ? t.fullNs / 1e3 / t.full : 0.0,
+                   t.resumed ? t.resumedNs / 1e3 / t.resumed : 0.0, (unsigned long long)t.kernelSend);
+        }
+        printf("}\n");
+    } else {
+        printf("loadgen: %d users over %d connections, %.1f s measured\n", opt.users, workers, measured);
+        printf("  requests %llu ok, %llu errors, %llu turned away (429/503), %.1f req/s, %.1f MB sent\n",
+               (unsigned long long)total.ok, (unsigned long long)total.errors,
+               (unsigned long long)total.limited, throughput, total.bytesSent / 1e6);
+        printf("latency in microseconds (from intended start, corrected for coordinated omission):\n");
+        PrintHistogram("POST /<user>", total.postLatency);
+        PrintHistogram("GET /logs/<user>", total.logsLatency);
+        printf("service time in microseconds (from actual send):\n");
+        PrintHistogram("POST /<user>", total.postService);
+        PrintHistogram("GET /logs/<user>", total.logsService);
+        if (opt.tls) {
+            const HttpTlsStats& t = total.tls;
+            printf("tls handshakes (client side, includes the round trips):\n");
+            printf("  full %llu, mean %.0f us; resumed %llu, mean %.0f us; kernel tls send on %llu\n",
+                   (unsigned long long)t.full, t.full ? t.fullNs / 1e3 / t.full : 0.0,
+                   (unsigned long long)t.resumed, t.resumed ? t.resumedNs / 1e3 / t.resumed : 0.0,
+                   (unsigned long long)t.kernelSend);
+        }
+    }
+    return total.ok ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+// Log channel from the Python children to the GUI.
+//
+// The children write one JSON record per line ({"level", "source", "msg"},
+// plus "ts" and an optional "event" such as "ready");
+// anything else on the pipe (pip, tracebacks, print) is taken as a plain
+// info line. A reader thread splits and parses lines as they arrive and
+// pushes records into a lock-free single-producer/single-consumer ring; the
+// UI thread drains the ring in batches on a timer, so a chatty child costs
+// the GUI one update per tick instead of several window messages per line.
+// Nothing here depends on Win32.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "clip_json.h"
+
+enum class LogLevel { Debug, Info, Warning, Error };
+
+struct LogRecord {
+    LogLevel level = LogLevel::Info;
+    std::string source;
+    std::string message;
+    std::string event;      // machine-readable marker, e.g. "ready"; usually empty
+    double timestamp = 0;   // child's wall clock in seconds, 0 if not sent
+};
+
+inline const char* LogLevelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug: return "debug";
+        case LogLevel::Warning: return "warning";
+        case LogLevel::Error: return "error";
+        default: return "info";
+    }
+}
+
+// Accepts Python logging names in any case ("WARNING", "critical", ...)
+inline LogLevel ParseLogLevel(std::string_view name) {
+    char c = name.empty() ? 'i' : (char)(name[0] | 0x20);
+    switch (c) {
+        case 'd': return LogLevel::Debug;
+        case 'w': return LogLevel::Warning;
+        case 'e': case 'c': case 'f': return LogLevel::Error;
+        default: return LogLevel::Info;
+    }
+}
+
+// Fills `record` from one line. JSON records are parsed in place (the line
+// is clobbered); anything else becomes an info record from `defaultSource`.
+inline void ParseLogLine(char* line, size_t len, std::string_view defaultSource, LogRecord& record) {
+    record.level = LogLevel::Info;
+    record.source.assign(defaultSource.data(), defaultSource.size());
+    record.event.clear();
+    record.timestamp = 0;
+    if (len && line[0] == '{') {
+        std::string_view level, source, message, event, ts;
+        bool hasMessage = false;
+        bool ok = ParseJsonObject(line, len, [&](std::string_view key, std::string_view value) {
+            if (key == "level") level = value;
+            else if (key == "source") source = value;
+            else if (key == "msg" || key == "message") { message = value; hasMessage = true; }
+            else if (key == "event") event = value;
+        }, [&](std::string_view key, std::string_view text) {
+            if (key == "ts") ts = text;
+        });
+        if (ok && hasMessage) {
+            record.level = ParseLogLevel(level);
+            if (!source.empty()) record.source.assign(source.data(), source.size());
+            record.message.assign(message.data(), message.size());
+            record.event.assign(event.data(), event.size());
+            if (!ts.empty()) record.timestamp = strtod(std::string(ts).c_str(), nullptr);
+            return;
+        }
+        // Not one of ours after all; the in-place parse may have rewritten
+        // part of it, but it is still readable as text
+    }
+    record.message.assign(line, len);
+}
+
+// Splits a byte stream into lines. '\n' ends a line; a '\r' inside a line
+// acts like a terminal carriage return (progress bars), so only the text
+// after the last one is kept. Empty lines are dropped.
+class LineSplitter {
+public:
+    explicit LineSplitter(size_t maxLine = 64 * 1024) : maxLine_(maxLine) {}
+
+    // onLine(char* line, size_t len); the line may be modified in place
+    template <typename OnLine>
+    void Feed(char* data, size_t len, OnLine onLine) {
+        while (len) {
+            char* nl = (char*)memchr(data, '\n', len);
+            if (!nl) {
+                partial_.append(data, len);
+                if (partial_.size() >= maxLine_) Flush(onLine);
+                return;
+            }
+            size_t run = nl - data;
+            if (partial_.empty()) {
+                Emit(data, run, onLine);
+            } else {
+                partial_.append(data, run);
+                Flush(onLine);
+            }
+            data = nl + 1;
+            len -= run + 1;
+        }
+    }
+
+    // Emits whatever is left once the stream has ended
+    template <typename OnLine>
+    void Flush(OnLine onLine) {
+        if (!partial_.empty()) Emit(&partial_[0], partial_.size(), onLine);
+        partial_.clear();
+    }
+
+private:
+    template <typename OnLine>
+    static void Emit(char* line, size_t len, OnLine onLine) {
+        while (len && line[len - 1] == '\r') len--;
+        for (size_t i = len; i > 0; i--) {
+            if (line[i - 1] == '\r') {
+                line += i;
+                len -= i;
+                break;
+            }
+        }
+        if (len) onLine(line, len);
+    }
+
+    size_t maxLine_;
+    std::string partial_;
+};
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. Indices only grow; slot = index & mask. Each side caches the other
+// side's index so the shared cache lines are only touched when the cached
+// value says the ring looks full (producer) or holds fewer items than a
+// drain could take (consumer).
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t Capacity() const { return slots_.size(); }
+
+    // Producer: false if the ring is full (value is left untouched)
+    bool TryPush(T&& value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - cachedTail_ == slots_.size()) {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head - cachedTail_ == slots_.size()) return false;
+        }
+        slots_[head & mask_] = std::move(value);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: false if the ring is empty
+    bool TryPop(T& value) {
+        return Drain([&](T& item) { value = std::move(item); }, 1) == 1;
+    }
+
+    // Consumer: hands up to `limit` items to onItem(T&) in order and
+    // releases their slots with a single store
+    template <typename OnItem>
+    size_t Drain(OnItem onItem, size_t limit = SIZE_MAX) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (cachedHead_ - tail < limit) {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (cachedHead_ == tail) return 0;
+        }
+        size_t count = std::min(cachedHead_ - tail, limit);
+        for (size_t i = 0; i < count; i++) onItem(slots_[(tail + i) & mask_]);
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    std::vector<T> slots_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> head_{0};  // written by the producer
+    size_t cachedTail_ = 0;                    // producer's view of tail_
+    alignas(64) std::atomic<size_t> tail_{0};  // written by the consumer
+    size_t cachedHead_ = 0;                    // consumer's view of head_
+};
+
+// Parser on the producer side, ring in between, batches out. When the UI
+// falls behind, new records are dropped and counted rather than blocking the
+// reader (which would stall the children on a full pipe).
+class LogChannel {
+public:
+    explicit LogChannel(size_t capacity = 4096) : ring_(capacity) {}
+
+    // Producer (pipe reader thread): one line from a LineSplitter
+    void Push(char* line, size_t len, std::string_view defaultSource) {
+        ParseLogLine(line, len, defaultSource, scratch_);
+        if (!ring_.TryPush(std::move(scratch_))) dropped_.fetch_add(1, std::memory_order_relaxed);
+        scratch_ = LogRecord();
+    }
+
+    // Consumer (UI thread): onRecord(LogRecord&) for up to `limit` records
+    template <typename OnRecord>
+    size_t Drain(OnRecord onRecord, size_t limit = SIZE_MAX) {
+        return ring_.Drain(onRecord, limit);
+    }
+
+    // Records lost to a full ring since the last call
+    uint64_t TakeDropped() { return dropped_.exchange(0, std::memory_order_relaxed); }
+
+private:
+    LogRecord scratch_;
+    SpscRing<LogRecord> ring_;
+    std::atomic<uint64_t> dropped_{0};
+};
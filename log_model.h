@@ -0,0 +1,104 @@
+#pragma once
+
+// Scrollback for the GUI log box: a ring of display rows with a byte budget.
+//
+// Text is split into rows once, when it is appended (at newlines, and at
+// `columns` characters for a monospace view, preferring to break at a
+// space). Painting then only has to index the rows that are on screen, and
+// appending evicts the oldest rows once the budget is spent, so both stay
+// constant-time however long the app has been running.
+//
+// Rows carry a sequence number (FirstRow() .. EndRow()) that keeps counting
+// across evictions, which lets a view hold on to a scroll position.
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+
+template <typename CharT>
+class LogScrollback {
+public:
+    using String = std::basic_string<CharT>;
+    using View = std::basic_string_view<CharT>;
+
+    explicit LogScrollback(size_t byteBudget = 256 * 1024, size_t columns = 0)
+        : budget_(byteBudget), columns_(columns) {}
+
+    // Wrap width for rows appended from now on; 0 disables wrapping
+    void SetColumns(size_t columns) { columns_ = columns; }
+    size_t Columns() const { return columns_; }
+
+    void Append(View text) {
+        while (true) {
+            size_t nl = text.find(CharT('\n'));
+            View line = text.substr(0, nl);
+            if (!line.empty() && line.back() == CharT('\r')) line.remove_suffix(1);
+            AppendLine(line);
+            if (nl == View::npos) break;
+            text.remove_prefix(nl + 1);
+        }
+    }
+
+    void Clear() {
+        evicted_ += rows_.size();
+        rows_.clear();
+        bytes_ = 0;
+    }
+
+    size_t Size() const { return rows_.size(); }
+    size_t Bytes() const { return bytes_; }
+    uint64_t FirstRow() const { return evicted_; }
+    uint64_t EndRow() const { return evicted_ + rows_.size(); }
+
+    // Row by sequence number, FirstRow() <= row < EndRow()
+    const String& Row(uint64_t row) const { return rows_[(size_t)(row - evicted_)]; }
+
+private:
+    static size_t Cost(const String& row) { return sizeof(String) + row.size() * sizeof(CharT); }
+
+    // Moves a hard wrap point back so it doesn't split a UTF-16 surrogate
+    // pair or a UTF-8 sequence; forward past it instead when the row would
+    // otherwise be empty (a column narrower than the character)
+    static size_t CodePointStart(View line, size_t cut) {
+        if (sizeof(CharT) == 2) {
+            if (((uint32_t)line[cut - 1] & 0xFC00) == 0xD800) cut = cut > 1 ? cut - 1 : cut + 1;
+        } else if (sizeof(CharT) == 1) {
+            size_t start = cut;
+            while (cut > 0 && ((uint8_t)line[cut] & 0xC0) == 0x80) cut--;
+            if (cut == 0) {
+                cut = start;
+                while (cut < line.size() && ((uint8_t)line[cut] & 0xC0) == 0x80) cut++;
+            }
+        }
+        return cut;
+    }
+
+    void AppendLine(View line) {
+        while (columns_ && line.size() > columns_) {
+            size_t cut = line.rfind(CharT(' '), columns_);
+            if (cut == View::npos || cut < columns_ / 2) cut = CodePointStart(line, columns_);
+            Push(String(line.substr(0, cut)));
+            line.remove_prefix(cut);
+            if (!line.empty() && line.front() == CharT(' ')) line.remove_prefix(1);
+        }
+        Push(String(line));
+    }
+
+    void Push(String row) {
+        bytes_ += Cost(row);
+        rows_.push_back(std::move(row));
+        while (bytes_ > budget_ && rows_.size() > 1) {
+            bytes_ -= Cost(rows_.front());
+            rows_.pop_front();
+            evicted_++;
+        }
+    }
+
+    std::deque<String> rows_;
+    size_t budget_;
+    size_t columns_;
+    size_t bytes_ = 0;
+    uint64_t evicted_ = 0;
+};
@@ -1,17 +1,26 @@
 #define UNICODE
 #define _UNICODE
+#define NOMINMAX
 
 #include <windows.h>
 #include <shellapi.h>
+#include <winhttp.h>
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <thread>
+#include <mutex>
 #include <iostream>
-#include <fstream> 
 
 #include "broadcast_embed.h"
+#include "clip_crypto.h"
 #include "clipboard_embed.h"
+#include "log_channel.h"
+#include "log_model.h"
+#include "remote_deploy.h"
 #include "resource.h"
+#include "startup.h"
+#include "transcode.h"
 
 // Window dimensions
 #define WINDOW_WIDTH 400
@@ -23,15 +32,20 @@
 #define ID_BTN_START 1003
 #define ID_BTN_STOP 1004
 #define ID_CHK_EXTERNAL 1005
+#define ID_TIMER_LOG 1007
+#define LOG_DRAIN_MS 100
+#define STARTUP_TIMEOUT_MS 30000
+#define PIP_TIMEOUT_MS (10 * 60 * 1000)
+#define REMOTE_READY_MS 15000
 #define WM_APP_EXIT (WM_APP + 1)
 #define WM_APP_SHOW (WM_APP + 2)
 
 // Unique identifiers for single instance enforcement
 #define APP_MUTEX_NAME L"ClipboardBroadcastTrayMutex"
 #define APP_WINDOW_CLASS L"ClipboardTrayWindow"
+#define LOG_BOX_CLASS L"SpillLogBox"
 
 COLORREF versionLabelColor = RGB(22, 155, 22);
-WNDPROC originalEditProc = NULL;
 HWND hwndInputHost, hwndInputUser, hwndLogBox, hwndBtnStart, hwndBtnStop;
 HWND hwndChkExternal, hwndInputExtHost, hwndInputExtPort, hwndLabelExtHost, hwndLabelExtPort;
 HWND hwndVersionLabel;
@@ -44,135 +58,220 @@ HANDLE hMutex = NULL;
 HBRUSH hBackgroundBrush = NULL;
 HBRUSH hLogBoxBrush = NULL;
 HFONT hLogBoxFont = NULL;
+LogChannel childLog;          // child stdout/stderr, drained on ID_TIMER_LOG
+std::mutex childLogWriter;    // readers left over from a previous Start may overlap
+LogScrollback<wchar_t> logModel(256 * 1024);  // log box rows, UI thread only
+uint64_t logTopRow = 0;       // first visible row when not following
+bool logFollow = true;        // keep the newest row in view
+int logLineHeight = 14;
+std::string assetDir;         // extracted scripts and dependency stamps
+std::string depsStampPath;    // stamp consulted by the last Start
+StartupTimer startupTimer;    // Start -> both children ready
+bool startupPending = false;  // waiting for "ready" events from the children
+size_t startupExpected = 0;
+bool startupWatchServer = false;  // the server is our child (local mode)
+
+// Log box: a plain child window that paints the visible rows of logModel.
+// Everything here runs on the UI thread.
+int LogVisibleRows(HWND hwnd) {
+    RECT rect;
+    GetClientRect(hwnd, &rect);
+    return std::max(1, (int)(rect.bottom - rect.top - 4) / logLineHeight);
+}
+
+// First row on screen: pinned to the newest rows while following
+uint64_t LogTopRow(HWND hwnd) {
+    uint64_t visible = (uint64_t)LogVisibleRows(hwnd);
+    uint64_t end = logModel.EndRow();
+    uint64_t last = end > visible ? end - visible : 0;
+    uint64_t top = logFollow ? last : std::min(logTopRow, last);
+    return std::max(top, logModel.FirstRow());
+}
+
+void UpdateLogScrollBar(HWND hwnd) {
+    SCROLLINFO si = {};
+    si.cbSize = sizeof(si);
+    si.fMask = SIF_RANGE | SIF_PAGE | SIF_POS | SIF_DISABLENOSCROLL;
+    si.nMin = 0;
+    si.nMax = logModel.Size() ? (int)logModel.Size() - 1 : 0;
+    si.nPage = (UINT)LogVisibleRows(hwnd);
+    si.nPos = (int)(LogTopRow(hwnd) - logModel.FirstRow());
+    SetScrollInfo(hwnd, SB_VERT, &si, TRUE);
+}
+
+void ScrollLogTo(HWND hwnd, int64_t top) {
+    int64_t first = (int64_t)logModel.FirstRow();
+    int64_t last = std::max(first, (int64_t)logModel.EndRow() - LogVisibleRows(hwnd));
+    top = std::max(first, std::min(top, last));
+    logTopRow = (uint64_t)top;
+    logFollow = top >= last;
+    UpdateLogScrollBar(hwnd);
+    InvalidateRect(hwnd, NULL, FALSE);
+}
 
 LRESULT CALLBACK LogBoxProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     switch (msg) {
-        case WM_ERASEBKGND: {
-            RECT rect;
-            GetClientRect(hwnd, &rect);
-            HBRUSH brush = CreateSolidBrush(RGB(200, 230, 200));
-            FillRect((HDC)wParam, &rect, brush);
-            DeleteObject(brush);
-            return 1;
-        }
+        case WM_ERASEBKGND:
+            return 1;  // WM_PAINT covers every pixel
+
         case WM_PAINT: {
             PAINTSTRUCT ps;
             HDC hdc = BeginPaint(hwnd, &ps);
-            
-            // Get the client rect
             RECT rect;
             GetClientRect(hwnd, &rect);
-            
-            // Fill background
-            HBRUSH bgBrush = CreateSolidBrush(RGB(200, 230, 200));
-            FillRect(hdc, &rect, bgBrush);
-            DeleteObject(bgBrush);
-            
-            // Get the text
-            int textLen = GetWindowTextLengthW(hwnd);
-            if (textLen > 0) {
-                wchar_t* buffer = new wchar_t[textLen + 1];
-                GetWindowTextW(hwnd, buffer, textLen + 1);
-                
-                // Set up transparent text drawing
-                SetBkMode(hdc, TRANSPARENT);
-                SetTextColor(hdc, RGB(0, 0, 0));  // Black text
-                
-                // Select the font
-                HFONT oldFont = NULL;
-                if (hLogBoxFont) {
-                    oldFont = (HFONT)SelectObject(hdc, hLogBoxFont);
-                }
-                
-                // Draw the text with transparency
-                RECT textRect = rect;
-                textRect.left += 2;  // Small margin
-                textRect.top += 2;
-                
-                DrawTextW(hdc, buffer, -1, &textRect, 
-                         DT_LEFT | DT_TOP | DT_WORDBREAK | DT_EDITCONTROL);
-                
-                // Restore old font
-                if (oldFont) {
-                    SelectObject(hdc, oldFont);
+
+            HFONT oldFont = hLogBoxFont ? (HFONT)SelectObject(hdc, hLogBoxFont) : NULL;
+            SetTextColor(hdc, RGB(0, 0, 0));
+            SetBkColor(hdc, RGB(200, 230, 200));
+
+            // Only the rows on screen, each drawn opaque over its own band
+            uint64_t top = LogTopRow(hwnd);
+            uint64_t end = std::min(logModel.EndRow(), top + (uint64_t)LogVisibleRows(hwnd) + 1);
+            RECT row = rect;
+            row.top = rect.top + 2;
+            for (uint64_t i = top; i < end && row.top < ps.rcPaint.bottom; i++) {
+                row.bottom = row.top + logLineHeight;
+                if (row.bottom > ps.rcPaint.top) {
+                    const std::wstring& text = logModel.Row(i);
+                    ExtTextOutW(hdc, rect.left + 2, row.top, ETO_OPAQUE | ETO_CLIPPED, &row,
+                                text.c_str(), (UINT)text.size(), NULL);
                 }
-                
-                delete[] buffer;
+                row.top = row.bottom;
             }
-            
+            RECT band = rect;
+            band.bottom = rect.top + 2;
+            FillRect(hdc, &band, hLogBoxBrush);
+            band.top = row.top;
+            band.bottom = rect.bottom;
+            if (band.top < band.bottom) FillRect(hdc, &band, hLogBoxBrush);
+
+            if (oldFont) SelectObject(hdc, oldFont);
             EndPaint(hwnd, &ps);
             return 0;
         }
-        case WM_SETTEXT:
-        case WM_CHAR:
-        case EM_REPLACESEL:
-            // Let the default handler process the message first
-            LRESULT result = CallWindowProc(originalEditProc, hwnd, msg, wParam, lParam);
-            // Then invalidate to trigger our custom paint
-            InvalidateRect(hwnd, NULL, TRUE);
-            return result;
-    }
-    return CallWindowProc(originalEditProc, hwnd, msg, wParam, lParam);
-}
 
-void AppendLog(const std::string& text, bool clear=true) {
-    if (!hwndLogBox) return;
+        case WM_VSCROLL: {
+            int64_t top = (int64_t)LogTopRow(hwnd);
+            int page = LogVisibleRows(hwnd);
+            switch (LOWORD(wParam)) {
+                case SB_LINEUP: top -= 1; break;
+                case SB_LINEDOWN: top += 1; break;
+                case SB_PAGEUP: top -= page; break;
+                case SB_PAGEDOWN: top += page; break;
+                case SB_TOP: top = 0; break;
+                case SB_BOTTOM: top = INT64_MAX / 2; break;
+                case SB_THUMBTRACK:
+                case SB_THUMBPOSITION: {
+                    SCROLLINFO si = {};
+                    si.cbSize = sizeof(si);
+                    si.fMask = SIF_TRACKPOS;
+                    GetScrollInfo(hwnd, SB_VERT, &si);
+                    top = (int64_t)logModel.FirstRow() + si.nTrackPos;
+                    break;
+                }
+                default: return 0;
+            }
+            ScrollLogTo(hwnd, top);
+            return 0;
+        }
 
-    if (clear == true){
-        // Clear the log box completely
-        SendMessageW(hwndLogBox, EM_SETREADONLY, FALSE, 0);  // Remove read-only flag
-        SendMessageW(hwndLogBox, EM_SETSEL, 0, -1);          // Select all text
-        SendMessageW(hwndLogBox, EM_REPLACESEL, FALSE, (LPARAM)L""); // Replace with empty string
-        InvalidateRect(hwndLogBox, NULL, TRUE);              // Force redraw
-        UpdateWindow(hwndLogBox);                            // Update immediately
-        SendMessageW(hwndLogBox, EM_SETREADONLY, TRUE, 0);   // Restore read-only flag        
+        case WM_MOUSEWHEEL:
+            ScrollLogTo(hwnd, (int64_t)LogTopRow(hwnd) - GET_WHEEL_DELTA_WPARAM(wParam) / WHEEL_DELTA * 3);
+            return 0;
+
+        case WM_SIZE:
+            UpdateLogScrollBar(hwnd);
+            return 0;
     }
+    return DefWindowProc(hwnd, msg, wParam, lParam);
+}
 
+// Adds rows to the scrollback; the caller decides when to repaint
+void AppendLogRows(const std::string& text) {
+    logModel.Append(Widen(text));
+}
 
-    std::wstring wtext(text.begin(), text.end());
-    wtext += L"\r\n";
+void RefreshLogBox(bool paintNow) {
+    if (!hwndLogBox) return;
+    UpdateLogScrollBar(hwndLogBox);
+    InvalidateRect(hwndLogBox, NULL, FALSE);
+    // Start/Stop block the UI thread for a while; show progress as it happens
+    if (paintNow) UpdateWindow(hwndLogBox);
+}
 
-    // CRITICAL: Remove read-only flag temporarily
-    SendMessageW(hwndLogBox, EM_SETREADONLY, FALSE, 0);
-    
-    // Set selection to end of text
-    SendMessageW(hwndLogBox, EM_SETSEL, -1, -1);
-    
-    // Replace selection (which is at the end) with new text
-    SendMessageW(hwndLogBox, EM_REPLACESEL, FALSE, (LPARAM)wtext.c_str());
-    
-    // Restore read-only flag
-    SendMessageW(hwndLogBox, EM_SETREADONLY, TRUE, 0);
-    
-    // Force scroll to bottom after text is added
-    SendMessageW(hwndLogBox, WM_VSCROLL, SB_BOTTOM, 0);
+void AppendLog(const std::string& text) {
+    AppendLogRows(text);
+    RefreshLogBox(true);
 }
 
-// Utility to read from pipe and append to log window
+// Reads child output into the log channel; the UI thread drains it on a timer
 void ReadPipeAndLog(HANDLE hPipe) {
-    char buffer[512];
+    std::vector<char> buffer(64 * 1024);
+    LineSplitter splitter;
     DWORD bytesRead;
+    auto push = [](char* line, size_t len) { childLog.Push(line, len, "python"); };
 
-    while (ReadFile(hPipe, buffer, sizeof(buffer) - 1, &bytesRead, NULL)) {
-        buffer[bytesRead] = '\0';
-        
-        // Split by newlines and append each line
-        std::string line;
-        for (DWORD i = 0; i < bytesRead; i++) {
-            if (buffer[i] == '\n' || buffer[i] == '\r') {
-                if (!line.empty()) {
-                    AppendLog(line);
-                    line.clear();
-                }
-            } else {
-                line += buffer[i];
-            }
+    while (ReadFile(hPipe, buffer.data(), (DWORD)buffer.size(), &bytesRead, NULL) && bytesRead) {
+        std::lock_guard<std::mutex> lock(childLogWriter);
+        splitter.Feed(buffer.data(), bytesRead, push);
+    }
+    {
+        std::lock_guard<std::mutex> lock(childLogWriter);
+        splitter.Flush(push);
+    }
+    CloseHandle(hPipe);
+}
+
+std::string FormatLogRecord(const LogRecord& record) {
+    std::string line = "[" + record.source + "] ";
+    if (record.level >= LogLevel::Warning) {
+        line += LogLevelName(record.level);
+        line += ": ";
+    }
+    line += record.message;
+    return line;
+}
+
+// Everything that arrived since the last tick, then one repaint
+void DrainChildLog() {
+    size_t shown = 0;
+    childLog.Drain([&](LogRecord& record) {
+        if (record.level == LogLevel::Debug) return;
+        AppendLogRows(FormatLogRecord(record));
+        shown++;
+        if (startupPending && record.event == "ready" &&
+            startupTimer.Ready(record.source, record.timestamp) &&
+            startupTimer.ReadyCount() >= startupExpected) {
+            startupPending = false;
+            AppendLogRows(startupTimer.Report());
         }
-        // Append any remaining text
-        if (!line.empty()) {
-            AppendLog(line);
+    });
+    uint64_t dropped = childLog.TakeDropped();
+    if (dropped) AppendLogRows("(" + std::to_string(dropped) + " log lines dropped)");
+    if (shown || dropped) RefreshLogBox(false);
+}
+
+// A child that exits before it is ready usually lacks a module the
+// dependency stamp vouched for, so the stamp is dropped and the next Start
+// checks again
+void CheckStartup() {
+    if (!startupPending) return;
+    HANDLE watched[2] = { startupWatchServer ? piBroadcast.hProcess : NULL, piClient.hProcess };
+    const char* names[2] = { "Broadcast server", "Clipboard client" };
+    for (int i = 0; i < 2; i++) {
+        if (watched[i] && WaitForSingleObject(watched[i], 0) == WAIT_OBJECT_0) {
+            startupPending = false;
+            AppendLog(std::string(names[i]) + " exited during startup");
+            if (!depsStampPath.empty() && DeleteFileW(Widen(depsStampPath).c_str())) {
+                AppendLog("Dependencies will be checked again on the next Start");
+            }
+            return;
         }
     }
+    if (startupTimer.ElapsedMs() > STARTUP_TIMEOUT_MS) {
+        startupPending = false;
+        AppendLog("Still not ready after " + std::to_string(STARTUP_TIMEOUT_MS / 1000) + " s");
+    }
 }
 
 void UpdateButtonStates() {
@@ -218,75 +317,146 @@ void HandleExternalCheckboxClick() {
     // Optional: Show a message about what changed
     BOOL isExternal = (SendMessage(hwndChkExternal, BM_GETCHECK, 0, 0) == BST_CHECKED);
     if (isExternal) {
-        AppendLog("Switched to external server mode", false);
+        AppendLog("Switched to external server mode");
     } else {
-        AppendLog("Switched to local server mode", false);
+        AppendLog("Switched to local server mode");
     }
 }
 
-void CleanupTempFiles() {
-    if (!broadcastFilePath.empty()) {
-        if (DeleteFileA(broadcastFilePath.c_str())) {
-            AppendLog("Deleted broadcast.py");
-        } else {
-            AppendLog("Could not delete broadcast.py");
+// Launches a UTF-8 command line; CreateProcessW needs UTF-16 in a writable buffer
+BOOL CreateProcessUtf8(const std::string& cmd, BOOL inheritHandles, STARTUPINFOW* si, PROCESS_INFORMATION* pi) {
+    std::wstring wcmd = Widen(cmd);
+    return CreateProcessW(NULL, &wcmd[0], NULL, NULL, inheritHandles,
+                          CREATE_NO_WINDOW, NULL, NULL, si, pi);
+}
+
+// CommandRunner for the remote pipeline: hidden window, `input` through a
+// stdin pipe, output to the log pipe (or nowhere when `output` is NULL)
+class Win32CommandRunner : public CommandRunner {
+public:
+    explicit Win32CommandRunner(HANDLE output) : output_(output) {}
+
+    RunResult Run(const std::string& command, std::string_view input, int timeoutMs, int& exitCode) override {
+        SECURITY_ATTRIBUTES sa = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+        HANDLE stdinRead, stdinWrite;
+        if (!CreatePipe(&stdinRead, &stdinWrite, &sa, 0)) return RunResult::NotStarted;
+        SetHandleInformation(stdinWrite, HANDLE_FLAG_INHERIT, 0);
+
+        STARTUPINFOW si = {};
+        si.cb = sizeof(si);
+        si.hStdInput = stdinRead;
+        si.hStdOutput = si.hStdError = output_;
+        si.dwFlags |= STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
+        si.wShowWindow = SW_HIDE;
+
+        PROCESS_INFORMATION pi = {};
+        BOOL started = CreateProcessUtf8(command, TRUE, &si, &pi);
+        CloseHandle(stdinRead);
+        if (!started) {
+            CloseHandle(stdinWrite);
+            return RunResult::NotStarted;
         }
-        broadcastFilePath.clear();
-    }
-    
-    if (!clipboardFilePath.empty()) {
-        if (DeleteFileA(clipboardFilePath.c_str())) {
-            AppendLog("Deleted clipboard.py");
-        } else {
-            AppendLog("Could not delete clipboard.py");
+
+        // ssh forwards stdin as it goes; if it exits early the write fails
+        const char* data = input.data();
+        size_t left = input.size();
+        DWORD written = 0;
+        while (left && WriteFile(stdinWrite, data, (DWORD)std::min<size_t>(left, 1 << 20), &written, NULL)) {
+            data += written;
+            left -= written;
+        }
+        CloseHandle(stdinWrite);
+
+        RunResult result = RunResult::Finished;
+        if (WaitForSingleObject(pi.hProcess, (DWORD)timeoutMs) != WAIT_OBJECT_0) {
+            TerminateProcess(pi.hProcess, 1);
+            result = RunResult::TimedOut;
         }
-        clipboardFilePath.clear();
+        DWORD code = 1;
+        GetExitCodeProcess(pi.hProcess, &code);
+        exitCode = (int)code;
+        CloseHandle(pi.hProcess);
+        CloseHandle(pi.hThread);
+        return result;
     }
+
+private:
+    HANDLE output_;
+};
+
+// The external server from the form. Windows' OpenSSH can't multiplex
+// connections, so each call is its own session; the pipeline keeps those to
+// one per Start and one per Stop.
+// The external host field may start with https:// when the server has a
+// certificate (spill.crt and spill.key in its directory). Strips the scheme
+// so ssh and the probe get a bare host name; true for https.
+bool SplitExternalScheme(std::string& host) {
+    bool secure = host.compare(0, 8, "https://") == 0;
+    if (secure) host.erase(0, 8);
+    else if (host.compare(0, 7, "http://") == 0) host.erase(0, 7);
+    return secure;
+}
+
+RemoteTarget ExternalTarget() {
+    wchar_t extHost[256];
+    GetWindowTextW(hwndInputExtHost, extHost, 256);
+    RemoteTarget target;
+    target.host = Narrow(extHost);
+    SplitExternalScheme(target.host);
+    if (target.host.empty()) target.host = "localhost";
+    return target;
+}
+
+// GET http(s)://host:port/path with short timeouts; true on a 200. Over
+// https any certificate will do: this only asks whether the server is up,
+// and the clipboard client checks the certificate before sending a clip.
+bool HttpGetOk(const std::string& host, int port, const wchar_t* path, int timeoutMs, bool secure = false) {
+    HINTERNET session = WinHttpOpen(L"spill", WINHTTP_ACCESS_TYPE_NO_PROXY,
+                                    WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+    if (!session) return false;
+    WinHttpSetTimeouts(session, timeoutMs, timeoutMs, timeoutMs, timeoutMs);
+    bool ok = false;
+    HINTERNET connection = WinHttpConnect(session, Widen(host).c_str(), (INTERNET_PORT)port, 0);
+    HINTERNET request = connection ? WinHttpOpenRequest(connection, L"GET", path, NULL, WINHTTP_NO_REFERER,
+                                                        WINHTTP_DEFAULT_ACCEPT_TYPES,
+                                                        secure ? WINHTTP_FLAG_SECURE : 0) : NULL;
+    if (request && secure) {
+        DWORD ignore = SECURITY_FLAG_IGNORE_UNKNOWN_CA | SECURITY_FLAG_IGNORE_CERT_CN_INVALID |
+                       SECURITY_FLAG_IGNORE_CERT_DATE_INVALID;
+        WinHttpSetOption(request, WINHTTP_OPTION_SECURITY_FLAGS, &ignore, sizeof(ignore));
+    }
+    if (request && WinHttpSendRequest(request, WINHTTP_NO_ADDITIONAL_HEADERS, 0, WINHTTP_NO_REQUEST_DATA, 0, 0, 0) &&
+        WinHttpReceiveResponse(request, NULL)) {
+        DWORD status = 0;
+        DWORD size = sizeof(status);
+        ok = WinHttpQueryHeaders(request, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                                 WINHTTP_HEADER_NAME_BY_INDEX, &status, &size, WINHTTP_NO_HEADER_INDEX) &&
+             status == 200;
+    }
+    if (request) WinHttpCloseHandle(request);
+    if (connection) WinHttpCloseHandle(connection);
+    WinHttpCloseHandle(session);
+    return ok;
 }
 
 void StopProcesses() {
     if (!processesStarted) return;
 
     AppendLog("Stopping processes...");
+    startupPending = false;
 
     BOOL isExternal = (SendMessage(hwndChkExternal, BM_GETCHECK, 0, 0) == BST_CHECKED);
     
     if (isExternal) {
-        // External server mode - need to stop remote server via SSH
-        wchar_t extHost[256];
-        GetWindowTextW(hwndInputExtHost, extHost, 256);
-        std::wstring wsExtHost(extHost);
-        std::string extHostStr(wsExtHost.begin(), wsExtHost.end());
-        
-        if (extHostStr.empty()) extHostStr = "localhost";
-        
-        // Kill remote broadcast server
-        std::string killRemoteCmd = "ssh -o ConnectTimeout=10 -o BatchMode=yes -o StrictHostKeyChecking=no root@" + extHostStr + " \"pkill -f broadcast.py\"";
-        
-        STARTUPINFOA si = {};
-        si.cb = sizeof(si);
-        si.dwFlags = STARTF_USESHOWWINDOW;
-        si.wShowWindow = SW_HIDE;
-        
-        PROCESS_INFORMATION pi = {};
-        if (CreateProcessA(NULL, (LPSTR)killRemoteCmd.c_str(), NULL, NULL, FALSE, 
-                          CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
-            WaitForSingleObject(pi.hProcess, 10000); // 10 second timeout
-            CloseHandle(pi.hProcess);
-            CloseHandle(pi.hThread);
+        // External server mode - stop the remote server and remove its
+        // files in one SSH round trip
+        Win32CommandRunner runner(NULL);
+        RemoteDeployer deployer(runner, ExternalTarget());
+        DeployStatus status = deployer.Stop(10000);
+        if (status == DeployStatus::Ok) {
             AppendLog("Remote broadcast server stopped");
         } else {
-            AppendLog("Could not stop remote broadcast server");
-        }
-        
-        // Clean up remote temp file
-        std::string cleanupCmd = "ssh -o ConnectTimeout=10 -o BatchMode=yes -o StrictHostKeyChecking=no root@" + extHostStr + " \"rm -f /tmp/broadcast.py /tmp/broadcast.log\"";
-        if (CreateProcessA(NULL, (LPSTR)cleanupCmd.c_str(), NULL, NULL, FALSE, 
-                          CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
-            WaitForSingleObject(pi.hProcess, 10000);
-            CloseHandle(pi.hProcess);
-            CloseHandle(pi.hThread);
-            AppendLog("Remote files cleaned up");
+            AppendLog(std::string("Could not stop remote broadcast server: ") + DeployStatusText(status));
         }
         
         // Stop local clipboard client
@@ -323,24 +493,136 @@ void StopProcesses() {
     piClient = {};
     processesStarted = false;
 
-    CleanupTempFiles();
     AppendLog("All processes stopped");
     UpdateButtonStates();
 }
 
-std::string writeTempFile(const std::string& filename, const char* content) {
-    std::ofstream out(filename);
-    out << content;
-    out.close();
-    return filename;
+// Runs a command with its output on the log pipe and waits for it; false if
+// it could not be started or was still running after timeoutMs
+bool RunAndWait(const std::string& cmd, STARTUPINFOW* si, DWORD timeoutMs, DWORD& exitCode) {
+    PROCESS_INFORMATION pi = {};
+    if (!CreateProcessUtf8(cmd, TRUE, si, &pi)) return false;
+    bool finished = WaitForSingleObject(pi.hProcess, timeoutMs) == WAIT_OBJECT_0;
+    if (!finished) TerminateProcess(pi.hProcess, 1);
+    exitCode = 1;
+    GetExitCodeProcess(pi.hProcess, &exitCode);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+    return finished;
 }
 
-void StartPythonProcesses(const std::string& host, const std::string& user) {
-    SECURITY_ATTRIBUTES sa = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
-    HANDLE readPipe, writePipe;
-    CreatePipe(&readPipe, &writePipe, &sa, 0);
-    SetHandleInformation(readPipe, HANDLE_FLAG_INHERIT, 0);
+// %LOCALAPPDATA%\spill\ (with the trailing separator), created on first use;
+// empty (the working directory) if that is not available
+std::string AssetDir() {
+    if (!assetDir.empty()) return assetDir;
+    wchar_t base[MAX_PATH];
+    DWORD len = GetEnvironmentVariableW(L"LOCALAPPDATA", base, MAX_PATH);
+    if (len == 0 || len >= MAX_PATH) return "";
+    std::wstring dir = std::wstring(base) + L"\\spill";
+    CreateDirectoryW(dir.c_str(), NULL);
+    DWORD attributes = GetFileAttributesW(dir.c_str());
+    if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY)) return "";
+    assetDir = Narrow(dir) + "\\";
+    return assetDir;
+}
+
+bool ReadSmallFile(const std::string& path, std::string& out) {
+    HANDLE file = CreateFileW(Widen(path).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    char buffer[4096];
+    DWORD bytesRead = 0;
+    bool ok = ReadFile(file, buffer, sizeof(buffer), &bytesRead, NULL) != 0;
+    CloseHandle(file);
+    if (ok) out.assign(buffer, bytesRead);
+    return ok;
+}
+
+// Writes beside the target and renames over it, so nobody ever runs half a
+// script
+bool WriteFileAtomic(const std::string& path, std::string_view data) {
+    std::wstring tmpPath = Widen(path + ".tmp");
+    HANDLE file = CreateFileW(tmpPath.c_str(), GENERIC_WRITE, 0, NULL,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    DWORD written = 0;
+    bool ok = WriteFile(file, data.data(), (DWORD)data.size(), &written, NULL) && written == data.size();
+    CloseHandle(file);
+    if (ok) ok = MoveFileExW(tmpPath.c_str(), Widen(path).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+    if (!ok) DeleteFileW(tmpPath.c_str());
+    return ok;
+}
+
+// Embedded scripts live at <asset dir>\<stem>-<hash>.py. If that file exists
+// with the right size it is current, so a normal Start neither reads nor
+// writes it; a new build extracts its version once and removes older ones.
+std::string ExtractAsset(const std::string& stem, const char* content) {
+    std::string_view data(content);
+    std::string dir = AssetDir();
+    std::string path = dir + stem + "-" + HashHex(AssetHash(data)) + ".py";
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (GetFileAttributesExW(Widen(path).c_str(), GetFileExInfoStandard, &info) &&
+        (((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow) == data.size()) {
+        return path;
+    }
+    if (!WriteFileAtomic(path, data)) return "";
+
+    WIN32_FIND_DATAW found;
+    HANDLE search = FindFirstFileW(Widen(dir + stem + "-*.py").c_str(), &found);
+    if (search != INVALID_HANDLE_VALUE) {
+        do {
+            std::string oldPath = dir + Narrow(found.cFileName);
+            if (oldPath != path) DeleteFileW(Widen(oldPath).c_str());
+        } while (FindNextFileW(search, &found));
+        FindClose(search);
+    }
+    AppendLog("Extracted " + path);
+    return path;
+}
+
+// Which python is on PATH and which build of it: size and mtime change
+// whenever it is upgraded or replaced. Empty if it can't be found.
+std::string PythonFingerprint(const std::string& packages) {
+    wchar_t python[MAX_PATH];
+    DWORD len = SearchPathW(NULL, L"python", L".exe", MAX_PATH, python, NULL);
+    if (len == 0 || len >= MAX_PATH) return "";
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExW(python, GetFileExInfoStandard, &info)) return "";
+    uint64_t size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    uint64_t mtime = ((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+    return Fingerprint({Narrow(python), std::to_string(size), std::to_string(mtime), packages});
+}
+
+// pip takes seconds even when there is nothing to install, so it only runs
+// for a python we haven't seen with these packages, and only if importing
+// them fails. Success is remembered in a stamp holding the fingerprint.
+bool EnsureDependencies(const std::string& packages, const std::string& modules, STARTUPINFOW* si) {
+    std::string fingerprint = PythonFingerprint(packages);
+    depsStampPath = AssetDir() + "deps-" + HashHex(AssetHash(packages)) + ".stamp";
+    std::string stamp;
+    if (!fingerprint.empty() && ReadSmallFile(depsStampPath, stamp) && stamp == fingerprint) {
+        AppendLog("Dependencies up to date (" + packages + ")");
+        return true;
+    }
+
+    DWORD exitCode = 1;
+    if (RunAndWait("python -c \"import " + modules + "\"", si, 30000, exitCode) && exitCode == 0) {
+        AppendLog("Dependencies already installed (" + packages + ")");
+    } else {
+        AppendLog("Installing dependencies (" + packages + ")...");
+        if (!RunAndWait("pip install " + packages, si, PIP_TIMEOUT_MS, exitCode) || exitCode != 0) {
+            AppendLog("pip install failed");
+            return false;
+        }
+        AppendLog("Dependencies installed");
+    }
+    if (!fingerprint.empty()) WriteFileAtomic(depsStampPath, fingerprint);
+    return true;
+}
 
+// Brings up the server and client with their output on writePipe; false
+// if setup stopped part way
+bool LaunchComponents(const std::string& host, const std::string& user, HANDLE writePipe) {
     // Determine the server URL to use
     std::string serverUrl;
     BOOL isExternal = (SendMessage(hwndChkExternal, BM_GETCHECK, 0, 0) == BST_CHECKED);
@@ -353,209 +635,161 @@ void StartPythonProcesses(const std::string& host, const std::string& user) {
         
         std::wstring wsExtHost(extHost);
         std::wstring wsExtPort(extPort);
-        std::string extHostStr(wsExtHost.begin(), wsExtHost.end());
-        std::string extPortStr(wsExtPort.begin(), wsExtPort.end());
+        std::string extHostStr = Narrow(wsExtHost);
+        std::string extPortStr = Narrow(wsExtPort);
         
+        bool secure = SplitExternalScheme(extHostStr);
         if (extHostStr.empty()) extHostStr = "localhost";
         if (extPortStr.empty()) extPortStr = "8000";
         
-        serverUrl = "http://" + extHostStr + ":" + extPortStr;
+        serverUrl = (secure ? "https://" : "http://") + extHostStr + ":" + extPortStr;
         AppendLog("Setting up external server: " + extHostStr);
+        SetEnvironmentVariableW(L"SPILL_RING", NULL);  // clips go over HTTP
 
-        // Create temp files locally first
-        broadcastFilePath = writeTempFile("broadcast.py", broadcast_py);
-        clipboardFilePath = writeTempFile("clipboard.py", clipboard_py);
+        // Only the client runs here; the server script goes over SSH
+        clipboardFilePath = ExtractAsset("clipboard", clipboard_py);
+        if (clipboardFilePath.empty()) {
+            AppendLog("Could not write the scripts to " + AssetDir());
+            return false;
+        }
+        startupTimer.Phase("assets");
 
         // Startup info with HIDDEN window
-        STARTUPINFOA si = {};
+        STARTUPINFOW si = {};
         si.cb = sizeof(si);
         si.hStdOutput = si.hStdError = writePipe;
         si.dwFlags |= STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
         si.wShowWindow = SW_HIDE;
 
-        PROCESS_INFORMATION pi = {};
-
-        // Step 1: Test SSH connection
-        std::string sshTestCmd = "ssh -o ConnectTimeout=10 -o BatchMode=yes -o StrictHostKeyChecking=no root@" + extHostStr + " \"echo SSH connection successful\"";
-        AppendLog("Testing SSH connection...");
-        
-        if (!CreateProcessA(NULL, (LPSTR)sshTestCmd.c_str(), NULL, NULL, TRUE, 
-                           CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
-            AppendLog("Failed to test SSH connection");
-            MessageBoxA(NULL, "Failed to test SSH connection", "Error", MB_OK | MB_ICONERROR);
-            return;
+        // Step 1: Local dependencies for the clipboard client
+        if (!EnsureDependencies("pywin32 requests cryptography", "win32clipboard, requests, cryptography", &si)) {
+            AppendLog("Warning: Local pip install may have failed, continuing anyway...");
         }
-        
-        WaitForSingleObject(pi.hProcess, 30000); // 30 second timeout
-        DWORD exitCode = 0;
-        GetExitCodeProcess(pi.hProcess, &exitCode);
-        CloseHandle(pi.hProcess);
-        CloseHandle(pi.hThread);
-        
-        if (exitCode != 0) {
+        startupTimer.Phase("deps");
+
+        // Step 2: Stage, install and start on the remote host in one round trip
+        AppendLog("Deploying broadcast server to " + extHostStr + "...");
+        Win32CommandRunner runner(writePipe);
+        RemoteDeployer deployer(runner, ExternalTarget());
+        DeployStatus status = deployer.BringUp(broadcast_py, "flask requests", PIP_TIMEOUT_MS);
+        if (status == DeployStatus::SshFailed) {
             AppendLog("SSH connection failed - check your SSH keys and host");
             MessageBoxA(NULL, "SSH connection failed. Please ensure:\n- SSH keys are set up\n- Host is reachable\n- Root access is available", "SSH Error", MB_OK | MB_ICONERROR);
-            return;
+            return false;
         }
-        
-        AppendLog("SSH connection successful");
-
-        // Step 2: Install Python dependencies on remote server
-        std::string remotePipCmd = "ssh -o ConnectTimeout=10 -o BatchMode=yes -o StrictHostKeyChecking=no root@" + extHostStr + " \"cd /tmp && python3 -m venv clipenv && source clipenv/bin/activate && pip install flask requests\"";
-        AppendLog("Installing dependencies on remote server...");
-        
-        if (!CreateProcessA(NULL, (LPSTR)remotePipCmd.c_str(), NULL, NULL, TRUE, 
-                           CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
-            AppendLog("Failed to install remote dependencies");
-            return;
-        }
-        
-        WaitForSingleObject(pi.hProcess, 60000); // 60 second timeout for pip install
-        GetExitCodeProcess(pi.hProcess, &exitCode);
-        CloseHandle(pi.hProcess);
-        CloseHandle(pi.hThread);
-        
-        if (exitCode != 0) {
-            AppendLog("Warning: Remote pip install may have failed, continuing anyway...");
-        } else {
-            AppendLog("Remote dependencies installed");
-        }
-
-        // Step 3: Copy broadcast.py to remote server
-        std::string scpCmd = "scp -o ConnectTimeout=10 -o BatchMode=yes -o StrictHostKeyChecking=no \"" + broadcastFilePath + "\" root@" + extHostStr + ":/tmp/broadcast.py";
-        AppendLog("Copying broadcast.py to remote server...");
-        
-        if (!CreateProcessA(NULL, (LPSTR)scpCmd.c_str(), NULL, NULL, TRUE, 
-                           CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
-            AppendLog("Failed to copy broadcast.py to remote server");
-            return;
-        }
-        
-        WaitForSingleObject(pi.hProcess, 30000);
-        GetExitCodeProcess(pi.hProcess, &exitCode);
-        CloseHandle(pi.hProcess);
-        CloseHandle(pi.hThread);
-        
-        if (exitCode != 0) {
-            AppendLog("Failed to copy broadcast.py - check SCP access");
-            return;
-        }
-        
-        AppendLog("broadcast.py copied to remote server");
-
-        // Step 4: Start broadcast.py on remote server
-        std::string remoteBroadcastCmd = "ssh -o ConnectTimeout=10 -o BatchMode=yes -o StrictHostKeyChecking=no root@" + extHostStr + " \"cd /tmp && source clipenv/bin/activate && nohup python broadcast.py > broadcast.log 2>&1 &\"";
-        AppendLog("Starting broadcast server on remote host...");
-        
-        if (!CreateProcessA(NULL, (LPSTR)remoteBroadcastCmd.c_str(), NULL, NULL, TRUE, 
-                           CREATE_NO_WINDOW, NULL, NULL, &si, &piBroadcast)) {
-            AppendLog("Failed to start remote broadcast server");
-            return;
-        }
-        
-        // Give the remote server a moment to start
-        Sleep(2000);
-        AppendLog("Remote broadcast server started");
-
-        // Step 5: Install local dependencies for clipboard client
-        std::string localPipCmd = "pip install pywin32 requests";
-        AppendLog("Installing local dependencies...");
-        
-        if (!CreateProcessA(NULL, (LPSTR)localPipCmd.c_str(), NULL, NULL, TRUE, 
-                           CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
-            AppendLog("Failed to install local dependencies");
-            return;
-        }
-        
-        WaitForSingleObject(pi.hProcess, 60000);
-        GetExitCodeProcess(pi.hProcess, &exitCode);
-        CloseHandle(pi.hProcess);
-        CloseHandle(pi.hThread);
-        
-        if (exitCode != 0) {
-            AppendLog("Warning: Local pip install may have failed, continuing anyway...");
-        } else {
-            AppendLog("Local dependencies installed");
+        if (status != DeployStatus::Ok) {
+            AppendLog(std::string("Remote setup failed: ") + DeployStatusText(status) +
+                      " (exit " + std::to_string(deployer.ExitCode()) + ")");
+            return false;
         }
+        startupTimer.Phase("remote setup");
 
-        // Step 6: Start local clipboard client
+        // Step 3: Start the local clipboard client; it waits for the server itself
         std::string localClientCmd = "python \"" + clipboardFilePath + "\" \"" + serverUrl + "\" " + user;
         AppendLog("Starting local clipboard client...");
         
-        if (!CreateProcessA(NULL, (LPSTR)localClientCmd.c_str(), NULL, NULL, TRUE, 
-                           CREATE_NO_WINDOW, NULL, NULL, &si, &piClient)) {
+        if (!CreateProcessUtf8(localClientCmd, TRUE, &si, &piClient)) {
             AppendLog("Failed to start local clipboard client");
-            return;
+            return false;
         }
         
         AppendLog("Local clipboard client started");
-        AppendLog("External server setup complete!");        
+        startupTimer.Phase("launch");
+
+        // Step 4: Poll the server's readiness probe instead of guessing
+        int port = atoi(extPortStr.c_str());
+        int probes = 0;
+        if (WaitUntilReady([&] { return HttpGetOk(extHostStr, port, L"/healthz", 2000, secure); },
+                           Backoff(50, 1000, REMOTE_READY_MS), &probes)) {
+            startupTimer.Ready("server");
+            AppendLog("Remote broadcast server is up (" + std::to_string(probes) + " probes)");
+        } else {
+            AppendLog("Warning: " + serverUrl + "/healthz did not answer; check the port and firewall");
+        }
+        AppendLog("External server setup complete!");
+        startupExpected = startupTimer.ReadyCount() + 1;  // and the client
+        startupWatchServer = false;
     } else {
         // Local server mode (original logic)
         serverUrl = host;
         AppendLog("Using local server mode: " + serverUrl);
 
-        // Create temp files
-        broadcastFilePath = writeTempFile("broadcast.py", broadcast_py);
-        clipboardFilePath = writeTempFile("clipboard.py", clipboard_py);
-        
-        // Construct command lines
-        std::string cmd1 = "python \"" + broadcastFilePath + "\"";
-        std::string cmd2 = "python \"" + clipboardFilePath + "\" \"" + serverUrl + "\" " + user;
-        std::string pipCmd = "pip install pywin32 requests flask";
-
         // Startup info with HIDDEN window
-        STARTUPINFOA si = {};
+        STARTUPINFOW si = {};
         si.cb = sizeof(si);
         si.hStdOutput = si.hStdError = writePipe;
         si.dwFlags |= STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
         si.wShowWindow = SW_HIDE;
 
-        PROCESS_INFORMATION pi = {};
-        
-        // Install dependencies locally
-        if (!CreateProcessA(NULL, (LPSTR)pipCmd.c_str(), NULL, NULL, TRUE, 
-                           CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
-            MessageBoxA(NULL, "Failed to run pip install", "Error", MB_OK | MB_ICONERROR);
-            return;
+        // Install dependencies locally (usually just a stamp check)
+        if (!EnsureDependencies("pywin32 requests cryptography flask", "win32clipboard, requests, cryptography, flask", &si)) {
+            MessageBoxA(NULL, "pip install failed", "Error", MB_OK | MB_ICONERROR);
+            return false;
         }
+        startupTimer.Phase("deps");
 
-        WaitForSingleObject(pi.hProcess, INFINITE);
-        DWORD exitCode = 0;
-        GetExitCodeProcess(pi.hProcess, &exitCode);
-        CloseHandle(pi.hProcess);
-        CloseHandle(pi.hThread);
+        broadcastFilePath = ExtractAsset("broadcast", broadcast_py);
+        clipboardFilePath = ExtractAsset("clipboard", clipboard_py);
+        if (broadcastFilePath.empty() || clipboardFilePath.empty()) {
+            AppendLog("Could not write the scripts to " + AssetDir());
+            return false;
+        }
+        startupTimer.Phase("assets");
 
-        if (exitCode != 0) {
-            MessageBoxA(NULL, "pip install failed", "Error", MB_OK | MB_ICONERROR);
-            return;
-        } else {
-            AppendLog("Dependencies installed, starting Python processes...");
-            
-            // Start broadcast.py locally
-            if (CreateProcessA(NULL, (LPSTR)cmd1.c_str(), NULL, NULL, TRUE, 
-                              CREATE_NO_WINDOW, NULL, NULL, &si, &piBroadcast)) {
-                AppendLog("Local broadcast server started");
-                
-                // Start clipboard.py locally
-                if (CreateProcessA(NULL, (LPSTR)cmd2.c_str(), NULL, NULL, TRUE, 
-                                  CREATE_NO_WINDOW, NULL, NULL, &si, &piClient)) {
-                    AppendLog("Local clipboard client started");
-                } else {
-                    AppendLog("Failed to start local clipboard client");
-                }        
+        // Clips reach the server through a shared-memory ring instead of
+        // loopback HTTP; the name is per GUI, so two spills don't share one
+        std::wstring ringName = L"spill-ring-" + std::to_wstring(GetCurrentProcessId());
+        SetEnvironmentVariableW(L"SPILL_RING", ringName.c_str());
+
+        // Construct command lines
+        std::string cmd1 = "python \"" + broadcastFilePath + "\"";
+        std::string cmd2 = "python \"" + clipboardFilePath + "\" \"" + serverUrl + "\" " + user;
+
+        // Both start right away; the client waits for the server to bind
+        if (CreateProcessUtf8(cmd1, TRUE, &si, &piBroadcast)) {
+            AppendLog("Local broadcast server started");
+
+            if (CreateProcessUtf8(cmd2, TRUE, &si, &piClient)) {
+                AppendLog("Local clipboard client started");
             } else {
-                AppendLog("Failed to start local broadcast server");
+                AppendLog("Failed to start local clipboard client");
             }
+        } else {
+            AppendLog("Failed to start local broadcast server");
         }
+        startupTimer.Phase("launch");
+        startupExpected = 2;
+        startupWatchServer = true;
     }
+    return true;
+}
 
-    processesStarted = true;
-    CloseHandle(writePipe);
-    UpdateButtonStates();   
-    
-    // Start thread to read process output
+void StartPythonProcesses(const std::string& host, const std::string& user) {
+    SECURITY_ATTRIBUTES sa = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+    HANDLE readPipe, writePipe;
+    CreatePipe(&readPipe, &writePipe, &sa, 0);
+    SetHandleInformation(readPipe, HANDLE_FLAG_INHERIT, 0);
+
+    // Read from the start: pip and the import check write to the pipe while
+    // we wait for them, and a full pipe would stall them
     std::thread(ReadPipeAndLog, readPipe).detach();
+
+    // Children inherit this and write JSON-lines records for the log channel
+    SetEnvironmentVariableW(L"SPILL_LOG_JSON", L"1");
+    // The client seals clips with AES-GCM when this CPU has AES-NI, else ChaCha20
+    SetEnvironmentVariableW(L"SPILL_CIPHER", Widen(ClipCipherName(PreferredClipCipher())).c_str());
+
+    startupTimer.Begin();
+    startupPending = false;
+    bool launched = LaunchComponents(host, user, writePipe);
+
+    // The children have their own copies; the reader ends once they exit
+    CloseHandle(writePipe);
+    if (!launched) return;
+
+    processesStarted = true;
+    startupPending = piClient.hProcess != NULL;
+    UpdateButtonStates();
 }
 
 void KillProcesses() {
@@ -592,6 +826,7 @@ LRESULT CALLBACK TrayProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             break;
 
         case WM_DESTROY:
+            KillTimer(hwnd, ID_TIMER_LOG);
             if (hLogBoxFont) {
                 DeleteObject(hLogBoxFont);
                 hLogBoxFont = NULL;
@@ -643,6 +878,14 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             SetForegroundWindow(hwnd);
             return 0;
 
+        case WM_TIMER:
+            if (wParam == ID_TIMER_LOG) {
+                DrainChildLog();
+                CheckStartup();
+                return 0;
+            }
+            break;
+
         case WM_GETMINMAXINFO: {
             // Prevent window resizing by setting min and max size to the same value
             LPMINMAXINFO lpMMI = (LPMINMAXINFO)lParam;
@@ -664,14 +907,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             return (LRESULT)hBackgroundBrush;
 
         case WM_CTLCOLOREDIT:
-            // Handle edit control colors
-            if ((HWND)lParam == hwndLogBox) {
-                // Special styling for log box
-                SetTextColor((HDC)wParam, RGB(0, 0, 0));  // Black text
-                SetBkColor((HDC)wParam, RGB(200, 230, 200));  // Light pistachio green
-                return (LRESULT)hLogBoxBrush;
-            }
-            // For all other edit controls, use default white background
+            // Edit controls use the default white background
             SetTextColor((HDC)wParam, RGB(0, 0, 0));  // Black text
             SetBkColor((HDC)wParam, RGB(255, 255, 255));  // White background
             return (LRESULT)GetStockObject(WHITE_BRUSH);
@@ -736,18 +972,28 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             hwndBtnStart = CreateWindowW(L"BUTTON", L"Start", WS_VISIBLE | WS_CHILD | WS_TABSTOP, 100, 130, 80, 25, hwnd, (HMENU)ID_BTN_START, hInst, NULL);
             hwndBtnStop = CreateWindowW(L"BUTTON", L"Stop", WS_VISIBLE | WS_CHILD | WS_TABSTOP, 190, 130, 80, 25, hwnd, (HMENU)ID_BTN_STOP, hInst, NULL);
 
-            hwndLogBox = CreateWindowW(L"EDIT", L"", 
-                WS_VISIBLE | WS_CHILD | WS_BORDER | ES_MULTILINE | ES_AUTOVSCROLL | WS_VSCROLL | ES_READONLY,
+            hwndLogBox = CreateWindowW(LOG_BOX_CLASS, L"",
+                WS_VISIBLE | WS_CHILD | WS_BORDER | WS_VSCROLL,
                 10, 170, 370, 120, hwnd, NULL, hInst, NULL);
 
             hwndVersionLabel = CreateWindowW(L"STATIC", L"inversepolarity v0.0.4a", 
                                            WS_VISIBLE | WS_CHILD | SS_RIGHT, 
                                            200, 300, 180, 20, hwnd, NULL, hInst, NULL);
-            // Subclass ONLY the log box
-            originalEditProc = (WNDPROC)SetWindowLongPtr(hwndLogBox, GWLP_WNDPROC, (LONG_PTR)LogBoxProc);
-
-            if (hLogBoxFont) {
-                SendMessage(hwndLogBox, WM_SETFONT, (WPARAM)hLogBoxFont, TRUE);
+            // Row height and wrap width of the log box come from its font
+            if (hwndLogBox) {
+                HDC hdc = GetDC(hwndLogBox);
+                HFONT oldFont = hLogBoxFont ? (HFONT)SelectObject(hdc, hLogBoxFont) : NULL;
+                TEXTMETRICW tm;
+                GetTextMetricsW(hdc, &tm);
+                if (oldFont) SelectObject(hdc, oldFont);
+                ReleaseDC(hwndLogBox, hdc);
+
+                RECT logRect;
+                GetClientRect(hwndLogBox, &logRect);
+                logLineHeight = std::max(1, (int)tm.tmHeight);
+                int charWidth = std::max(1, (int)tm.tmAveCharWidth);
+                logModel.SetColumns((size_t)std::max(8, (int)(logRect.right - logRect.left - 4) / charWidth));
+                UpdateLogScrollBar(hwndLogBox);
             }
 
             HWND hwndIcon = CreateWindowW(L"BUTTON", NULL, 
@@ -762,6 +1008,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             UpdateExternalServerState();
             UpdateButtonStates();
             AddTrayIcon(hwnd);
+            SetTimer(hwnd, ID_TIMER_LOG, LOG_DRAIN_MS, NULL);
         } break;
 
         case WM_APP_EXIT:
@@ -794,25 +1041,26 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                         
                         std::wstring wsExtHost(extHost);
                         std::wstring wsExtPort(extPort);
-                        std::string extHostStr(wsExtHost.begin(), wsExtHost.end());
-                        std::string extPortStr(wsExtPort.begin(), wsExtPort.end());
+                        std::string extHostStr = Narrow(wsExtHost);
+                        std::string extPortStr = Narrow(wsExtPort);
                         
                         // Use defaults if empty
+                        bool secure = SplitExternalScheme(extHostStr);
                         if (extHostStr.empty()) extHostStr = "localhost";
                         if (extPortStr.empty()) extPortStr = "8000";
                         
                         // Build the external server URL
-                        urlToOpen = "http://" + extHostStr + ":" + extPortStr;
+                        urlToOpen = (secure ? "https://" : "http://") + extHostStr + ":" + extPortStr;
                     } else {
                         // Local server mode - use the host URL field
                         wchar_t host[256];
                         GetWindowTextW(hwndInputHost, host, 256);
                         std::wstring wsHost(host);
-                        urlToOpen = std::string(wsHost.begin(), wsHost.end());
+                        urlToOpen = Narrow(wsHost);
                     }
                     
                     // Open the URL in the default browser
-                    ShellExecuteA(NULL, "open", urlToOpen.c_str(), NULL, NULL, SW_SHOWNORMAL);
+                    ShellExecuteW(NULL, L"open", Widen(urlToOpen).c_str(), NULL, NULL, SW_SHOWNORMAL);
                     break;
                 }               
                 case ID_BTN_START: {
@@ -822,8 +1070,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 
                     std::wstring wsHost(host);
                     std::wstring wsUser(user);
-                    std::string hostStr(wsHost.begin(), wsHost.end());
-                    std::string userStr(wsUser.begin(), wsUser.end());
+                    std::string hostStr = Narrow(wsHost);
+                    std::string userStr = Narrow(wsUser);
 
                     StartPythonProcesses(hostStr, userStr);
                     break;
@@ -923,6 +1171,13 @@ int WINAPI WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int nCmdShow) {
     wc.hCursor = LoadCursor(NULL, IDC_ARROW);
     RegisterClass(&wc);
 
+    WNDCLASS logClass = {};
+    logClass.lpfnWndProc = LogBoxProc;
+    logClass.hInstance = hInst;
+    logClass.lpszClassName = LOG_BOX_CLASS;
+    logClass.hCursor = LoadCursor(NULL, IDC_ARROW);
+    RegisterClass(&logClass);
+
     // Create window with fixed size and no maximize button
     HWND hwnd = CreateWindowEx(0, CLASS_NAME, L"spill", 
                                WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_MINIMIZEBOX,
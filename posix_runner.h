@@ -0,0 +1,73 @@
+#pragma once
+
+// CommandRunner for the Linux tools: runs a command line with /bin/sh, feeds
+// it `input` through a pipe and waits for it with a deadline. With
+// localShell it ignores the command line and runs the input with a local
+// `sh -s` instead, a stand-in for ssh that takes the same script, so the
+// bring-up pipeline can run (and be tested) against this machine.
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "remote_deploy.h"
+
+class PosixRunner : public CommandRunner {
+public:
+    explicit PosixRunner(bool localShell) : localShell_(localShell) {}
+
+    RunResult Run(const std::string& command, std::string_view input, int timeoutMs, int& exitCode) override {
+        std::string line = localShell_ ? "sh -s" : command;
+        int in[2];
+        if (pipe(in) != 0) return RunResult::NotStarted;
+        pid_t pid = fork();
+        if (pid < 0) {
+            close(in[0]);
+            close(in[1]);
+            return RunResult::NotStarted;
+        }
+        if (pid == 0) {
+            dup2(in[0], 0);
+            close(in[0]);
+            close(in[1]);
+            execl("/bin/sh", "sh", "-c", line.c_str(), (char*)nullptr);
+            _exit(127);
+        }
+        close(in[0]);
+        // A command that exits early just leaves the rest unread (EPIPE;
+        // callers ignore SIGPIPE)
+        const char* p = input.data();
+        size_t left = input.size();
+        while (left) {
+            ssize_t n = write(in[1], p, left);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            p += n;
+            left -= n;
+        }
+        close(in[1]);
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        int status = 0;
+        while (waitpid(pid, &status, WNOHANG) == 0) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                kill(pid, SIGKILL);
+                waitpid(pid, &status, 0);
+                return RunResult::TimedOut;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        return RunResult::Finished;
+    }
+
+private:
+    bool localShell_;
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+// Bring-up of the broadcast server on an external host over SSH.
+//
+// Everything the host needs happens in one `ssh ... sh -s` round trip: the
+// shell script arrives on stdin with the server script inlined as a
+// heredoc, so staging, the (stamped) venv + pip step and the restart cost
+// one connection instead of four. Where OpenSSH supports it, a ControlMaster
+// socket keeps that connection open for the Stop that follows. Readiness is
+// then polled on the server's /healthz with backoff instead of a fixed sleep.
+//
+// Commands go through a CommandRunner, so the same pipeline runs from the
+// GUI (CreateProcess) and from the Linux deploy tool, which can also swap
+// ssh for a local shell. Nothing here depends on Win32.
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "asset_hash.h"
+
+enum class RunResult { Finished, NotStarted, TimedOut };
+
+// Runs one command line with `input` on its stdin; its output goes wherever
+// the runner sends it (the GUI's log, the tool's terminal)
+class CommandRunner {
+public:
+    virtual ~CommandRunner() {}
+
+    // exitCode is only meaningful when the result is Finished; a command
+    // still running after timeoutMs is killed
+    virtual RunResult Run(const std::string& command, std::string_view input, int timeoutMs, int& exitCode) = 0;
+};
+
+struct RemoteTarget {
+    std::string host;
+    std::string user = "root";
+    std::string dir = "/tmp";       // where broadcast.py, its logs and the venv live
+    std::string sshCommand = "ssh";
+    std::string controlPath;        // SSH multiplexing socket; empty to disable
+};
+
+// Quotes for POSIX sh: 'it'\''s'
+inline std::string ShellQuote(std::string_view text) {
+    std::string out = "'";
+    for (char c : text) {
+        if (c == '\'') out += "'\\''";
+        else out += c;
+    }
+    return out + "'";
+}
+
+// `ssh <options> user@host sh -s`: the remote side runs whatever script we
+// pipe in, so nothing has to survive the command line quoting of both ends
+inline std::string SshScriptCommand(const RemoteTarget& target) {
+    std::string cmd = target.sshCommand;
+    cmd += " -o ConnectTimeout=10 -o BatchMode=yes -o StrictHostKeyChecking=no";
+    if (!target.controlPath.empty()) {
+        cmd += " -o ControlMaster=auto -o ControlPersist=120 -o \"ControlPath=" + target.controlPath + "\"";
+    }
+    cmd += " " + target.user + "@" + target.host + " sh -s";
+    return cmd;
+}
+
+// Stops a running server and waits until it has exited, so that it no
+// longer holds port 8000 (or answers /healthz) when the next one starts;
+// one that ignores SIGTERM for 5 s is killed, and after 10 s we give up
+inline std::string StopServerLines() {
+    return "pkill -f 'python broadcast.py' 2>/dev/null || true\n"
+           "waited=0\n"
+           "while pgrep -f 'python broadcast.py' >/dev/null 2>&1; do\n"
+           "  waited=$((waited + 1))\n"
+           "  [ $waited -eq 50 ] && { pkill -9 -f 'python broadcast.py' 2>/dev/null || true; }\n"
+           "  [ $waited -ge 100 ] && { echo \"old broadcast server did not exit\" >&2; exit 1; }\n"
+           "  sleep 0.1\n"
+           "done\n";
+}
+
+// Upload + dependencies + restart. The venv is rebuilt only when the package
+// list or the host's python3 version differs from the stamp left by the last
+// successful install; a failed pip is reported but not fatal, as before.
+inline std::string RemoteBringUpScript(const RemoteTarget& target, std::string_view serverScript,
+                                       const std::string& packages) {
+    std::string marker = "SPILL_" + HashHex(AssetHash(serverScript));
+    std::string script;
+    script.reserve(serverScript.size() + 1024);
+    script += "set -e\n";
+    script += "mkdir -p " + ShellQuote(target.dir) + "\ncd " + ShellQuote(target.dir) + "\n";
+    script += "cat > broadcast.py.tmp <<'" + marker + "'\n";
+    script.append(serverScript.data(), serverScript.size());
+    if (!serverScript.empty() && serverScript.back() != '\n') script += '\n';
+    script += marker + "\n";
+    script += "mv -f broadcast.py.tmp broadcast.py\n";
+    script += "deps=" + ShellQuote(packages) + "\" $(python3 -V 2>&1)\"\n";
+    script += "if [ \"$(cat clipenv/.spill-deps 2>/dev/null)\" != \"$deps\" ]; then\n"
+              "  echo \"Installing remote dependencies ($deps)...\"\n"
+              "  if python3 -m venv clipenv && clipenv/bin/pip install -q " + packages + "; then\n"
+              "    printf '%s\\n' \"$deps\" > clipenv/.spill-deps\n"
+              "  else\n"
+              "    echo \"warning: remote pip install failed, continuing anyway\"\n"
+              "  fi\n"
+              "fi\n";
+    script += StopServerLines();
+    script += "nohup clipenv/bin/python broadcast.py > broadcast.log 2>&1 < /dev/null &\n";
+    script += "echo \"Remote broadcast server launched (pid $!)\"\n";
+    return script;
+}
+
+inline std::string RemoteStopScript(const RemoteTarget& target) {
+    return "cd " + ShellQuote(target.dir) + " || exit 0\n" + StopServerLines() +
+           "rm -f broadcast.py broadcast.log spill.sock\n"
+           "echo \"Remote broadcast server stopped\"\n";
+}
+
+// Delays between readiness probes: `first` ms, doubling up to `cap`, until
+// `budget` ms have been spent waiting
+class Backoff {
+public:
+    explicit Backoff(int first = 50, int cap = 1000, int budget = 15000)
+        : next_(first), cap_(cap), left_(budget) {}
+
+    // Next delay in ms, or -1 once the budget is used up
+    int Next() {
+        if (left_ <= 0) return -1;
+        int delay = std::min(next_, left_);
+        left_ -= delay;
+        next_ = std::min(next_ * 2, cap_);
+        return delay;
+    }
+
+private:
+    int next_;
+    int cap_;
+    int left_;
+};
+
+// Calls probe() until it returns true, sleeping per `backoff` in between;
+// false if the budget ran out first
+template <typename Probe>
+bool WaitUntilReady(Probe probe, Backoff backoff, int* attempts = nullptr) {
+    int count = 0;
+    for (;;) {
+        count++;
+        if (probe()) break;
+        int delay = backoff.Next();
+        if (delay < 0) {
+            if (attempts) *attempts = count;
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+    }
+    if (attempts) *attempts = count;
+    return true;
+}
+
+enum class DeployStatus { Ok, RunnerFailed, TimedOut, SshFailed, RemoteFailed };
+
+inline const char* DeployStatusText(DeployStatus status) {
+    switch (status) {
+        case DeployStatus::Ok: return "ok";
+        case DeployStatus::RunnerFailed: return "could not run ssh";
+        case DeployStatus::TimedOut: return "timed out";
+        case DeployStatus::SshFailed: return "SSH connection failed";
+        default: return "remote setup failed";
+    }
+}
+
+class RemoteDeployer {
+public:
+    RemoteDeployer(CommandRunner& runner, RemoteTarget target)
+        : runner_(runner), target_(std::move(target)) {}
+
+    const RemoteTarget& Target() const { return target_; }
+    int ExitCode() const { return exitCode_; }
+
+    // One round trip: stage the script, check dependencies, (re)start
+    DeployStatus BringUp(std::string_view serverScript, const std::string& packages, int timeoutMs) {
+        return RunScript(RemoteBringUpScript(target_, serverScript, packages), timeoutMs);
+    }
+
+    DeployStatus Stop(int timeoutMs) { return RunScript(RemoteStopScript(target_), timeoutMs); }
+
+private:
+    DeployStatus RunScript(const std::string& script, int timeoutMs) {
+        exitCode_ = -1;
+        RunResult result = runner_.Run(SshScriptCommand(target_), script, timeoutMs, exitCode_);
+        if (result == RunResult::NotStarted) return DeployStatus::RunnerFailed;
+        if (result == RunResult::TimedOut) return DeployStatus::TimedOut;
+        if (exitCode_ == 255) return DeployStatus::SshFailed;  // ssh's own errors
+        return exitCode_ == 0 ? DeployStatus::Ok : DeployStatus::RemoteFailed;
+    }
+
+    CommandRunner& runner_;
+    RemoteTarget target_;
+    int exitCode_ = -1;
+};
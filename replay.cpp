@@ -0,0 +1,388 @@
+// Replays a request capture against a spill broadcast server (Linux).
+//
+// The server writes the capture when started with SPILL_CAPTURE=<file>. It
+// holds timing, users, sizes and content hashes but no clip content, so
+// bodies are rebuilt from a synthetic corpus: same sizes, and the same text
+// wherever the original clips were identical.
+//
+// Each user's requests go out in their original order over one connection.
+// At --speed=1 (or N) every request has an intended start taken from the
+// capture and latency is measured from it, like loadgen; --speed=max sends
+// as fast as the server answers and reports service time only.
+//
+//   replay --capture=capture.jsonl --url=http://localhost:8000 --speed=4
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "clip_json.h"
+#include "histogram.h"
+#include "http_client.h"
+
+struct CapturedRequest {
+    int64_t tUs = 0;
+    std::string method, path, user, hash;
+    std::string formats;  // raw JSON array, POST /<user> only
+    size_t bytes = 0;
+    size_t contentBytes = 0;
+    bool isClip = false;  // POST /<user> with content_bytes
+    long number = -1;     // broadcast number the server assigned
+    int status = 0;
+};
+
+struct Options {
+    std::string capture;
+    std::string url = "http://localhost:8000";
+    double speed = 1;     // 0 = as fast as possible
+    double maxGap = 0;    // seconds; longer idle stretches are cut to this
+    int connections = 0;  // 0 = min(users, 64)
+    bool allowClear = false;
+    bool json = false;
+    bool tls = false;  // https:// URL
+    HttpTlsOptions tlsOptions;
+};
+
+enum Kind { kPost, kPut, kGet, kOther, kKinds };
+static const char* kKindNames[kKinds] = { "POST", "PUT", "GET", "other" };
+
+struct Stats {
+    HdrHistogram latency[kKinds], service[kKinds];
+    uint64_t ok = 0, errors = 0, statusMismatches = 0, skipped = 0, bytesSent = 0, bytesReceived = 0;
+
+    void Merge(const Stats& other) {
+        for (int k = 0; k < kKinds; k++) {
+            latency[k].Merge(other.latency[k]);
+            service[k].Merge(other.service[k]);
+        }
+        ok += other.ok;
+        errors += other.errors;
+        statusMismatches += other.statusMismatches;
+        skipped += other.skipped;
+        bytesSent += other.bytesSent;
+        bytesReceived += other.bytesReceived;
+    }
+};
+
+static int64_t NowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void SleepUntil(int64_t ns) {
+    timespec ts = { (time_t)(ns / 1000000000), (long)(ns % 1000000000) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+}
+
+static bool LoadCapture(const std::string& path, std::vector<CapturedRequest>& requests, size_t& malformed) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        CapturedRequest r;
+        bool header = false;
+        bool ok = ParseJsonObject(&line[0], line.size(),
+            [&](std::string_view key, std::string_view value) {
+                if (key == "method") r.method = value;
+                else if (key == "path") r.path = value;
+                else if (key == "user") r.user = value;
+                else if (key == "hash") r.hash = value;
+                else if (key == "capture") header = true;
+            },
+            [&](std::string_view key, std::string_view value) {
+                std::string text(value);
+                if (key == "t_us") r.tUs = strtoll(text.c_str(), nullptr, 10);
+                else if (key == "bytes") r.bytes = strtoull(text.c_str(), nullptr, 10);
+                else if (key == "content_bytes") { r.contentBytes = strtoull(text.c_str(), nullptr, 10); r.isClip = true; }
+                else if (key == "status") r.status = atoi(text.c_str());
+                else if (key == "number" && text != "null") r.number = atol(text.c_str());
+                else if (key == "formats") r.formats = text;
+            });
+        if (header) continue;
+        if (!ok || r.method.empty() || r.path.empty() || r.path[0] != '/') {
+            malformed++;
+            continue;
+        }
+        requests.push_back(std::move(r));
+    }
+    // Requests are logged as they finish; replay them in arrival order
+    std::stable_sort(requests.begin(), requests.end(),
+                     [](const CapturedRequest& a, const CapturedRequest& b) { return a.tUs < b.tUs; });
+    return true;
+}
+
+// Offsets into the capture timeline, with idle stretches longer than maxGap cut
+static std::vector<int64_t> Timeline(const std::vector<CapturedRequest>& requests, double maxGap) {
+    std::vector<int64_t> offsets(requests.size());
+    int64_t cut = 0;
+    int64_t limit = (int64_t)(maxGap * 1e6);
+    for (size_t i = 0; i < requests.size(); i++) {
+        if (i && limit > 0) {
+            int64_t gap = requests[i].tUs - requests[i - 1].tUs;
+            if (gap > limit) cut += gap - limit;
+        }
+        offsets[i] = requests[i].tUs - requests[0].tUs - cut;
+    }
+    return offsets;
+}
+
+// Same hash, same text: identical clips in the capture stay identical
+static std::string_view Filler(const std::string& corpus, const std::string& hash, size_t size) {
+    size = std::min(size, corpus.size() / 2);
+    size_t offset = std::hash<std::string>()(hash) % (corpus.size() - size);
+    return std::string_view(corpus).substr(offset, size);
+}
+
+static std::string MakeCorpus(size_t size) {
+    static const char extra[] = "\"\\\n\t{}()<>;:=/";
+    std::mt19937_64 rng(1);
+    std::string corpus(size, ' ');
+    for (char& c : corpus) {
+        uint64_t r = rng();
+        c = (r % 8 == 0) ? extra[(r >> 8) % (sizeof(extra) - 1)] : (char)('a' + (r >> 16) % 26);
+    }
+    return corpus;
+}
+
+static long ResponseNumber(const std::string& body) {
+    size_t at = body.find("\"broadcast_number\":");
+    if (at == std::string::npos) return -1;
+    return strtol(body.c_str() + at + 19, nullptr, 10);
+}
+
+// "/<user>/clips/<n>/<fmt>" with n mapped to what the replay server assigned
+static std::string RemapClipPath(const CapturedRequest& r, const std::map<long, long>& numbers) {
+    std::string clips = "/" + r.user + "/clips/";
+    if (r.user.empty() || r.path.compare(0, clips.size(), clips) != 0) return r.path;
+    char* rest;
+    long number = strtol(r.path.c_str() + clips.size(), &rest, 10);
+    auto mapped = numbers.find(number);
+    if (mapped == numbers.end()) return r.path;
+    return clips + std::to_string(mapped->second) + rest;
+}
+
+static void RunWorker(const Options& opt, const std::vector<CapturedRequest>& requests,
+                      const std::vector<int64_t>& offsets, const std::vector<size_t>& mine,
+                      int64_t start, const std::string& host, const std::string& port,
+                      const std::string& prefix, const std::string& corpus, Stats& stats) {
+    HttpConnection connection(host, port);
+    if (opt.tls && !connection.UseTls(opt.tlsOptions)) {
+        fprintf(stderr, "replay: cannot set up TLS (built without HTTP_CLIENT_TLS, or a bad --cafile)\n");
+        stats.errors += mine.size();
+        return;
+    }
+    HttpResponse response;
+    std::string body;
+    std::map<std::string, std::map<long, long>> numbers;  // user -> captured -> replayed
+    char timestamp[32];
+
+    for (size_t index : mine) {
+        const CapturedRequest& r = requests[index];
+        if (r.path == "/clear-logs" && !opt.allowClear) {
+            stats.skipped++;
+            continue;
+        }
+
+        Kind kind = r.method == "POST" ? kPost : r.method == "PUT" ? kPut : r.method == "GET" ? kGet : kOther;
+        std::string path = prefix + RemapClipPath(r, numbers[r.user]);
+        const char* contentType = nullptr;
+        body.clear();
+        if (r.isClip) {
+            time_t wall = time(nullptr);
+            tm local;
+            strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", localtime_r(&wall, &local));
+            body += "{\"content\":";
+            AppendJsonString(body, Filler(corpus, r.hash, r.contentBytes));
+            body += ",\"timestamp\":";
+            AppendJsonString(body, timestamp);
+            body += ",\"user_id\":";
+            AppendJsonString(body, r.user);
+            if (!r.formats.empty()) {
+                body += ",\"formats\":";
+                body += r.formats;
+            }
+            body += '}';
+            contentType = "application/json";
+        } else if (r.bytes) {
+            body = Filler(corpus, r.hash, r.bytes);
+        }
+
+        int64_t intended = opt.speed > 0 ? start + (int64_t)(offsets[index] * 1000 / opt.speed) : NowNs();
+        SleepUntil(intended);
+        int64_t sent = NowNs();
+        bool ok = connection.Request(r.method.c_str(), path, body, contentType, response, r.isClip);
+        int64_t done = NowNs();
+
+        if (!ok) {
+            stats.errors++;
+            continue;
+        }
+        stats.ok++;
+        stats.bytesSent += body.size();
+        stats.bytesReceived += response.bodyBytes;
+        if (response.status != r.status) stats.statusMismatches++;
+        stats.latency[kind].Record((done - intended) / 1000);
+        stats.service[kind].Record((done - sent) / 1000);
+        if (r.isClip && r.number >= 0) {
+            long number = ResponseNumber(response.body);
+            if (number >= 0) numbers[r.user][r.number] = number;
+        }
+    }
+}
+
+static void PrintHistogram(const char* name, const HdrHistogram& h) {
+    printf("  %-22s n=%-8llu p50=%-8llu p90=%-8llu p99=%-8llu p99.9=%-8llu max=%llu\n", name,
+           (unsigned long long)h.Count(), (unsigned long long)h.Quantile(0.5),
+           (unsigned long long)h.Quantile(0.9), (unsigned long long)h.Quantile(0.99),
+           (unsigned long long)h.Quantile(0.999), (unsigned long long)h.Max());
+}
+
+static void JsonHistogram(const std::string& name, const HdrHistogram& h, bool last) {
+    printf("\"%s\":{\"count\":%llu,\"mean\":%.1f,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,"
+           "\"p999\":%llu,\"max\":%llu}%s", name.c_str(),
+           (unsigned long long)h.Count(), h.Mean(), (unsigned long long)h.Quantile(0.5),
+           (unsigned long long)h.Quantile(0.9), (unsigned long long)h.Quantile(0.99),
+           (unsigned long long)h.Quantile(0.999), (unsigned long long)h.Max(), last ? "" : ",");
+}
+
+static void Usage() {
+    fprintf(stderr,
+        "usage: replay --capture=FILE [options]\n"
+        "  --capture=FILE         capture written by the server (SPILL_CAPTURE=FILE)\n"
+        "  --url=URL              server base URL (default http://localhost:8000),\n"
+        "                         or unix:PATH for the server's Unix socket\n"
+        "  --speed=N|max          time scale: 1 = as captured, 4 = four times faster,\n"
+        "                         max = back-to-back (default 1)\n"
+        "  --max-gap=S            cut idle stretches longer than S seconds (default off)\n"
+        "  --connections=N        worker connections (default min(users, 64))\n"
+        "  --allow-clear          also replay POST /clear-logs (skipped by default)\n"
+        HTTP_TLS_USAGE
+        "  --json                 print one JSON summary line instead of text\n");
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        bool ok = true;
+        if (key == "--capture") opt.capture = value;
+        else if (key == "--url") opt.url = value;
+        else if (key == "--speed") { opt.speed = value == "max" ? 0 : atof(value.c_str()); ok = value == "max" || opt.speed > 0; }
+        else if (key == "--max-gap") opt.maxGap = atof(value.c_str());
+        else if (key == "--connections") opt.connections = atoi(value.c_str());
+        else if (key == "--allow-clear") opt.allowClear = true;
+        else if (ParseHttpTlsOption(key, value, opt.tlsOptions)) {}
+        else if (key == "--json") opt.json = true;
+        else if (key == "--help" || key == "-h") { Usage(); return 0; }
+        else ok = false;
+        if (!ok) {
+            fprintf(stderr, "replay: bad argument '%s'\n", arg.c_str());
+            Usage();
+            return 2;
+        }
+    }
+
+    std::string host, port, prefix;
+    if (opt.capture.empty()) {
+        Usage();
+        return 2;
+    }
+    if (!ParseHttpUrl(opt.url, host, port, prefix, &opt.tls)) {
+        fprintf(stderr, "replay: only http://, https:// and unix: URLs are supported: %s\n", opt.url.c_str());
+        return 2;
+    }
+
+    std::vector<CapturedRequest> requests;
+    size_t malformed = 0;
+    if (!LoadCapture(opt.capture, requests, malformed)) {
+        fprintf(stderr, "replay: cannot read %s\n", opt.capture.c_str());
+        return 2;
+    }
+    if (malformed) fprintf(stderr, "replay: skipped %zu malformed capture lines\n", malformed);
+    if (requests.empty()) {
+        fprintf(stderr, "replay: no requests in %s\n", opt.capture.c_str());
+        return 1;
+    }
+    std::vector<int64_t> offsets = Timeline(requests, opt.maxGap);
+
+    // Every user belongs to one worker so its requests keep their order
+    std::map<std::string, int> users;
+    for (const CapturedRequest& r : requests) users.emplace(r.user, (int)users.size());
+    int workers = opt.connections > 0 ? opt.connections : std::min<int>((int)users.size(), 64);
+    workers = std::max(1, std::min<int>(workers, (int)users.size()));
+    std::vector<std::vector<size_t>> assigned(workers);
+    for (size_t i = 0; i < requests.size(); i++) assigned[users[requests[i].user] % workers].push_back(i);
+
+    size_t largest = 4096;
+    for (const CapturedRequest& r : requests) largest = std::max({ largest, r.bytes, r.contentBytes });
+    std::string corpus = MakeCorpus(std::min<size_t>(largest, 64 << 20) * 2);
+
+    std::vector<Stats> stats(workers);
+    std::vector<std::thread> threads;
+    int64_t start = NowNs() + 50000000;  // let every worker get going first
+    for (int w = 0; w < workers; w++) {
+        threads.emplace_back(RunWorker, std::cref(opt), std::cref(requests), std::cref(offsets),
+                             std::cref(assigned[w]), start, std::cref(host), std::cref(port),
+                             std::cref(prefix), std::cref(corpus), std::ref(stats[w]));
+    }
+    for (std::thread& t : threads) t.join();
+    double elapsed = std::max(1e-9, (NowNs() - start) / 1e9);
+    double captured = offsets.back() / 1e6;
+
+    Stats total;
+    for (const Stats& s : stats) total.Merge(s);
+    double throughput = total.ok / elapsed;
+
+    if (opt.json) {
+        printf("{\"capture\":\"%s\",\"url\":\"%s\",\"speed\":%g,\"users\":%zu,\"connections\":%d,"
+               "\"captured_s\":%.3f,\"elapsed_s\":%.3f,\"requests\":%llu,\"errors\":%llu,"
+               "\"status_mismatches\":%llu,\"skipped\":%llu,\"throughput_rps\":%.1f,"
+               "\"bytes_sent\":%llu,\"bytes_received\":%llu,",
+               opt.capture.c_str(), opt.url.c_str(), opt.speed, users.size(), workers, captured, elapsed,
+               (unsigned long long)(total.ok + total.errors), (unsigned long long)total.errors,
+               (unsigned long long)total.statusMismatches, (unsigned long long)total.skipped, throughput,
+               (unsigned long long)total.bytesSent, (unsigned long long)total.bytesReceived);
+        for (int k = 0; k < kKinds; k++) {
+            std::string name = kKindNames[k];
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            if (opt.speed > 0) JsonHistogram(name + "_latency_us", total.latency[k], false);
+            JsonHistogram(name + "_service_us", total.service[k], k == kKinds - 1);
+        }
+        printf("}\n");
+    } else {
+        printf("replay: %zu requests from %zu users over %d connections\n", requests.size(), users.size(), workers);
+        printf("  %.1f s captured, %.1f s replayed", captured, elapsed);
+        if (opt.speed > 0) printf(" at %gx\n", opt.speed);
+        else printf(" at max speed\n");
+        printf("  requests %llu ok, %llu errors, %llu status mismatches, %llu skipped, %.1f req/s\n",
+               (unsigned long long)total.ok, (unsigned long long)total.errors,
+               (unsigned long long)total.statusMismatches, (unsigned long long)total.skipped, throughput);
+        if (opt.speed > 0) {
+            printf("latency in microseconds (from captured start time, scaled):\n");
+            for (int k = 0; k < kKinds; k++) {
+                if (total.latency[k].Count()) PrintHistogram(kKindNames[k], total.latency[k]);
+            }
+        }
+        printf("service time in microseconds (from actual send):\n");
+        for (int k = 0; k < kKinds; k++) {
+            if (total.service[k].Count()) PrintHistogram(kKindNames[k], total.service[k]);
+        }
+    }
+    return total.errors ? 1 : 0;
+}
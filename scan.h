@@ -0,0 +1,330 @@
+#pragma once
+
+// Multi-needle substring scan over clip text: "which of these clips mention
+// any of ...", without an index.
+//
+// A single needle is reduced to two of its bytes, the rarest ones by a
+// rough frequency table for clip text (memchr-pair), and a 16-byte block is
+// checked with two loads and two compares. Several needles go through Teddy
+// where the CPU has SSSE3: every needle owns a bit, the first three bytes of
+// all needles are folded into nibble tables, and six shuffles flag 16
+// positions for all of them at once, so up to eight needles cost about as
+// much as one. Only flagged positions are compared in full. That makes it a
+// prefilter for regexes too: scan for the literals a pattern requires, run
+// the pattern on hits.
+//
+// Matching can ignore case. ASCII letters and the Latin-1 letters
+// (U+00C0..U+00DE, two bytes in UTF-8) fold to lower case; other characters
+// match as they are. Needles and text are UTF-8, and a needle may not start
+// with a continuation byte, so a match never begins or ends inside a
+// character. Nothing here depends on Win32.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define SCAN_SSE2 1
+#endif
+
+#if SCAN_SSE2 && (defined(__GNUC__) || defined(__clang__))
+#define SCAN_SSSE3 1
+#endif
+
+namespace scan_detail {
+
+// Rough frequency of a byte in clip text (prose, code, paths); higher is
+// more common
+inline int ByteRank(unsigned char c) {
+    static const char lowerByFrequency[] = "etaoinsrhldcumfpgwybvkxjqz";
+    if (c == ' ') return 255;
+    if (c >= 'a' && c <= 'z') {
+        for (int i = 0; lowerByFrequency[i]; i++) {
+            if (lowerByFrequency[i] == c) return 250 - 4 * i;
+        }
+    }
+    if (c >= 'A' && c <= 'Z') return 120;
+    if (c >= '0' && c <= '9') return 150;
+    if (c == '\n' || c == '\t') return 170;
+    if (c < 0x20 || c == 0x7F) return 10;
+    if (c < 0x80) return 110;   // punctuation
+    if (c < 0xC0) return 130;   // continuation bytes, every non-ASCII character has some
+    if (c == 0xC3 || c == 0xE3 || c == 0xF0) return 120;  // Latin-1, CJK, emoji leads
+    return 60;
+}
+
+inline bool IsContinuation(unsigned char c) { return (c & 0xC0) == 0x80; }
+
+// Byte `c` in lower case, given the byte before it in the text; only ASCII
+// letters and the second byte of U+00C0..U+00DE (except U+00D7) change
+inline unsigned char FoldByte(unsigned char c, unsigned char prev) {
+    if (c >= 'A' && c <= 'Z') return c | 0x20;
+    if (prev == 0xC3 && c >= 0x80 && c <= 0x9E && c != 0x97) return c | 0x20;
+    return c;
+}
+
+// Whether the folded needle byte also matches text bytes that differ only
+// in bit 0x20, i.e. whether the block compare has to OR that bit in
+inline bool Foldable(unsigned char c, unsigned char prev) {
+    if (c >= 'a' && c <= 'z') return true;
+    return prev == 0xC3 && c >= 0xA0 && c <= 0xBE && c != 0xB7;
+}
+
+#if SCAN_SSSE3
+inline bool HasSsse3() {
+    static const bool ssse3 = __builtin_cpu_supports("ssse3");
+    return ssse3;
+}
+#endif
+
+}  // namespace scan_detail
+
+class MultiScanner {
+public:
+    static const size_t kMaxNeedles = 8;
+    static const size_t npos = (size_t)-1;
+
+    explicit MultiScanner(bool ignoreCase = false) : ignoreCase_(ignoreCase) {}
+
+    // False if the needle is empty, starts with a continuation byte, or
+    // there are already kMaxNeedles
+    bool Add(std::string_view needle) {
+        using namespace scan_detail;
+        if (needle.empty() || count_ == kMaxNeedles || IsContinuation((unsigned char)needle[0])) return false;
+        Needle& n = needles_[count_];
+        n.text.assign(needle.data(), needle.size());
+        if (ignoreCase_) {
+            unsigned char prev = 0;
+            for (char& c : n.text) {
+                unsigned char raw = (unsigned char)c;
+                c = (char)FoldByte(raw, prev);
+                prev = raw;
+            }
+        }
+        // The two rarest positions, preferring two different byte values
+        size_t first = 0;
+        for (size_t i = 1; i < n.text.size(); i++) {
+            if (Rank(n.text, i) < Rank(n.text, first)) first = i;
+        }
+        size_t second = first;
+        for (size_t i = 0; i < n.text.size(); i++) {
+            if (i == first) continue;
+            bool distinct = n.text[i] != n.text[first];
+            bool secondDistinct = second != first && n.text[second] != n.text[first];
+            if (second == first || distinct > secondDistinct ||
+                (distinct == secondDistinct && Rank(n.text, i) < Rank(n.text, second))) {
+                second = i;
+            }
+        }
+        n.offset1 = first;
+        n.offset2 = second;
+        n.byte1 = (unsigned char)n.text[first];
+        n.byte2 = (unsigned char)n.text[second];
+        n.fold1 = ignoreCase_ && Foldable(n.byte1, first ? (unsigned char)n.text[first - 1] : 0) ? 0x20 : 0;
+        n.fold2 = ignoreCase_ && Foldable(n.byte2, second ? (unsigned char)n.text[second - 1] : 0) ? 0x20 : 0;
+        if (first > maxOffset_) maxOffset_ = first;
+        if (second > maxOffset_) maxOffset_ = second;
+        count_++;
+        BuildTeddy();
+        return true;
+    }
+
+    size_t Count() const { return count_; }
+    bool IgnoreCase() const { return ignoreCase_; }
+
+    // onMatch(size_t offset, size_t needle) for every match, by offset (and
+    // by needle at one offset); overlapping matches are all reported. Stops
+    // early when onMatch returns false.
+    template <typename OnMatch>
+    void Scan(std::string_view text, OnMatch onMatch) const {
+        const unsigned char* s = (const unsigned char*)text.data();
+        size_t len = text.size();
+        size_t p = 0;
+        if (!count_) return;
+#if SCAN_SSSE3
+        if (count_ > 1 && scan_detail::HasSsse3()) {
+            bool stopped = false;
+            if (teddyBytes_ == 3) p = ScanTeddy<3>(s, len, onMatch, stopped);
+            else if (teddyBytes_ == 2) p = ScanTeddy<2>(s, len, onMatch, stopped);
+            else p = ScanTeddy<1>(s, len, onMatch, stopped);
+            if (stopped) return;
+        }
+#endif
+#if SCAN_SSE2
+        __m128i byte1[kMaxNeedles], byte2[kMaxNeedles], fold1[kMaxNeedles], fold2[kMaxNeedles];
+        for (size_t j = 0; j < count_; j++) {
+            byte1[j] = _mm_set1_epi8((char)needles_[j].byte1);
+            byte2[j] = _mm_set1_epi8((char)needles_[j].byte2);
+            fold1[j] = _mm_set1_epi8((char)needles_[j].fold1);
+            fold2[j] = _mm_set1_epi8((char)needles_[j].fold2);
+        }
+        // Every load of the block stays inside the text
+        if (count_ == 1) {
+            const Needle& n = needles_[0];
+            for (; p + maxOffset_ + 16 <= len; p += 16) {
+                __m128i a = _mm_or_si128(_mm_loadu_si128((const __m128i*)(s + p + n.offset1)), fold1[0]);
+                __m128i b = _mm_or_si128(_mm_loadu_si128((const __m128i*)(s + p + n.offset2)), fold2[0]);
+                unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, byte1[0]),
+                                                                          _mm_cmpeq_epi8(b, byte2[0])));
+                for (; mask; mask &= mask - 1) {
+                    int bit = __builtin_ctz(mask);
+                    if (Verify(s, len, p + bit, n) && !onMatch(p + bit, 0)) return;
+                }
+            }
+        }
+        for (; p + maxOffset_ + 16 <= len; p += 16) {
+            unsigned masks[kMaxNeedles];
+            unsigned any = 0;
+            for (size_t j = 0; j < count_; j++) {
+                const Needle& n = needles_[j];
+                __m128i a = _mm_or_si128(_mm_loadu_si128((const __m128i*)(s + p + n.offset1)), fold1[j]);
+                __m128i b = _mm_or_si128(_mm_loadu_si128((const __m128i*)(s + p + n.offset2)), fold2[j]);
+                masks[j] = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, byte1[j]),
+                                                                     _mm_cmpeq_epi8(b, byte2[j])));
+                any |= masks[j];
+            }
+            while (any) {
+                int bit = __builtin_ctz(any);
+                any &= any - 1;
+                for (size_t j = 0; j < count_; j++) {
+                    if ((masks[j] >> bit & 1) && Verify(s, len, p + bit, needles_[j]) && !onMatch(p + bit, j)) {
+                        return;
+                    }
+                }
+            }
+        }
+#endif
+        for (; p < len; p++) {
+            for (size_t j = 0; j < count_; j++) {
+                if (Verify(s, len, p, needles_[j]) && !onMatch(p, j)) return;
+            }
+        }
+    }
+
+    // Offset of the first match of any needle, npos if none; `needle` gets
+    // which one matched there
+    size_t Find(std::string_view text, size_t* needle = nullptr) const {
+        size_t found = npos;
+        Scan(text, [&](size_t offset, size_t which) {
+            found = offset;
+            if (needle) *needle = which;
+            return false;
+        });
+        return found;
+    }
+
+    bool Contains(std::string_view text) const { return Find(text) != npos; }
+
+private:
+    struct Needle {
+        std::string text;  // folded when ignoring case
+        size_t offset1 = 0, offset2 = 0;
+        unsigned char byte1 = 0, byte2 = 0;
+        unsigned char fold1 = 0, fold2 = 0;
+    };
+
+#if SCAN_SSSE3
+    // Teddy over whole blocks with the first `Bytes` bytes of each needle;
+    // returns where the caller picks up, and sets `stopped` if onMatch asked
+    // to stop
+    template <size_t Bytes, typename OnMatch>
+    __attribute__((target("ssse3")))
+    size_t ScanTeddy(const unsigned char* s, size_t len, OnMatch& onMatch, bool& stopped) const {
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i lo0 = _mm_loadu_si128((const __m128i*)teddyLo_[0]);
+        const __m128i hi0 = _mm_loadu_si128((const __m128i*)teddyHi_[0]);
+        const __m128i lo1 = _mm_loadu_si128((const __m128i*)teddyLo_[1]);
+        const __m128i hi1 = _mm_loadu_si128((const __m128i*)teddyHi_[1]);
+        const __m128i lo2 = _mm_loadu_si128((const __m128i*)teddyLo_[2]);
+        const __m128i hi2 = _mm_loadu_si128((const __m128i*)teddyHi_[2]);
+        // For each of the 16 bytes at `at`, the needles (bits) whose byte k it could be
+        auto lookup = [&](const unsigned char* at, __m128i lo, __m128i hi) __attribute__((target("ssse3"))) {
+            __m128i in = _mm_loadu_si128((const __m128i*)at);
+            __m128i low = _mm_and_si128(in, nibble);
+            __m128i high = _mm_and_si128(_mm_srli_epi16(in, 4), nibble);
+            return _mm_and_si128(_mm_shuffle_epi8(lo, low), _mm_shuffle_epi8(hi, high));
+        };
+        size_t p = 0;
+        for (; p + Bytes + 15 <= len; p += 16) {
+            __m128i hits = lookup(s + p, lo0, hi0);
+            if (Bytes > 1) hits = _mm_and_si128(hits, lookup(s + p + 1, lo1, hi1));
+            if (Bytes > 2) hits = _mm_and_si128(hits, lookup(s + p + 2, lo2, hi2));
+            unsigned any = ~(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(hits, zero)) & 0xFFFF;
+            if (!any) continue;
+            alignas(16) unsigned char buckets[16];
+            _mm_store_si128((__m128i*)buckets, hits);
+            while (any) {
+                int bit = __builtin_ctz(any);
+                any &= any - 1;
+                for (unsigned b = buckets[bit]; b; b &= b - 1) {
+                    size_t j = (size_t)__builtin_ctz(b);
+                    if (Verify(s, len, p + bit, needles_[j]) && !onMatch(p + bit, j)) {
+                        stopped = true;
+                        return p;
+                    }
+                }
+            }
+        }
+        return p;
+    }
+#endif
+
+    // Needle j owns bit j; a byte matches position k of a needle when both
+    // of its nibbles have the bit set. Ignoring case adds the upper-case
+    // byte too, which may let a few near misses through to Verify.
+    void BuildTeddy() {
+        teddyBytes_ = 3;
+        for (size_t j = 0; j < count_; j++) {
+            if (needles_[j].text.size() < teddyBytes_) teddyBytes_ = needles_[j].text.size();
+        }
+        memset(teddyLo_, 0, sizeof(teddyLo_));
+        memset(teddyHi_, 0, sizeof(teddyHi_));
+        for (size_t j = 0; j < count_; j++) {
+            const std::string& text = needles_[j].text;
+            for (size_t k = 0; k < teddyBytes_; k++) {
+                unsigned char c = (unsigned char)text[k];
+                unsigned char prev = k ? (unsigned char)text[k - 1] : 0;
+                unsigned char variants[2] = { c, c };
+                if (ignoreCase_ && scan_detail::Foldable(c, prev)) variants[1] = c & ~0x20;
+                for (unsigned char v : variants) {
+                    teddyLo_[k][v & 15] |= (unsigned char)(1 << j);
+                    teddyHi_[k][v >> 4] |= (unsigned char)(1 << j);
+                }
+            }
+        }
+    }
+
+    int Rank(const std::string& text, size_t i) const {
+        unsigned char c = (unsigned char)text[i];
+        int rank = scan_detail::ByteRank(c);
+        // Either case matches, so an ignored-case letter is as common as both
+        if (ignoreCase_ && c >= 'a' && c <= 'z') rank += scan_detail::ByteRank(c & ~0x20) / 4;
+        return rank;
+    }
+
+    bool Verify(const unsigned char* s, size_t len, size_t at, const Needle& n) const {
+        size_t size = n.text.size();
+        if (size > len - at) return false;
+        const unsigned char* t = s + at;
+        const unsigned char* w = (const unsigned char*)n.text.data();
+        if (!ignoreCase_) return memcmp(t, w, size) == 0;
+        unsigned char prev = 0;  // a needle never starts mid-character
+        for (size_t i = 0; i < size; i++) {
+            if (scan_detail::FoldByte(t[i], prev) != w[i]) return false;
+            prev = t[i];
+        }
+        return true;
+    }
+
+    bool ignoreCase_;
+    Needle needles_[kMaxNeedles];
+    size_t count_ = 0;
+    size_t maxOffset_ = 0;
+    size_t teddyBytes_ = 0;  // leading bytes of every needle in the tables, up to 3
+    unsigned char teddyLo_[3][16];
+    unsigned char teddyHi_[3][16];
+};
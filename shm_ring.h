@@ -0,0 +1,230 @@
+#pragma once
+
+// Shared-memory ring that hands clips from the client to the server when both
+// run on one machine (local mode), instead of a loopback HTTP request.
+//
+// The ring is one mapped region (a named file mapping on Windows, a file
+// under /dev/shm elsewhere) with a fixed layout, so the Python ends in
+// broadcast_embed.h and clipboard_embed.h address it by offset. A record is a
+// 32-bit length and the payload, padded to 8 bytes. Records never straddle
+// the end of the ring; the producer leaves a wrap marker and starts over at
+// offset 0, so the consumer always sees one contiguous span and parses it
+// where it lies. Positions only grow; offset = position & (capacity - 1).
+//
+// One producer and one consumer; producer threads in one process share it
+// behind a lock. A consumer that runs dry says so before it sleeps
+// (PrepareSleep), and the producer signals only then (WakeNeeded), so a busy
+// ring makes no system calls. The sleep itself (a named event, a futex on
+// SleepWord()) is up to the caller. Nothing here depends on Win32.
+//
+// Publishing is a release store of head after the record, paired with the
+// consumer's acquire load. The Python ends can't issue fences: they rely on
+// x86/x64 keeping stores (and loads) in program order, which is a hard
+// limit, so both refuse to set the ring up on any other CPU and clips go
+// over HTTP there. Native ends like this one are correct anywhere.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+namespace shm_ring_detail {
+
+const uint32_t kMagic = 0x47525053;  // "SPRG"
+const uint32_t kVersion = 1;
+const uint32_t kWrap = 0xFFFFFFFF;   // nothing more before the end of the ring
+
+inline size_t Align8(size_t n) { return (n + 7) & ~(size_t)7; }
+
+inline uint32_t Load32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+inline void Store32(unsigned char* p, uint32_t v) { memcpy(p, &v, 4); }
+
+}  // namespace shm_ring_detail
+
+// The offsets are the format shared with the Python scripts; the producer
+// and consumer fields sit on separate cache lines
+struct ShmRingHeader {
+    std::atomic<uint32_t> magic;     // 0: set last, once the rest is valid
+    uint32_t version;                // 4
+    uint64_t capacity;               // 8: data bytes, a power of two
+    char pad0[48];
+    std::atomic<uint64_t> head;      // 64: bytes published by the producer
+    std::atomic<uint64_t> refused;   // 72: records turned away (full or too large)
+    char pad1[48];
+    std::atomic<uint64_t> tail;      // 128: bytes released by the consumer
+    std::atomic<uint32_t> sleeping;  // 136: 1 while the consumer waits for a signal
+    char pad2[52];
+};
+
+static_assert(sizeof(ShmRingHeader) == 192, "ring header layout changed");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring needs lock-free 64-bit atomics");
+
+class ShmRing {
+public:
+    static const size_t kHeaderSize = sizeof(ShmRingHeader);
+
+    // Region size for at least `capacity` data bytes
+    static size_t RegionSize(size_t capacity) { return kHeaderSize + RoundUp(capacity); }
+
+    ShmRing() {}
+
+    // Formats `region` as an empty ring; the owner (the server) does this
+    // once before the producer attaches
+    static ShmRing Create(void* region, size_t regionSize) {
+        using namespace shm_ring_detail;
+        if (regionSize < kHeaderSize + 64) return ShmRing();
+        size_t capacity = 64;
+        while (capacity * 2 <= regionSize - kHeaderSize) capacity *= 2;
+        ShmRingHeader* header = new (region) ShmRingHeader();
+        header->magic.store(0, std::memory_order_relaxed);
+        header->version = kVersion;
+        header->capacity = capacity;
+        header->head.store(0, std::memory_order_relaxed);
+        header->refused.store(0, std::memory_order_relaxed);
+        header->tail.store(0, std::memory_order_relaxed);
+        header->sleeping.store(0, std::memory_order_relaxed);
+        header->magic.store(kMagic, std::memory_order_release);
+        return ShmRing(header);
+    }
+
+    // Joins a ring the owner has formatted; !Valid() if it hasn't (yet) or
+    // the region doesn't match
+    static ShmRing Attach(void* region, size_t regionSize) {
+        using namespace shm_ring_detail;
+        if (regionSize < kHeaderSize) return ShmRing();
+        ShmRingHeader* header = (ShmRingHeader*)region;
+        if (header->magic.load(std::memory_order_acquire) != kMagic || header->version != kVersion) {
+            return ShmRing();
+        }
+        uint64_t capacity = header->capacity;
+        if (capacity < 64 || (capacity & (capacity - 1)) || capacity > regionSize - kHeaderSize) {
+            return ShmRing();
+        }
+        return ShmRing(header);
+    }
+
+    bool Valid() const { return header_ != nullptr; }
+    size_t Capacity() const { return capacity_; }
+
+    // Largest payload that fits however the ring is positioned
+    size_t MaxRecord() const { return capacity_ / 2 - 4; }
+
+    uint64_t Refused() const { return header_->refused.load(std::memory_order_relaxed); }
+
+    // Bytes written but not yet released, wrap padding included
+    size_t Pending() const {
+        return (size_t)(header_->head.load(std::memory_order_acquire) -
+                        header_->tail.load(std::memory_order_acquire));
+    }
+
+    // Producer: copies one record in and publishes it; false (and counted)
+    // if it is too large or the ring is full, and the caller sends it some
+    // other way
+    bool TryWrite(const void* data, size_t len) {
+        using namespace shm_ring_detail;
+        if (len > MaxRecord()) return Refuse();
+        size_t need = Align8(4 + len);
+        uint64_t head = header_->head.load(std::memory_order_relaxed);
+        size_t offset = (size_t)(head & mask_);
+        size_t room = capacity_ - offset;  // contiguous, always >= 8
+        size_t skip = room < need ? room : 0;
+        if (head + skip + need - cachedTail_ > capacity_) {
+            cachedTail_ = header_->tail.load(std::memory_order_acquire);
+            if (head + skip + need - cachedTail_ > capacity_) return Refuse();
+        }
+        if (skip) {
+            Store32(data_ + offset, kWrap);
+            head += skip;
+            offset = 0;
+        }
+        Store32(data_ + offset, (uint32_t)len);
+        memcpy(data_ + offset + 4, data, len);
+        header_->head.store(head + need, std::memory_order_release);
+        return true;
+    }
+
+    // Producer, after writing: true if the consumer is asleep and has to be
+    // signalled. The flag is cleared here, so a futex wait on SleepWord()
+    // for the value 1 cannot miss the wake that follows.
+    bool WakeNeeded() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (header_->sleeping.load(std::memory_order_relaxed) == 0) return false;
+        return header_->sleeping.exchange(0, std::memory_order_relaxed) != 0;
+    }
+
+    // Consumer: onRecord(const char* data, size_t len) for up to `limit`
+    // records, pointing into the ring. Their space is released with one
+    // store after the last call, so the data stays put until then.
+    template <typename OnRecord>
+    size_t Drain(OnRecord onRecord, size_t limit = SIZE_MAX) {
+        using namespace shm_ring_detail;
+        uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+        uint64_t head = header_->head.load(std::memory_order_acquire);
+        size_t count = 0;
+        while (tail != head && count < limit) {
+            size_t offset = (size_t)(tail & mask_);
+            uint32_t len = Load32(data_ + offset);
+            if (len == kWrap) {
+                tail += capacity_ - offset;
+                continue;
+            }
+            if (len > MaxRecord()) {
+                tail = head;  // not something a producer wrote; drop the lot
+                break;
+            }
+            onRecord((const char*)data_ + offset + 4, (size_t)len);
+            tail += Align8(4 + len);
+            count++;
+        }
+        header_->tail.store(tail, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer, when Drain found nothing: false if a record arrived in the
+    // meantime (drain again); otherwise wait for the producer's signal and
+    // call EndSleep()
+    bool PrepareSleep() {
+        header_->sleeping.store(1, std::memory_order_seq_cst);
+        if (header_->head.load(std::memory_order_seq_cst) != header_->tail.load(std::memory_order_relaxed)) {
+            header_->sleeping.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    void EndSleep() { header_->sleeping.store(0, std::memory_order_relaxed); }
+
+    // For a futex-style wait: 1 while the consumer sleeps
+    std::atomic<uint32_t>* SleepWord() { return &header_->sleeping; }
+
+private:
+    explicit ShmRing(ShmRingHeader* header)
+        : header_(header),
+          data_((unsigned char*)header + kHeaderSize),
+          capacity_((size_t)header->capacity),
+          mask_(capacity_ - 1) {}
+
+    static size_t RoundUp(size_t capacity) {
+        size_t size = 64;
+        while (size < capacity) size <<= 1;
+        return size;
+    }
+
+    bool Refuse() {
+        header_->refused.store(header_->refused.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
+        return false;
+    }
+
+    ShmRingHeader* header_ = nullptr;
+    unsigned char* data_ = nullptr;
+    size_t capacity_ = 0;
+    size_t mask_ = 0;
+    uint64_t cachedTail_ = 0;  // producer's view of tail
+};
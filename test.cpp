@@ -0,0 +1,1620 @@
+// Correctness tests for the portable core (Linux).
+//
+//   test                  run everything; exits 1 if any check failed
+//   test --filter=utf     only tests whose name contains "utf"
+//   test --seed=N         seed for the randomized tests (default 1)
+//   test --rounds=N       iterations of each randomized test (default 2000)
+//   test --python=PATH    interpreter for the server/* checks, one with flask
+//                         installed (default python3; without flask they skip)
+//
+// Randomized tests compare the optimized code against a plain reference
+// written from the spec, over inputs built to reach the SIMD paths and
+// their edges. A failure prints the seed, so it can be rerun alone.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <linux/futex.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "broadcast_embed.h"
+#include "clip_crypto.h"
+#include "http_client.h"
+#include "log_channel.h"
+#include "log_model.h"
+#include "posix_runner.h"
+#include "remote_deploy.h"
+#include "scan.h"
+#include "shm_ring.h"
+#include "transcode.h"
+
+#ifdef TEST_LIBCRYPTO
+#include <openssl/evp.h>
+#endif
+
+// --- Harness --------------------------------------------------------------
+
+struct Test {
+    std::string name;
+    std::function<void()> run;
+};
+
+static std::vector<Test>& Registry() {
+    static std::vector<Test> tests;
+    return tests;
+}
+
+static void Register(std::string name, std::function<void()> run) {
+    Registry().push_back({ std::move(name), std::move(run) });
+}
+
+static uint32_t g_seed = 1;
+static int g_rounds = 2000;
+static int g_failures;  // checks failed in the current test
+static bool g_skipped;  // the current test couldn't run here
+static std::string g_python = "python3";
+
+static bool Check(bool ok, const char* expr, const char* file, int line, const std::string& detail = "") {
+    if (!ok) {
+        if (g_failures++ < 10)
+            fprintf(stderr, "  %s:%d: CHECK(%s) failed%s%s\n", file, line, expr,
+                    detail.empty() ? "" : ": ", detail.c_str());
+    }
+    return ok;
+}
+
+#define CHECK(expr) Check((expr), #expr, __FILE__, __LINE__)
+#define CHECK_MSG(expr, detail) Check((expr), #expr, __FILE__, __LINE__, (detail))
+
+static std::string Hex(const void* data, size_t len) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < len && i < 64; i++) {
+        uint8_t b = ((const uint8_t*)data)[i];
+        if (i) out += ' ';
+        out += digits[b >> 4];
+        out += digits[b & 15];
+    }
+    if (len > 64) out += " ...";
+    return out;
+}
+
+static std::string Hex(const std::string& s) { return Hex(s.data(), s.size()); }
+
+// --- Transcoding ----------------------------------------------------------
+//
+// The reference decoder follows the Unicode standard's table of
+// well-formed UTF-8 byte sequences (3-7) directly and replaces each maximal
+// subpart of an ill-formed sequence with one U+FFFD, which is what
+// transcode.h promises.
+
+static void RefAppendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else {
+        out += (char)(0xF0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3F));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+static void RefAppendUtf16(std::u16string& out, uint32_t cp) {
+    if (cp < 0x10000) {
+        out += (char16_t)cp;
+    } else {
+        out += (char16_t)(0xD800 + ((cp - 0x10000) >> 10));
+        out += (char16_t)(0xDC00 + ((cp - 0x10000) & 0x3FF));
+    }
+}
+
+static std::u16string RefUtf8ToUtf16(const std::string& text, bool& valid) {
+    const uint8_t* s = (const uint8_t*)text.data();
+    size_t len = text.size(), i = 0;
+    std::u16string out;
+    valid = true;
+    while (i < len) {
+        uint8_t b = s[i];
+        if (b < 0x80) {
+            out += (char16_t)b;
+            i++;
+            continue;
+        }
+        // Length and range of the second byte, per lead byte
+        int need = 0;
+        uint8_t lo = 0x80, hi = 0xBF;
+        if (b >= 0xC2 && b <= 0xDF) need = 1;
+        else if (b == 0xE0) { need = 2; lo = 0xA0; }
+        else if (b == 0xED) { need = 2; hi = 0x9F; }
+        else if (b >= 0xE1 && b <= 0xEF) need = 2;
+        else if (b == 0xF0) { need = 3; lo = 0x90; }
+        else if (b == 0xF4) { need = 3; hi = 0x8F; }
+        else if (b >= 0xF1 && b <= 0xF3) need = 3;
+        uint32_t cp = need == 1 ? b & 0x1F : need == 2 ? b & 0x0F : b & 0x07;
+        int got = 0;
+        while (got < need && i + 1 + got < len) {
+            uint8_t c = s[i + 1 + got];
+            if (got == 0 ? (c < lo || c > hi) : (c & 0xC0) != 0x80) break;
+            cp = (cp << 6) | (c & 0x3F);
+            got++;
+        }
+        if (need && got == need) {
+            RefAppendUtf16(out, cp);
+        } else {
+            out += (char16_t)0xFFFD;
+            valid = false;
+        }
+        i += 1 + got;
+    }
+    return out;
+}
+
+static std::string RefUtf16ToUtf8(const std::u16string& text, bool& valid) {
+    std::string out;
+    valid = true;
+    for (size_t i = 0; i < text.size(); i++) {
+        uint32_t u = text[i];
+        if (u >= 0xD800 && u <= 0xDBFF && i + 1 < text.size() && text[i + 1] >= 0xDC00 && text[i + 1] <= 0xDFFF) {
+            RefAppendUtf8(out, 0x10000 + ((u - 0xD800) << 10) + (text[++i] - 0xDC00));
+        } else if (u >= 0xD800 && u <= 0xDFFF) {
+            RefAppendUtf8(out, 0xFFFD);
+            valid = false;
+        } else {
+            RefAppendUtf8(out, u);
+        }
+    }
+    return out;
+}
+
+// Random scalar values, weighted towards long ASCII runs so the SSE2 / AVX2
+// blocks are entered and left at every alignment
+static uint32_t RandomScalar(std::mt19937& rng) {
+    switch (rng() % 8) {
+    case 0: return 0x80 + rng() % (0x800 - 0x80);
+    case 1: {
+        uint32_t cp = 0x800 + rng() % (0x10000 - 0x800);
+        return cp >= 0xD800 && cp <= 0xDFFF ? cp - 0x800 : cp;
+    }
+    case 2: return 0x10000 + rng() % (0x110000 - 0x10000);
+    case 3: return rng() % 2 ? 0x10FFFF : 0xFFFF;  // edges of the ranges
+    default: return rng() % 0x80;
+    }
+}
+
+static std::vector<uint32_t> RandomScalars(std::mt19937& rng) {
+    std::vector<uint32_t> cps;
+    size_t count = rng() % 200;
+    while (cps.size() < count) {
+        if (rng() % 4 == 0) {
+            size_t run = rng() % 70;  // crosses 16- and 32-byte blocks
+            for (size_t k = 0; k < run; k++) cps.push_back(' ' + rng() % 95);
+        } else {
+            cps.push_back(RandomScalar(rng));
+        }
+    }
+    return cps;
+}
+
+// Checks both directions of Utf8ToUtf16 / Utf16ToUtf8 and the validators
+// against the reference for one input of each kind
+static void CheckUtf8(const std::string& text, uint32_t seed) {
+    bool refValid, valid = true;
+    std::u16string expected = RefUtf8ToUtf16(text, refValid);
+    std::u16string got = Utf8ToUtf16(text, &valid);
+    std::string where = "seed " + std::to_string(seed) + ", input " + Hex(text);
+    CHECK_MSG(got == expected, where);
+    CHECK_MSG(valid == refValid, where);
+    CHECK_MSG(ValidateUtf8(text.data(), text.size()) == refValid, where);
+}
+
+static void CheckUtf16(const std::u16string& text, uint32_t seed) {
+    bool refValid, valid = true;
+    std::string expected = RefUtf16ToUtf8(text, refValid);
+    std::string got = Utf16ToUtf8(text, &valid);
+    std::string where = "seed " + std::to_string(seed) + ", input " + Hex(text.data(), text.size() * 2);
+    CHECK_MSG(got == expected, where);
+    CHECK_MSG(valid == refValid, where);
+    CHECK_MSG(ValidateUtf16(text.data(), text.size()) == refValid, where);
+}
+
+static void TestUtfRoundTrip() {
+    for (int round = 0; round < g_rounds; round++) {
+        uint32_t seed = g_seed + round;
+        std::mt19937 rng(seed);
+        std::string utf8;
+        std::u16string utf16;
+        for (uint32_t cp : RandomScalars(rng)) {
+            RefAppendUtf8(utf8, cp);
+            RefAppendUtf16(utf16, cp);
+        }
+        bool valid = false;
+        std::string where = "seed " + std::to_string(seed);
+        CHECK_MSG(Utf8ToUtf16(utf8, &valid) == utf16 && valid, where);
+        CHECK_MSG(Utf16ToUtf8(utf16, &valid) == utf8 && valid, where);
+        CHECK_MSG(ValidateUtf8(utf8.data(), utf8.size()), where);
+        CHECK_MSG(ValidateUtf16(utf16.data(), utf16.size()), where);
+    }
+}
+
+// Ill-formed UTF-8 named by kind, each also checked after ASCII runs that
+// end just before, on and after a SIMD block boundary
+static void TestUtf8Invalid() {
+    const std::vector<std::string> cases = {
+        "\xC0\x80", "\xC1\xBF",                  // overlong 2-byte
+        "\xE0\x80\x80", "\xE0\x9F\xBF",          // overlong 3-byte
+        "\xF0\x80\x80\x80", "\xF0\x8F\xBF\xBF",  // overlong 4-byte
+        "\xED\xA0\x80", "\xED\xBF\xBF",          // surrogates encoded as UTF-8
+        "\xED\xA0\x80\xED\xB0\x80",              // a surrogate pair (CESU-8)
+        "\xF4\x90\x80\x80", "\xF7\xBF\xBF\xBF",  // above U+10FFFF
+        "\xF5\x80\x80\x80", "\xF8\x88\x80\x80\x80", "\xFC\x84\x80\x80\x80\x80", "\xFE", "\xFF",
+        "\xC3", "\xE2\x82", "\xF0\x9F\x98",      // truncated at the end
+        "\xC3" "a", "\xE2\x82" "a", "\xF0\x9F\x98" "a",  // truncated before ASCII
+        "\xE2\x82\xC3\xA9",                      // truncated before another sequence
+        "\x80", "\xBF\x80\x80",                  // stray continuation bytes
+    };
+    for (const std::string& bad : cases) {
+        for (size_t prefix : { 0, 1, 15, 16, 17, 31, 32, 33, 63 }) {
+            std::string text = std::string(prefix, 'x') + bad + std::string(prefix % 7, 'y');
+            bool valid = true;
+            Utf8ToUtf16(text, &valid);
+            CHECK_MSG(!valid, Hex(text));
+            CheckUtf8(text, 0);
+        }
+    }
+}
+
+// Valid text with bytes replaced, inserted or cut, against the reference
+static void TestUtf8Fuzz() {
+    static const uint8_t kInteresting[] = { 0x80, 0xBF, 0xC0, 0xC1, 0xC2, 0xDF, 0xE0, 0xED, 0xEF,
+                                            0xF0, 0xF4, 0xF5, 0xFF, 0x9F, 0xA0, 0x8F, 0x90 };
+    for (int round = 0; round < g_rounds; round++) {
+        uint32_t seed = g_seed + round;
+        std::mt19937 rng(seed);
+        std::string text;
+        for (uint32_t cp : RandomScalars(rng)) RefAppendUtf8(text, cp);
+        int edits = 1 + rng() % 4;
+        for (int e = 0; e < edits; e++) {
+            size_t at = text.empty() ? 0 : rng() % (text.size() + 1);
+            uint8_t b = rng() % 2 ? kInteresting[rng() % sizeof kInteresting] : (uint8_t)rng();
+            switch (rng() % 3) {
+            case 0: if (at < text.size()) text[at] = (char)b; break;
+            case 1: text.insert(text.begin() + at, (char)b); break;
+            default: text = text.substr(0, at); break;  // truncate, often mid-sequence
+            }
+        }
+        CheckUtf8(text, seed);
+    }
+}
+
+static void TestUtf16Fuzz() {
+    for (int round = 0; round < g_rounds; round++) {
+        uint32_t seed = g_seed + round;
+        std::mt19937 rng(seed);
+        std::u16string text;
+        for (uint32_t cp : RandomScalars(rng)) RefAppendUtf16(text, cp);
+        int edits = 1 + rng() % 3;
+        for (int e = 0; e < edits; e++) {
+            size_t at = text.empty() ? 0 : rng() % (text.size() + 1);
+            // Lone high / low surrogates, a reversed pair, or a cut pair
+            char16_t unit = rng() % 2 ? 0xD800 + rng() % 0x400 : 0xDC00 + rng() % 0x400;
+            switch (rng() % 3) {
+            case 0: text.insert(text.begin() + at, unit); break;
+            case 1: text.insert(at, std::u16string{ (char16_t)(0xDC00 + rng() % 0x400),
+                                                    (char16_t)(0xD800 + rng() % 0x400) }); break;
+            default: text = text.substr(0, at); break;
+            }
+        }
+        CheckUtf16(text, seed);
+    }
+    // Lone surrogates at block boundaries and at the very end
+    for (size_t prefix : { 0, 15, 16, 31, 32 }) {
+        for (char16_t unit : { (char16_t)0xD800, (char16_t)0xDBFF, (char16_t)0xDC00, (char16_t)0xDFFF }) {
+            std::u16string text = std::u16string(prefix, u'x') + unit;
+            CheckUtf16(text, 0);
+            CheckUtf16(text + u'y', 0);
+        }
+    }
+}
+
+// --- Multi-needle scan ----------------------------------------------------
+//
+// MultiScanner (scan.h) against a matcher that tries every needle at every
+// offset. Text and needles are drawn from a handful of characters, each in
+// both cases where it has them, so matches are frequent, Latin-1 pairs sit
+// across block edges, and the folding rule is exercised both ways (U+00D7 and
+// U+0100 look foldable but are not).
+
+using Match = std::pair<size_t, size_t>;  // offset, needle
+
+// Lower case as the scanner defines it, from the spec rather than scan.h
+static unsigned char RefFold(unsigned char c, unsigned char prev) {
+    if (c >= 'A' && c <= 'Z') return c + 0x20;
+    if (prev == 0xC3 && c >= 0x80 && c <= 0x9E && c != 0x97) return c + 0x20;
+    return c;
+}
+
+static std::vector<Match> RefScan(const std::vector<std::string>& needles, bool ignoreCase,
+                                  const std::string& text) {
+    std::vector<Match> matches;
+    for (size_t at = 0; at < text.size(); at++) {
+        for (size_t j = 0; j < needles.size(); j++) {
+            const std::string& n = needles[j];
+            if (n.size() > text.size() - at) continue;
+            bool same = true;
+            for (size_t i = 0; i < n.size() && same; i++) {
+                unsigned char t = text[at + i], w = n[i];
+                if (ignoreCase) {
+                    t = RefFold(t, i ? (unsigned char)text[at + i - 1] : 0);
+                    w = RefFold(w, i ? (unsigned char)n[i - 1] : 0);
+                }
+                same = t == w;
+            }
+            if (same) matches.emplace_back(at, j);
+        }
+    }
+    return matches;
+}
+
+// Characters as { lower, upper }; the same string twice where there is no other case
+static const char* const kScanChars[][2] = {
+    { "a", "A" }, { "e", "E" }, { "z", "Z" }, { " ", " " }, { "0", "0" },
+    { "\xC3\xA9", "\xC3\x89" },  // é É
+    { "\xC3\xA0", "\xC3\x80" },  // à À
+    { "\xC3\xBE", "\xC3\x9E" },  // þ Þ
+    { "\xC3\xB7", "\xC3\x97" },  // ÷ ×, not a case pair
+    { "\xC4\x81", "\xC4\x80" },  // ā Ā, folds only outside Latin-1
+    { "\xE3\x81\x82", "\xE3\x81\x82" },
+};
+
+// `chars` rendered with each character in a random case
+static std::string RenderScanChars(const std::vector<size_t>& chars, std::mt19937& rng) {
+    std::string text;
+    for (size_t c : chars) text += kScanChars[c][rng() % 2];
+    return text;
+}
+
+static std::vector<size_t> RandomScanChars(std::mt19937& rng, size_t most) {
+    std::vector<size_t> chars(rng() % (most + 1));
+    for (size_t& c : chars) c = rng() % (sizeof kScanChars / sizeof kScanChars[0]);
+    return chars;
+}
+
+// One random round: `count` needles, a text with some of them planted
+// (the last one within its final 15 bytes), every entry point compared
+static void CheckScanRound(uint32_t seed, size_t count, bool ignoreCase) {
+    std::mt19937 rng(seed);
+    std::vector<std::vector<size_t>> shapes;
+    std::vector<std::string> needles;
+    MultiScanner scanner(ignoreCase);
+    while (needles.size() < count) {
+        std::vector<size_t> shape = RandomScanChars(rng, 5);
+        if (shape.empty()) continue;
+        shapes.push_back(shape);
+        needles.push_back(RenderScanChars(shape, rng));
+        CHECK(scanner.Add(needles.back()));
+    }
+    std::string text;
+    for (int piece = rng() % 6; piece >= 0; piece--) {
+        text += RenderScanChars(RandomScanChars(rng, 24), rng);
+        text += RenderScanChars(shapes[rng() % count], rng);
+    }
+    std::string tail = RenderScanChars(RandomScanChars(rng, 4), rng);
+    if (tail.size() < 15) text += tail;
+
+    std::vector<Match> want = RefScan(needles, ignoreCase, text);
+    std::vector<Match> got;
+    scanner.Scan(text, [&](size_t offset, size_t needle) {
+        got.emplace_back(offset, needle);
+        return true;
+    });
+    std::string where = "seed " + std::to_string(seed) + " text " + Hex(text);
+    CHECK_MSG(got == want, where);
+
+    size_t needle = MultiScanner::npos;
+    size_t first = scanner.Find(text, &needle);
+    CHECK_MSG(first == (want.empty() ? MultiScanner::npos : want[0].first), where);
+    if (!want.empty()) CHECK_MSG(needle == want[0].second, where);
+    CHECK_MSG(scanner.Contains(text) == !want.empty(), where);
+
+    // Stopping after k matches reports exactly the first k
+    if (!want.empty()) {
+        size_t k = 1 + rng() % want.size();
+        std::vector<Match> prefix;
+        scanner.Scan(text, [&](size_t offset, size_t which) {
+            prefix.emplace_back(offset, which);
+            return prefix.size() < k;
+        });
+        CHECK_MSG(prefix == std::vector<Match>(want.begin(), want.begin() + k), where);
+    }
+}
+
+// One needle takes the memchr-pair path, several take Teddy
+static void TestScanFuzz() {
+    for (int round = 0; round < g_rounds; round++) {
+        uint32_t seed = g_seed + round;
+        size_t count = round % 2 ? 1 : 2 + seed % (MultiScanner::kMaxNeedles - 1);
+        CheckScanRound(seed, count, round % 4 >= 2);
+    }
+}
+
+// Matches in each of the last 15 bytes, past the last whole block
+static void TestScanTail() {
+    for (bool ignoreCase : { false, true }) {
+        for (size_t count : { (size_t)1, (size_t)3 }) {
+            MultiScanner scanner(ignoreCase);
+            std::vector<std::string> needles = { "\xC3\xA9t\xC3\xA9", "zz", "0a" };
+            for (size_t j = 0; j < count; j++) CHECK(scanner.Add(needles[j]));
+            needles.resize(count);
+            for (size_t len = 16; len < 64; len++) {
+                for (size_t at = len - 15; at + 5 <= len; at++) {
+                    std::string text(len, '.');
+                    text.replace(at, 5, ignoreCase ? "\xC3\x89T\xC3\x89" : "\xC3\xA9t\xC3\xA9");
+                    std::vector<Match> got;
+                    scanner.Scan(text, [&](size_t offset, size_t needle) {
+                        got.emplace_back(offset, needle);
+                        return true;
+                    });
+                    CHECK_MSG(got == RefScan(needles, ignoreCase, text), Hex(text));
+                    CHECK_MSG(got.size() == 1 && got[0] == Match(at, 0), Hex(text));
+                }
+            }
+        }
+    }
+}
+
+static void TestScanFolding() {
+    MultiScanner scanner(true);
+    CHECK(scanner.Add("\xC3\xA9t\xC3\xA9"));    // été
+    CHECK(scanner.Add("\xC3\x97"));            // ×
+    CHECK(scanner.Add("\xC4\x81"));            // ā
+    CHECK(scanner.Find("L'\xC3\x89T\xC3\x89") == 2);
+    CHECK(!scanner.Contains("\xC3\xB7"));      // ÷ is not a lower-case ×
+    CHECK(!scanner.Contains("\xC4\x80"));      // Ā is outside Latin-1
+    size_t needle = 0;
+    CHECK(scanner.Find("2 \xC3\x97 3", &needle) == 2 && needle == 1);
+
+    MultiScanner exact;
+    CHECK(exact.Add("\xC3\xA9"));
+    CHECK(!exact.Contains("\xC3\x89"));
+}
+
+static void TestScanAdd() {
+    MultiScanner scanner;
+    CHECK(!scanner.Add(""));
+    CHECK(!scanner.Add("\xA9t\xC3\xA9"));  // starts inside a character
+    for (size_t j = 0; j < MultiScanner::kMaxNeedles; j++) CHECK(scanner.Add(std::string(1, 'a' + j)));
+    CHECK(!scanner.Add("i"));
+    CHECK(scanner.Count() == MultiScanner::kMaxNeedles);
+    CHECK(scanner.Find("xyzh") == 3);
+    CHECK(MultiScanner().Find("abc") == MultiScanner::npos);
+}
+
+// --- Log channel ----------------------------------------------------------
+
+// Lines a splitter produces from `chunks` fed in order, then flushed
+static std::vector<std::string> Split(const std::vector<std::string>& chunks, size_t maxLine = 64 * 1024) {
+    LineSplitter splitter(maxLine);
+    std::vector<std::string> lines;
+    auto onLine = [&](char* line, size_t len) { lines.emplace_back(line, len); };
+    for (std::string chunk : chunks) splitter.Feed(&chunk[0], chunk.size(), onLine);
+    splitter.Flush(onLine);
+    return lines;
+}
+
+using Lines = std::vector<std::string>;
+
+static void TestSplitterCarriageReturn() {
+    CHECK(Split({ "a\rb\n" }) == Lines{ "b" });
+    CHECK(Split({ "progress 10%\rprogress 100%\r\n" }) == Lines{ "progress 100%" });
+    CHECK(Split({ "windows line\r\n", "next\r\n" }) == (Lines{ "windows line", "next" }));
+    CHECK(Split({ "\r\n", "\r\r\n", "\n", "\n" }).empty());  // empty lines are dropped
+    CHECK(Split({ "50%\r", "100%\r", "\n" }) == Lines{ "100%" });  // \r split across feeds
+    CHECK(Split({ "done\rtail" }) == Lines{ "tail" });  // unterminated, flushed at the end
+}
+
+static void TestSplitterPartialLines() {
+    CHECK(Split({ "hel", "lo\nwor", "ld\n" }) == (Lines{ "hello", "world" }));
+    CHECK(Split({ "no newline" }) == Lines{ "no newline" });
+    // Any chunking of a stream gives the lines of feeding it whole
+    std::string stream;
+    std::mt19937 rng(g_seed);
+    const char* pieces[] = { "{\"level\":\"info\",\"msg\":\"x\"}", "pip output", "\r", "\n", "\r\n", "é" };
+    for (int i = 0; i < 400; i++) stream += pieces[rng() % 6];
+    Lines whole = Split({ stream });
+    for (int round = 0; round < g_rounds / 10; round++) {
+        std::vector<std::string> chunks;
+        for (size_t at = 0; at < stream.size();) {
+            size_t n = 1 + rng() % 40;
+            chunks.push_back(stream.substr(at, n));
+            at += n;
+        }
+        CHECK_MSG(Split(chunks) == whole, "seed " + std::to_string(g_seed) + ", round " + std::to_string(round));
+    }
+}
+
+static void TestSplitterMaxLine() {
+    // A line without '\n' is emitted once maxLine bytes are pending, so a
+    // child that never ends its line can't grow the buffer without bound
+    CHECK(Split({ "0123", "4567", "89\n" }, 8) == (Lines{ "01234567", "89" }));
+    CHECK(Split({ "0123456789abc" }, 8) == Lines{ "0123456789abc" });
+    // The limit applies to what is pending; a chunk that ends the line is
+    // appended whole
+    CHECK(Split({ "short\n", "0123456", "7tail\n" }, 8) == (Lines{ "short", "01234567tail" }));
+}
+
+static LogRecord Parse(std::string line) {
+    LogRecord record;
+    record.message = "stale";
+    record.event = "stale";
+    ParseLogLine(&line[0], line.size(), "child", record);
+    return record;
+}
+
+static void TestParseLogLine() {
+    LogRecord r = Parse(R"({"level":"WARNING","source":"server","msg":"two\nlines é","event":"ready","ts":1712.5})");
+    CHECK(r.level == LogLevel::Warning);
+    CHECK(r.source == "server");
+    CHECK(r.message == "two\nlines \xc3\xa9");
+    CHECK(r.event == "ready");
+    CHECK(r.timestamp == 1712.5);
+
+    r = Parse(R"({"level":"critical","message":"alt key"})");
+    CHECK(r.level == LogLevel::Error && r.message == "alt key" && r.source == "child" && r.event.empty());
+    CHECK(Parse(R"({"level":"debug","msg":""})").level == LogLevel::Debug);
+    CHECK(Parse(R"({"msg":"no level"})").level == LogLevel::Info);
+}
+
+static void TestParseLogLineFallback() {
+    // Anything that isn't one of our records is an info line from the child
+    for (std::string text : { std::string("Collecting flask==3.0"), std::string("Traceback (most recent call last):"),
+                              std::string("{not json"), std::string("{\"level\":\"error\"}"),
+                              std::string("{\"msg\":\"unterminated}"), std::string("{}") }) {
+        LogRecord r = Parse(text);
+        CHECK_MSG(r.level == LogLevel::Info && r.source == "child" && r.event.empty() && r.timestamp == 0, text);
+        CHECK_MSG(!r.message.empty() && r.message.size() <= text.size(), text);
+    }
+    CHECK(Parse("Collecting flask==3.0").message == "Collecting flask==3.0");
+    CHECK(Parse("{\"level\":\"error\"}").message == "{\"level\":\"error\"}");
+}
+
+static void TestSpscRingWrap() {
+    SpscRing<int> ring(5);
+    CHECK(ring.Capacity() == 8);
+    int next = 0, expect = 0;
+    std::mt19937 rng(g_seed);
+    // Indices run far past the capacity, so slots are reused many times
+    for (int round = 0; round < 10000; round++) {
+        int pushes = rng() % 10;
+        for (int i = 0; i < pushes; i++) {
+            int value = next;
+            if (ring.TryPush(std::move(value))) next++;
+        }
+        CHECK(next - expect <= 8);
+        ring.Drain([&](int& v) { CHECK(v == expect); expect++; }, rng() % 6);
+    }
+    ring.Drain([&](int& v) { CHECK(v == expect); expect++; });
+    CHECK(expect == next);
+    int v;
+    CHECK(!ring.TryPop(v));
+}
+
+static void TestSpscRingFull() {
+    SpscRing<std::string> ring(4);
+    for (int i = 0; i < 4; i++) {
+        std::string s = "item" + std::to_string(i);
+        CHECK(ring.TryPush(std::move(s)));
+    }
+    std::string refused = "refused";
+    CHECK(!ring.TryPush(std::move(refused)));
+    CHECK(refused == "refused");  // left untouched
+    std::string out;
+    CHECK(ring.TryPop(out) && out == "item0");
+    std::string again = "item4";
+    CHECK(ring.TryPush(std::move(again)));
+    std::vector<std::string> rest;
+    ring.Drain([&](std::string& item) { rest.push_back(item); });
+    CHECK(rest == (std::vector<std::string>{ "item1", "item2", "item3", "item4" }));
+}
+
+static void TestSpscRingThreads() {
+    SpscRing<uint32_t> ring(64);
+    const uint32_t count = 200000;
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < count;) {
+            uint32_t value = i;
+            if (ring.TryPush(std::move(value))) i++;
+            else std::this_thread::yield();
+        }
+    });
+    uint32_t expect = 0;
+    bool inOrder = true;
+    while (expect < count) {
+        if (!ring.Drain([&](uint32_t& v) { inOrder &= v == expect++; })) std::this_thread::yield();
+    }
+    producer.join();
+    CHECK(inOrder);
+}
+
+static void TestLogChannelDrops() {
+    LogChannel channel(4);
+    for (int i = 0; i < 7; i++) {
+        std::string line = "line " + std::to_string(i);
+        channel.Push(&line[0], line.size(), "server");
+    }
+    CHECK(channel.TakeDropped() == 3);
+    CHECK(channel.TakeDropped() == 0);
+    std::vector<std::string> got;
+    CHECK(channel.Drain([&](LogRecord& r) { got.push_back(r.message); }, 3) == 3);
+    std::string line = "line 7";
+    channel.Push(&line[0], line.size(), "server");
+    channel.Drain([&](LogRecord& r) { got.push_back(r.message); });
+    CHECK(got == (std::vector<std::string>{ "line 0", "line 1", "line 2", "line 3", "line 7" }));
+    CHECK(channel.TakeDropped() == 0);
+}
+
+// --- Log scrollback --------------------------------------------------------
+//
+// The GUI keeps LogScrollback<wchar_t>, which is UTF-16 on Windows; here
+// char16_t stands in for it (wchar_t is 32 bits on Linux).
+
+template <typename CharT>
+static std::vector<std::basic_string<CharT>> Rows(const LogScrollback<CharT>& log) {
+    std::vector<std::basic_string<CharT>> rows;
+    for (uint64_t row = log.FirstRow(); row < log.EndRow(); row++) rows.push_back(log.Row(row));
+    return rows;
+}
+
+static void TestScrollbackEviction() {
+    const size_t rowCost = sizeof(std::string) + 10;
+    LogScrollback<char> log(10 * rowCost);
+    char row[16];
+    for (int i = 0; i < 100; i++) {
+        snprintf(row, sizeof(row), "row %06d", i);
+        log.Append(row);
+        CHECK(log.Bytes() <= 10 * rowCost);
+        CHECK(log.EndRow() == (uint64_t)i + 1);
+    }
+    CHECK(log.Size() == 10 && log.FirstRow() == 90 && log.EndRow() == 100);
+    CHECK(log.Row(90) == "row 000090" && log.Row(99) == "row 000099");
+
+    // Several rows at once evict as many; the numbers keep counting
+    log.Append("a\nb\nc");
+    CHECK(log.FirstRow() == 93 && log.EndRow() == 103);
+    CHECK(log.Row(100) == "a" && log.Row(102) == "c" && log.Row(93) == "row 000093");
+
+    log.Clear();
+    CHECK(log.Size() == 0 && log.Bytes() == 0);
+    CHECK(log.FirstRow() == 103 && log.EndRow() == 103);
+    log.Append("after");
+    CHECK(log.FirstRow() == 103 && log.EndRow() == 104 && log.Row(103) == "after");
+
+    // A row over the whole budget still shows, alone
+    log.Append(std::string(20 * rowCost, 'x'));
+    CHECK(log.Size() == 1 && log.FirstRow() == 104 && log.Row(104).size() == 20 * rowCost);
+    log.Append("next");
+    CHECK(log.Size() == 1 && log.Row(105) == "next");
+}
+
+static void TestScrollbackWrap() {
+    LogScrollback<char> log(1 << 20, 10);
+    log.Append("alpha beta gamma delta");
+    CHECK(Rows(log) == (std::vector<std::string>{ "alpha beta", "gamma", "delta" }));
+    log.Clear();
+    log.Append("abcdefghijklmnopqrstuvwxy");  // no space: hard cuts
+    CHECK(Rows(log) == (std::vector<std::string>{ "abcdefghij", "klmnopqrst", "uvwxy" }));
+    log.Clear();
+    log.Append("ab cdefghijklmno");  // a space in the first half is not worth it
+    CHECK(Rows(log) == (std::vector<std::string>{ "ab cdefghi", "jklmno" }));
+    log.Clear();
+    log.Append("exactly 10");
+    CHECK(Rows(log) == (std::vector<std::string>{ "exactly 10" }));
+    log.SetColumns(0);
+    log.Append(std::string(50, 'z'));
+    CHECK(log.Size() == 2 && log.Row(log.EndRow() - 1).size() == 50);
+}
+
+static void TestScrollbackCodePoints() {
+    LogScrollback<char> utf8(1 << 20, 4);
+    utf8.Append("abc\xC3\xA9" "def");
+    CHECK(Rows(utf8) == (std::vector<std::string>{ "abc", "\xC3\xA9" "de", "f" }));
+
+    // Random text without spaces at every width: rows join back to the
+    // line and each is whole code points
+    std::mt19937 rng(g_seed);
+    static const uint32_t points[] = { 'a', 'Z', 0xE9, 0x3B1, 0x65E5, 0xFF5E, 0x1F642, 0x10FFFD };
+    for (int round = 0; round < g_rounds / 4; round++) {
+        std::string line8;
+        std::u16string line16;
+        for (int n = rng() % 40; n > 0; n--) {
+            uint32_t cp = points[rng() % 8];
+            RefAppendUtf8(line8, cp);
+            RefAppendUtf16(line16, cp);
+        }
+        size_t columns = 1 + rng() % 12;
+        LogScrollback<char> log8(1 << 20, columns);
+        LogScrollback<char16_t> log16(1 << 20, columns);
+        log8.Append(line8);
+        log16.Append(line16);
+        std::string joined8;
+        for (const std::string& row : Rows(log8)) {
+            bool valid;
+            RefUtf8ToUtf16(row, valid);
+            CHECK_MSG(valid, Hex(row) + ", " + std::to_string(columns) + " columns");
+            joined8 += row;
+        }
+        CHECK(joined8 == line8);
+        std::u16string joined16;
+        for (const std::u16string& row : Rows(log16)) {
+            CHECK(row.empty() || (row.back() & 0xFC00) != 0xD800);
+            CHECK(row.empty() || (row.front() & 0xFC00) != 0xDC00);
+            CHECK(row.size() <= std::max<size_t>(columns, 2));
+            joined16 += row;
+        }
+        CHECK(joined16 == line16);
+    }
+}
+
+static void TestScrollbackLineEnds() {
+    LogScrollback<char16_t> log;
+    log.Append(u"one\r\ntwo\r");
+    CHECK(Rows(log) == (std::vector<std::u16string>{ u"one", u"two" }));
+    log.Append(u"a\rb\n\r\nlast\n");
+    CHECK(Rows(log) == (std::vector<std::u16string>{ u"one", u"two", u"a\rb", u"", u"last", u"" }));
+}
+
+// --- Remote bring-up ------------------------------------------------------
+//
+// The bring-up script runs for real through PosixRunner's local shell (the
+// stand-in for ssh), in a scratch directory, with python3 and pkill
+// replaced by stubs on PATH: the stub venv's pip logs its arguments and
+// fails while a pip.fail file exists, and its python only notes it started
+// (and whether an old server was still up). pgrep reports an old server
+// for as many polls as old.server says.
+
+static std::string ReadFile(const std::string& path) {
+    std::string out;
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return out;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.append(buf, n);
+    fclose(f);
+    return out;
+}
+
+static bool WriteFile(const std::string& path, const std::string& text, bool executable = false) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok &= fclose(f) == 0;
+    return ok && (!executable || chmod(path.c_str(), 0755) == 0);
+}
+
+static bool FileExists(const std::string& path) { return access(path.c_str(), F_OK) == 0; }
+
+// A directory under /tmp, removed with everything in it on scope exit
+class ScratchDir {
+public:
+    ScratchDir() {
+        char tmpl[] = "/tmp/spill-test-XXXXXX";
+        dir = mkdtemp(tmpl) ? tmpl : "";
+    }
+    ~ScratchDir() {
+        if (!dir.empty()) system(("rm -rf " + ShellQuote(dir)).c_str());
+    }
+
+    std::string dir;
+};
+
+// A scratch directory with the stubs first on PATH; both undone on scope exit
+class StubHost : public ScratchDir {
+public:
+    StubHost() {
+        std::string stubs = dir + "/stubs";
+        mkdir(stubs.c_str(), 0755);
+        WriteFile(stubs + "/python3",
+                  "#!/bin/sh\n"
+                  "case \"$1\" in\n"
+                  "  -V) echo 'Python 3.99.0' ;;\n"
+                  "  -m) mkdir -p clipenv/bin\n"
+                  "      printf '#!/bin/sh\\necho \"$*\" >> pip.calls\\n[ ! -e pip.fail ]\\n' > clipenv/bin/pip\n"
+                  "      printf '#!/bin/sh\\necho \"$*\" > started\\n[ ! -e old.server ] || echo old >> started\\n' > clipenv/bin/python\n"
+                  "      chmod +x clipenv/bin/pip clipenv/bin/python ;;\n"
+                  "esac\n", true);
+        WriteFile(stubs + "/pkill", "#!/bin/sh\nexit 1\n", true);
+        WriteFile(stubs + "/pgrep",
+                  "#!/bin/sh\n"
+                  "echo \"$*\" >> pgrep.calls\n"
+                  "n=$(cat old.server 2>/dev/null) || exit 1\n"
+                  "[ \"$n\" -gt 0 ] || { rm -f old.server; exit 1; }\n"
+                  "echo $((n - 1)) > old.server\n", true);
+        const char* path = getenv("PATH");
+        savedPath_ = path ? path : "/usr/bin:/bin";
+        setenv("PATH", (stubs + ":" + savedPath_).c_str(), 1);
+    }
+    ~StubHost() { setenv("PATH", savedPath_.c_str(), 1); }
+
+private:
+    std::string savedPath_;
+};
+
+// Records what it was asked to run, then hands it to `inner` or, without
+// one, answers with a fixed result
+class RecordingRunner : public CommandRunner {
+public:
+    explicit RecordingRunner(CommandRunner* inner, RunResult result = RunResult::Finished, int exitCode = 0)
+        : inner_(inner), result_(result), exitCode_(exitCode) {}
+
+    RunResult Run(const std::string& command, std::string_view input, int timeoutMs, int& exitCode) override {
+        commands.push_back(command);
+        inputs.emplace_back(input);
+        if (inner_) return inner_->Run(command, input, timeoutMs, exitCode);
+        exitCode = exitCode_;
+        return result_;
+    }
+
+    std::vector<std::string> commands;
+    std::vector<std::string> inputs;
+
+private:
+    CommandRunner* inner_;
+    RunResult result_;
+    int exitCode_;
+};
+
+static size_t CountLines(const std::string& text) { return std::count(text.begin(), text.end(), '\n'); }
+
+static void TestRemoteBringUp() {
+    StubHost host;
+    PosixRunner shell(true);
+    RecordingRunner runner(&shell);
+    RemoteTarget target;
+    target.host = "example.org";
+    target.dir = host.dir + "/it's remote";
+    target.controlPath = "/tmp/spill-%C";
+    RemoteDeployer deployer(runner, target);
+    // Quotes, $ and backticks must reach the file as written, and a line
+    // that looks like a heredoc end must not end it
+    std::string script = "print('it\\'s $HOME `id`')\nEOF\nSPILL\n\n# no trailing newline";
+    std::string dir = target.dir + "/";
+
+    CHECK(deployer.BringUp(script, "flask requests", 10000) == DeployStatus::Ok);
+    CHECK(runner.commands.size() == 1);  // staging, venv and restart in one round trip
+    CHECK(!runner.commands.empty() && runner.commands[0] == SshScriptCommand(target));
+    CHECK(SshScriptCommand(target).find("ControlPath=/tmp/spill-%C") != std::string::npos);
+    CHECK_MSG(ReadFile(dir + "broadcast.py") == script + "\n", ReadFile(dir + "broadcast.py"));
+    CHECK(ReadFile(dir + "pip.calls") == "install -q flask requests\n");
+    CHECK(ReadFile(dir + "clipenv/.spill-deps") == "flask requests Python 3.99.0\n");
+    CHECK(WaitUntilReady([&] { return ReadFile(dir + "started") == "broadcast.py\n"; }, Backoff(10, 100, 5000)));
+
+    // The stamp matches, so the next bring-up skips pip; a new package list doesn't
+    CHECK(deployer.BringUp(script, "flask requests", 10000) == DeployStatus::Ok);
+    CHECK(CountLines(ReadFile(dir + "pip.calls")) == 1);
+    CHECK(deployer.BringUp(script, "flask", 10000) == DeployStatus::Ok);
+    CHECK(ReadFile(dir + "pip.calls") == "install -q flask requests\ninstall -q flask\n");
+    CHECK(runner.commands.size() == 3);
+
+    // An old server that takes a while to exit is waited for, so the new
+    // one doesn't find port 8000 taken while the old one answers /healthz
+    unlink((dir + "started").c_str());
+    unlink((dir + "pgrep.calls").c_str());
+    WriteFile(dir + "old.server", "3");
+    CHECK(deployer.BringUp(script, "flask", 10000) == DeployStatus::Ok);
+    CHECK(CountLines(ReadFile(dir + "pgrep.calls")) == 4);
+    CHECK(WaitUntilReady([&] { return FileExists(dir + "started"); }, Backoff(10, 100, 5000)));
+    CHECK_MSG(ReadFile(dir + "started") == "broadcast.py\n", ReadFile(dir + "started"));
+
+    CHECK(deployer.Stop(10000) == DeployStatus::Ok);
+    CHECK(!FileExists(dir + "broadcast.py") && !FileExists(dir + "broadcast.log"));
+}
+
+static void TestRemoteFailedStep() {
+    StubHost host;
+    PosixRunner shell(true);
+    RemoteTarget target;
+    target.host = "example.org";
+    target.dir = host.dir + "/remote";
+    std::string dir = target.dir + "/";
+    RemoteDeployer deployer(shell, target);
+
+    // A failed pip is reported but not fatal; without a stamp the next run retries it
+    mkdir(target.dir.c_str(), 0755);
+    WriteFile(dir + "pip.fail", "");
+    CHECK(deployer.BringUp("print(1)\n", "flask", 10000) == DeployStatus::Ok);
+    CHECK(FileExists(dir + "broadcast.py"));
+    CHECK(!FileExists(dir + "clipenv/.spill-deps"));
+    unlink((dir + "pip.fail").c_str());
+    CHECK(deployer.BringUp("print(1)\n", "flask", 10000) == DeployStatus::Ok);
+    CHECK(FileExists(dir + "clipenv/.spill-deps"));
+    CHECK(CountLines(ReadFile(dir + "pip.calls")) == 2);
+
+    // Any other failing step ends the script (set -e): here the directory
+    // can't be made because a file is in the way
+    WriteFile(host.dir + "/file", "");
+    RemoteTarget blocked = target;
+    blocked.dir = host.dir + "/file/remote";
+    RemoteDeployer broken(shell, blocked);
+    CHECK(broken.BringUp("print(1)\n", "flask", 10000) == DeployStatus::RemoteFailed);
+    CHECK(broken.ExitCode() != 0 && broken.ExitCode() != 255);
+
+    // What the runner reports maps to its own status
+    RecordingRunner notStarted(nullptr, RunResult::NotStarted);
+    CHECK(RemoteDeployer(notStarted, target).BringUp("", "flask", 1000) == DeployStatus::RunnerFailed);
+    RecordingRunner sshDown(nullptr, RunResult::Finished, 255);
+    CHECK(RemoteDeployer(sshDown, target).BringUp("", "flask", 1000) == DeployStatus::SshFailed);
+    RecordingRunner hung(nullptr, RunResult::TimedOut);
+    CHECK(RemoteDeployer(hung, target).Stop(1000) == DeployStatus::TimedOut);
+
+    // and a command that hangs is killed at the deadline
+    int exitCode = -1;
+    auto start = std::chrono::steady_clock::now();
+    CHECK(shell.Run("", "exec sleep 5\n", 100, exitCode) == RunResult::TimedOut);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+}
+
+// Answers GET /healthz on a loopback port like a server that is starting:
+// the first `refuse` connections are closed unanswered, later ones get
+// `status`
+class FakeHealthz {
+public:
+    FakeHealthz(int refuse, int status) : refuse_(refuse), status_(status) {
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        bind(fd_, (sockaddr*)&addr, sizeof(addr));
+        listen(fd_, 16);
+        getsockname(fd_, (sockaddr*)&addr, &len);
+        port = std::to_string(ntohs(addr.sin_port));
+        thread_ = std::thread([this] { Serve(); });
+    }
+    ~FakeHealthz() {
+        stop_ = true;
+        shutdown(fd_, SHUT_RDWR);  // wakes accept()
+        thread_.join();
+        close(fd_);
+    }
+
+    std::string port;
+    std::atomic<int> connections{0};
+
+private:
+    void Serve() {
+        for (;;) {
+            int client = accept(fd_, nullptr, nullptr);
+            if (client < 0) {
+                if (stop_) return;
+                continue;
+            }
+            if (++connections > refuse_) {
+                std::string request;
+                char buf[1024];
+                ssize_t n;
+                while (request.find("\r\n\r\n") == std::string::npos && (n = recv(client, buf, sizeof(buf), 0)) > 0)
+                    request.append(buf, n);
+                std::string reply = "HTTP/1.1 " + std::to_string(status_) +
+                                    " X\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+                send(client, reply.data(), reply.size(), MSG_NOSIGNAL);
+            }
+            close(client);
+        }
+    }
+
+    int fd_;
+    int refuse_;
+    int status_;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+// The probe deploy uses
+static bool ProbeHealthz(HttpConnection& connection) {
+    HttpResponse response;
+    bool up = connection.Request("GET", "/healthz", "", nullptr, response) && response.status == 200;
+    if (!up) connection.Close();
+    return up;
+}
+
+static void TestHealthzReady() {
+    FakeHealthz server(3, 200);
+    HttpConnection connection("127.0.0.1", server.port);
+    int attempts = 0;
+    CHECK(WaitUntilReady([&] { return ProbeHealthz(connection); }, Backoff(10, 100, 5000), &attempts));
+    CHECK_MSG(attempts == 4, std::to_string(attempts));
+    CHECK(server.connections == 4);
+}
+
+static void TestHealthzTimeout() {
+    Backoff backoff(10, 40, 200);
+    std::vector<int> delays;
+    for (int d; (d = backoff.Next()) >= 0;) delays.push_back(d);
+    CHECK(delays == (std::vector<int>{ 10, 20, 40, 40, 40, 40, 10 }));
+
+    // A server that answers, but never 200, is polled until the budget is spent
+    FakeHealthz server(0, 503);
+    HttpConnection connection("127.0.0.1", server.port);
+    int attempts = 0;
+    auto start = std::chrono::steady_clock::now();
+    CHECK(!WaitUntilReady([&] { return ProbeHealthz(connection); }, Backoff(10, 40, 200), &attempts));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    CHECK_MSG(attempts == 8, std::to_string(attempts));
+    CHECK(elapsed >= std::chrono::milliseconds(200) && elapsed < std::chrono::seconds(2));
+}
+
+// --- Shared-memory ring ---------------------------------------------------
+//
+// The consumer formats the region and the producer attaches to it, each
+// with its own ShmRing, as the server and client do. Payloads carry their
+// sequence number so order and content can be checked together.
+
+static std::string RingPayload(uint32_t seq, size_t len) {
+    std::string s(len, '\0');
+    for (size_t i = 0; i < len; i++) s[i] = (char)(seq * 31 + i);
+    if (len >= 4) memcpy(&s[0], &seq, 4);
+    return s;
+}
+
+struct RingPair {
+    explicit RingPair(size_t capacity) : region(ShmRing::RegionSize(capacity) / 8) {
+        consumer = ShmRing::Create(region.data(), region.size() * 8);
+        producer = ShmRing::Attach(region.data(), region.size() * 8);
+    }
+    std::vector<uint64_t> region;  // 8-byte aligned
+    ShmRing consumer;
+    ShmRing producer;
+};
+
+static void TestShmRingAttach() {
+    std::vector<uint64_t> region(ShmRing::RegionSize(256) / 8);
+    size_t size = region.size() * 8;
+    CHECK(!ShmRing::Attach(region.data(), size).Valid());  // not formatted yet
+    ShmRing owner = ShmRing::Create(region.data(), size);
+    CHECK(owner.Valid() && owner.Capacity() == 256 && owner.MaxRecord() == 124);
+    CHECK(ShmRing::Attach(region.data(), size).Capacity() == 256);
+    CHECK(!ShmRing::Attach(region.data(), size - 1).Valid());  // smaller than the ring
+    ((ShmRingHeader*)region.data())->version = 2;
+    CHECK(!ShmRing::Attach(region.data(), size).Valid());
+}
+
+static void TestShmRingWrap() {
+    RingPair ring(64);
+    auto drain = [&](std::vector<std::string>& out) {
+        return ring.consumer.Drain([&](const char* data, size_t len) { out.emplace_back(data, len); });
+    };
+    std::vector<std::string> got;
+    // 32 + 24 bytes leave exactly one 8-byte record's room before the end
+    CHECK(ring.producer.TryWrite(RingPayload(0, 28).data(), 28));
+    CHECK(ring.producer.TryWrite(RingPayload(0, 20).data(), 20));
+    CHECK(drain(got) == 2);
+    CHECK(ring.producer.TryWrite("abcd", 4));
+    CHECK(ring.consumer.Pending() == 8);  // fits at the end, no wrap marker
+    // At offset 0 again: 20 bytes
+    CHECK(ring.producer.TryWrite(RingPayload(1, 20).data(), 20));
+    CHECK(ring.consumer.Pending() == 32);
+    CHECK(drain(got) == 2);
+    // Now at offset 24: 28 bytes take 32 and fit; 20 more don't before the
+    // end, so the 8 bytes left become a wrap marker
+    CHECK(ring.producer.TryWrite(RingPayload(2, 28).data(), 28));
+    CHECK(ring.producer.TryWrite(RingPayload(3, 20).data(), 20));
+    CHECK(ring.consumer.Pending() == 32 + 8 + 24);
+    CHECK(drain(got) == 2);
+    CHECK(got == (std::vector<std::string>{ RingPayload(0, 28), RingPayload(0, 20), "abcd", RingPayload(1, 20),
+                                            RingPayload(2, 28), RingPayload(3, 20) }));
+    CHECK(ring.consumer.Pending() == 0);
+
+    // Random sizes, many times around a small ring
+    RingPair big(256);
+    std::mt19937 rng(g_seed);
+    uint32_t written = 0, read = 0;
+    bool ok = true;
+    for (int round = 0; round < g_rounds * 10; round++) {
+        for (int n = rng() % 4; n > 0; n--) {
+            size_t len = rng() % (big.producer.MaxRecord() + 1);
+            std::string payload = RingPayload(written, len);
+            if (big.producer.TryWrite(payload.data(), len)) written++;
+        }
+        big.consumer.Drain([&](const char* data, size_t len) {
+            ok &= std::string(data, len) == RingPayload(read, len);
+            read++;
+        }, rng() % 3);
+    }
+    big.consumer.Drain([&](const char* data, size_t len) {
+        ok &= std::string(data, len) == RingPayload(read, len);
+        read++;
+    });
+    CHECK(ok);
+    CHECK_MSG(read == written && written > 1000u, std::to_string(read) + " of " + std::to_string(written));
+}
+
+static void TestShmRingFull() {
+    RingPair ring(64);
+    std::string payload = RingPayload(0, 12);
+    CHECK(!ring.producer.TryWrite(payload.data(), ring.producer.MaxRecord() + 1));  // too large ever
+    CHECK(ring.consumer.Refused() == 1);
+    for (int i = 0; i < 4; i++) CHECK(ring.producer.TryWrite(payload.data(), 12));  // 4 x 16 bytes
+    CHECK(!ring.producer.TryWrite(payload.data(), 12));
+    CHECK(!ring.producer.TryWrite("", 0));  // even an empty record takes 8
+    CHECK(ring.consumer.Refused() == 3);
+    CHECK(ring.consumer.Pending() == 64);
+    // Freeing one record makes room for one more, through the producer's stale view of tail
+    CHECK(ring.consumer.Drain([](const char*, size_t) {}, 1) == 1);
+    CHECK(ring.producer.TryWrite(payload.data(), 12));
+    CHECK(!ring.producer.TryWrite(payload.data(), 12));
+    std::vector<std::string> got;
+    auto keep = [&](const char* data, size_t len) { got.emplace_back(data, len); };
+    CHECK(ring.consumer.Drain(keep) == 4);
+
+    // Free space only counts where a record can go whole: at offset 48,
+    // 20 bytes (24) need the 16 before the end skipped too, so with 32
+    // free they are refused, and with 48 free they go in at offset 0
+    RingPair wrap(64);
+    for (int i = 0; i < 3; i++) CHECK(wrap.producer.TryWrite(payload.data(), 12));
+    CHECK(wrap.consumer.Drain([](const char*, size_t) {}, 1) == 1);
+    CHECK(!wrap.producer.TryWrite(RingPayload(1, 20).data(), 20));
+    CHECK(wrap.consumer.Refused() == 1);
+    CHECK(wrap.consumer.Drain([](const char*, size_t) {}, 1) == 1);
+    CHECK(wrap.producer.TryWrite(RingPayload(1, 20).data(), 20));
+    CHECK(wrap.consumer.Pending() == 16 + 16 + 24);
+    got.clear();
+    CHECK(wrap.consumer.Drain(keep) == 2);
+    CHECK(got == (std::vector<std::string>{ payload, RingPayload(1, 20) }));
+
+    // A length no producer writes drops what is queued instead of reading past it
+    CHECK(wrap.producer.TryWrite(payload.data(), 12));  // at offset 24
+    CHECK(wrap.producer.TryWrite(payload.data(), 12));
+    uint32_t bogus = 1000;
+    memcpy((char*)wrap.region.data() + ShmRing::kHeaderSize + 24, &bogus, 4);
+    CHECK(wrap.consumer.Drain(keep) == 0);
+    CHECK(wrap.consumer.Pending() == 0);
+}
+
+static bool FutexWaitFor(std::atomic<uint32_t>* word, uint32_t value, int ms) {
+    timespec timeout = { ms / 1000, (ms % 1000) * 1000000L };
+    return syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, value, &timeout, nullptr, 0) == 0 || errno != ETIMEDOUT;
+}
+
+static void FutexWake(std::atomic<uint32_t>* word) {
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+static void TestShmRingWake() {
+    RingPair ring(256);
+    // A consumer that isn't asleep is never signalled
+    CHECK(!ring.producer.WakeNeeded());
+    // Going to sleep on an empty ring raises the flag; the producer takes it down once
+    CHECK(ring.consumer.PrepareSleep());
+    CHECK(ring.consumer.SleepWord()->load() == 1);
+    CHECK(ring.producer.TryWrite("x", 1));
+    CHECK(ring.producer.WakeNeeded());
+    CHECK(!ring.producer.WakeNeeded());
+    CHECK(ring.consumer.SleepWord()->load() == 0);
+    ring.consumer.EndSleep();
+    // With a record already there, the consumer doesn't sleep at all
+    CHECK(!ring.consumer.PrepareSleep());
+    CHECK(ring.consumer.SleepWord()->load() == 0);
+    CHECK(ring.consumer.Drain([](const char*, size_t) {}) == 1);
+
+    // Across threads, with the producer pausing so the consumer sleeps
+    // often: a lost wake shows up as a futex wait that times out
+    const uint32_t count = 20000;
+    int sleeps = 0, timeouts = 0;
+    uint32_t expect = 0;
+    bool inOrder = true;
+    std::thread consumer([&] {
+        while (expect < count) {
+            if (ring.consumer.Drain([&](const char* data, size_t len) {
+                    inOrder &= len == 4 && memcmp(data, &expect, 4) == 0;
+                    expect++;
+                }))
+                continue;
+            if (ring.consumer.PrepareSleep()) {
+                sleeps++;
+                if (!FutexWaitFor(ring.consumer.SleepWord(), 1, 2000)) timeouts++;
+            }
+            ring.consumer.EndSleep();
+        }
+    });
+    std::mt19937 rng(g_seed);
+    for (uint32_t i = 0; i < count; i++) {
+        while (!ring.producer.TryWrite(&i, 4)) std::this_thread::yield();
+        if (ring.producer.WakeNeeded()) FutexWake(ring.producer.SleepWord());
+        if (rng() % 64 == 0) std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    consumer.join();
+    CHECK(inOrder && expect == count);
+    CHECK_MSG(timeouts == 0, std::to_string(timeouts) + " of " + std::to_string(sleeps) + " sleeps");
+    CHECK(sleeps > 0);
+}
+
+// --- Clip encryption ------------------------------------------------------
+//
+// Known answers from the GCM specification (test cases 13-16, the AES-256
+// ones with 96-bit IVs) and RFC 8439, run through every AES path this CPU
+// has; then random messages against OpenSSL's libcrypto, where the sizes
+// reach the eight-block AES-NI and four-block ChaCha20 loops and their tails.
+
+static std::string Unhex(const char* hex) {
+    std::string out;
+    for (; hex[0] && hex[1]; hex += 2) out += (char)strtoul(std::string(hex, 2).c_str(), nullptr, 16);
+    return out;
+}
+
+static const uint8_t* Bytes(const std::string& s) { return (const uint8_t*)s.data(); }
+
+// Seals with `aead`, checks ciphertext || tag, opens it again and checks
+// that a flipped bit anywhere (text, tag or AAD) is refused
+static void CheckAeadVector(const ClipAead& aead, const std::string& nonce, const std::string& aad,
+                            const std::string& plain, const std::string& expect, const char* name) {
+    std::string sealed(plain.size() + kClipTagSize, '\0');
+    aead.Seal(Bytes(nonce), Bytes(aad), aad.size(), Bytes(plain), plain.size(), (uint8_t*)&sealed[0]);
+    CHECK_MSG(sealed == expect, std::string(name) + ": " + Hex(sealed));
+    std::string opened(plain.size(), '\0');
+    CHECK_MSG(aead.Open(Bytes(nonce), Bytes(aad), aad.size(), Bytes(expect), expect.size(), (uint8_t*)&opened[0]) &&
+                  opened == plain, name);
+    for (size_t bit : { (size_t)0, expect.size() * 8 - 1, plain.size() * 4 }) {
+        std::string bad = expect;
+        bad[bit / 8] ^= (char)(1 << (bit % 8));
+        CHECK_MSG(!aead.Open(Bytes(nonce), Bytes(aad), aad.size(), Bytes(bad), bad.size(), (uint8_t*)&opened[0]), name);
+    }
+    if (!aad.empty()) {
+        std::string badAad = aad;
+        badAad[0] ^= 1;
+        CHECK_MSG(!aead.Open(Bytes(nonce), Bytes(badAad), aad.size(), Bytes(expect), expect.size(), (uint8_t*)&opened[0]),
+                  name);
+    }
+}
+
+static void TestGcmVectors() {
+    const std::string k0 = Unhex("0000000000000000000000000000000000000000000000000000000000000000");
+    const std::string k1 = Unhex("feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308");
+    const std::string iv0 = Unhex("000000000000000000000000");
+    const std::string iv1 = Unhex("cafebabefacedbaddecaf888");
+    const std::string p = Unhex("d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+                                "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255");
+    const std::string c = Unhex("522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+                                "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662898015ad");
+    const std::string aad = Unhex("feedfacedeadbeeffeedfacedeadbeefabaddad2");
+    for (bool accelerated : { false, true }) {
+        if (accelerated && !ClipAesAccelerated()) continue;
+        ClipAead zero(ClipCipher::Aes256Gcm, Bytes(k0), accelerated);
+        CheckAeadVector(zero, iv0, "", "", Unhex("530f8afbc74536b9a963b4f1c4cb738b"), "gcm 13");
+        CheckAeadVector(zero, iv0, "", std::string(16, '\0'),
+                        Unhex("cea7403d4d606b6e074ec5d3baf39d18d0d1c8a799996bf0265b98b5d48ab919"), "gcm 14");
+        ClipAead key(ClipCipher::Aes256Gcm, Bytes(k1), accelerated);
+        CheckAeadVector(key, iv1, "", p, c + Unhex("b094dac5d93471bdec1a502270e3cc6c"), "gcm 15");
+        CheckAeadVector(key, iv1, aad, p.substr(0, 60), c.substr(0, 60) + Unhex("76fc6ece0f4e1768cddf8853bb2d551b"),
+                        "gcm 16");
+    }
+}
+
+static const char kSunscreen[] = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for "
+                                 "the future, sunscreen would be it.";
+
+static void TestChaChaVectors() {
+    using namespace clip_crypto_detail;
+    std::string plain = kSunscreen;
+    std::string key(32, '\0');
+    for (int i = 0; i < 32; i++) key[i] = (char)i;
+
+    // 2.4.2: the keystream from block counter 1
+    uint32_t state[16];
+    ChaChaInit(state, Bytes(key), 1, Bytes(Unhex("000000000000004a00000000")));
+    std::string out(plain.size(), '\0');
+    ChaChaXor(state, Bytes(plain), (uint8_t*)&out[0], plain.size());
+    CHECK_MSG(out == Unhex("6e2e359a2568f98041ba0728dd0d6981e97e7aec1d4360c20a27afccfd9fae0bf91b65c5524733ab8f593dabcd62b357"
+                           "1639d624e65152ab8f530c359f0861d807ca0dbf500d6a6156a38e088a22b65e52bc514d16ccf806818ce91ab7793736"
+                           "5af90bbf74a35be6b40b8eedf2785e42874d"),
+              Hex(out));
+
+    // 2.5.2: Poly1305 on its own
+    Poly1305 mac(Bytes(Unhex("85d6be7857556d337f4452fe42d506a80103808afb0db2fd4abff6af4149f51b")));
+    std::string message = "Cryptographic Forum Research Group";
+    mac.Update(Bytes(message), message.size());
+    uint8_t tag[16];
+    mac.Finish(tag);
+    CHECK_MSG(std::string((char*)tag, 16) == Unhex("a8061dc1305136c6c22b8baf0c0127a9"), Hex(tag, 16));
+
+    // 2.8.2: the AEAD
+    std::string aeadKey(32, '\0');
+    for (int i = 0; i < 32; i++) aeadKey[i] = (char)(0x80 + i);
+    ClipAead aead(ClipCipher::ChaCha20Poly1305, Bytes(aeadKey));
+    CheckAeadVector(aead, Unhex("070000004041424344454647"), Unhex("50515253c0c1c2c3c4c5c6c7"), plain,
+                    Unhex("d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d63dbea45e8ca9671282fafb69da92728b"
+                          "1a71de0a9e060b2905d6a5b67ecd3b3692ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+                          "3ff4def08e4b7a9de576d26586cec64b6116"
+                          "1ae10b594f09e26a7e902ecbd0600691"),
+                    "rfc 8439 2.8.2");
+}
+
+#ifdef TEST_LIBCRYPTO
+static std::string EvpSeal(ClipCipher cipher, const std::string& key, const std::string& nonce,
+                           const std::string& aad, const std::string& plain) {
+    const EVP_CIPHER* type = cipher == ClipCipher::Aes256Gcm ? EVP_aes_256_gcm() : EVP_chacha20_poly1305();
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    std::string out(plain.size() + kClipTagSize, '\0');
+    int n = 0, last = 0;
+    bool ok = EVP_EncryptInit_ex(ctx, type, nullptr, nullptr, nullptr) &&
+              EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, (int)nonce.size(), nullptr) &&
+              EVP_EncryptInit_ex(ctx, nullptr, nullptr, Bytes(key), Bytes(nonce)) &&
+              (aad.empty() || EVP_EncryptUpdate(ctx, nullptr, &n, Bytes(aad), (int)aad.size())) &&
+              EVP_EncryptUpdate(ctx, (uint8_t*)&out[0], &n, Bytes(plain), (int)plain.size()) &&
+              EVP_EncryptFinal_ex(ctx, (uint8_t*)&out[n], &last) &&
+              EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, kClipTagSize, &out[plain.size()]);
+    EVP_CIPHER_CTX_free(ctx);
+    return ok ? out : "";
+}
+
+static std::string RandomBytes(std::mt19937& rng, size_t len) {
+    std::string s(len, '\0');
+    for (char& c : s) c = (char)rng();
+    return s;
+}
+
+static void TestCryptoAgainstLibcrypto() {
+    struct Path {
+        ClipCipher cipher;
+        bool accelerated;
+        const char* name;
+    };
+    std::vector<Path> paths = { { ClipCipher::Aes256Gcm, false, "aes portable" },
+                                { ClipCipher::ChaCha20Poly1305, false, "chacha20" } };
+    if (ClipAesAccelerated()) paths.push_back({ ClipCipher::Aes256Gcm, true, "aes-ni" });
+    std::mt19937 rng(g_seed);
+    for (int round = 0; round < g_rounds / 4; round++) {
+        std::string key = RandomBytes(rng, 32), nonce = RandomBytes(rng, 12);
+        // Mostly around the block loops' edges, now and then a whole chunk
+        size_t len = rng() % 8 == 0 ? 65536 - rng() % 3 : rng() % 1100;
+        std::string plain = RandomBytes(rng, len), aad = RandomBytes(rng, rng() % 3 ? rng() % 40 : 0);
+        for (const Path& path : paths) {
+            ClipAead aead(path.cipher, Bytes(key), path.accelerated);
+            std::string expect = EvpSeal(path.cipher, key, nonce, aad, plain);
+            std::string sealed(len + kClipTagSize, '\0');
+            aead.Seal(Bytes(nonce), Bytes(aad), aad.size(), Bytes(plain), len, (uint8_t*)&sealed[0]);
+            if (!CHECK_MSG(!expect.empty() && sealed == expect,
+                           std::string(path.name) + ", " + std::to_string(len) + " bytes, seed " + std::to_string(g_seed)))
+                return;
+            std::string opened(len, '\0');
+            CHECK_MSG(aead.Open(Bytes(nonce), Bytes(aad), aad.size(), Bytes(expect), expect.size(),
+                                (uint8_t*)&opened[0]) && opened == plain, path.name);
+        }
+    }
+
+    // A sealed clip, chunk by chunk, is what the documented nonce and AAD
+    // construction gives libcrypto: the format the Python client writes
+    for (ClipCipher cipher : { ClipCipher::Aes256Gcm, ClipCipher::ChaCha20Poly1305 }) {
+        std::string key = RandomBytes(rng, 32), prefix = RandomBytes(rng, kClipNoncePrefixSize);
+        std::string clip = RandomBytes(rng, 2500), sealed;
+        ClipSealer sealer(cipher, Bytes(key), "alice", Bytes(prefix), 10);
+        sealer.Update(clip.data(), clip.size(), sealed);
+        sealer.Finish(sealed);
+        std::string header = std::string("SP\x01", 3) + (char)cipher + (char)10 + prefix;
+        std::string expect = header;
+        for (uint32_t i = 0; i * 1024 < clip.size(); i++) {
+            bool last = (i + 1) * 1024 >= clip.size();
+            std::string nonce = prefix + std::string{ 0, 0, (char)(i >> 8), (char)i, (char)last };
+            expect += EvpSeal(cipher, key, nonce, header + "alice", clip.substr(i * 1024, 1024));
+        }
+        CHECK_MSG(sealed == expect, ClipCipherName(cipher));
+        CHECK(sealed.size() == sealer.SealedSize(clip.size()));
+        std::string opened;
+        ClipOpener opener(Bytes(key), "alice");
+        CHECK(opener.Update(sealed.data(), sealed.size(), opened) && opener.Finish(opened) && opened == clip);
+        ClipOpener wrongUser(Bytes(key), "bob");
+        CHECK(!(wrongUser.Update(sealed.data(), sealed.size(), opened) && wrongUser.Finish(opened)));
+    }
+}
+#endif
+
+// --- Server ---------------------------------------------------------------
+//
+// Python checks against the embedded server script, imported as a module
+// (so nothing listens) in a scratch directory, ephemeral unless a check
+// needs the files. They need flask: where --python has none they are
+// skipped.
+
+static void ServerCheck(const std::string& check, const std::string& env = "SPILL_EPHEMERAL_MB=4") {
+    ScratchDir scratch;
+    WriteFile(scratch.dir + "/broadcast.py", broadcast_py);
+    WriteFile(scratch.dir + "/check.py",
+              "import sys\n"
+              "try:\n"
+              "    import flask\n"
+              "except ImportError:\n"
+              "    sys.exit(77)\n"
+              "import broadcast as server\n" + check);
+    std::string command = "cd " + ShellQuote(scratch.dir) + " && env " + env + " " + ShellQuote(g_python) +
+                          " check.py 2>&1";
+    FILE* pipe = popen(command.c_str(), "r");
+    if (!CHECK(pipe != nullptr)) return;
+    std::string output;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0) output.append(buf, n);
+    int status = pclose(pipe);
+    int code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    if (code == 77) {
+        g_skipped = true;
+        return;
+    }
+    // The last lines of a traceback say which assertion failed
+    if (output.size() > 1500) output = "..." + output.substr(output.size() - 1500);
+    CHECK_MSG(code == 0, "\n" + output);
+}
+
+static void TestClientTrace() {
+    ServerCheck(R"(
+def trace(stages, **extra):
+    return server.client_trace({'id': 't1', 'stages': stages, **extra})
+
+def dropped():
+    return server.metrics.snapshot().counters.get(('spill_trace_dropped_total', ()), 0)
+
+assert trace([['capture', 1, 2], ['hash', 2, 5]]) == ('t1', [('capture', 1, 2), ('hash', 2, 5)], None)
+before = dropped()
+# A stage reported again is dropped, not recorded twice
+assert trace([['hash', 1, 2], ['hash', 3, 4], ['hash', 5, 6], ['hash', 7, 8]])[1] == [('hash', 1, 2)]
+assert dropped() == before + 3
+# Unknown names, wrong shapes, reversed or negative times, bools and unhashable names
+bad = [['upload', 1, 2], ['seal', 2], ['seal', 5, 4], ['seal', -1, 4], ['seal', True, 4],
+       [['seal'], 1, 2], 'seal', None]
+assert trace(bad + [['seal', 1, 2]])[1] == [('seal', 1, 2)]
+assert dropped() == before + 3 + len(bad)
+assert trace([], send_ns=7)[2] == 7 and trace([], send_ns='7')[2] is None
+assert server.client_trace({'id': '', 'stages': [['hash', 1, 2]]}) == (None, [], None)
+assert server.client_trace({'id': 'x' * 65}) == (None, [], None)
+assert server.client_trace('t1') == (None, [], None)
+)");
+}
+
+static void TestSearchIndexLimit() {
+    // Disk mode too: its block scan finds the needle in the raw record
+    for (const char* env : { "SPILL_EPHEMERAL_MB=4", "SPILL_EPHEMERAL_MB=0" }) {
+        ServerCheck(R"(
+limit = server.SEARCH_INDEX_CHARS
+clips = ['head ' + 'x' * limit + ' tail',      # tail past the limit
+         'tail ' + 'x' * limit + ' tail',      # ... and inside it
+         'ta il ' + 'y' * limit + ' tail',     # its trigrams inside, itself past
+         'x' * (limit - 2) + 'tail']           # across the limit
+for content in clips:
+    server.clipboard_logger.log_clipboard_data('u', {'content': content})
+
+def found(query):
+    total, records, complete = server.clip_store.search('u', query, 10)
+    assert complete
+    return sorted(server.json.loads(bytes(r))['broadcast_number'] for r in records)
+
+indexed = {q: found(q) for q in ('tail', 'head', 'ta il', 'TAIL')}
+assert indexed == {'tail': [2], 'head': [1], 'ta il': [3], 'TAIL': [2]}, indexed
+server.clip_store.search_index.clear()  # as before the backfill reaches them
+assert {q: found(q) for q in indexed} == indexed
+)", env);
+    }
+}
+
+// The text log holds no clip text, and a per-user clear leaves none of it
+static void TestTextLog() {
+    ServerCheck(R"(
+import glob, os
+for user, content in (('a', 'secret of a'), ('b', 'secret of b')):
+    server.clipboard_logger.log_clipboard_data(user, {'content': content})
+with open(server.LOG_FILE, encoding='utf-8') as f:
+    text = f.read()
+assert 'User ID: a' in text and 'Content Length: 11 characters' in text
+assert 'secret' not in text, text
+
+open(server.LOG_FILE + '.1', 'w').close()
+reply = server.app.test_client().post('/clear-logs?user_id=a').get_json()
+assert reply['clips_cleared'] == 1, reply
+assert sorted(reply['files_cleared']) == [server.LOG_FILE, server.LOG_FILE + '.1'], reply
+assert not os.path.exists(server.LOG_FILE) and not os.path.exists(server.LOG_FILE + '.1')
+server.compactor.step()
+assert glob.glob(server.LOG_FILE + '*') == []
+server.clipboard_logger.log_clipboard_data('b', {'content': 'more of b'})
+assert os.path.exists(server.LOG_FILE)
+)", "SPILL_EPHEMERAL_MB=0");
+}
+
+static void RegisterAll() {
+    Register("transcode/round_trip", TestUtfRoundTrip);
+    Register("transcode/utf8_invalid", TestUtf8Invalid);
+    Register("transcode/utf8_fuzz", TestUtf8Fuzz);
+    Register("transcode/utf16_fuzz", TestUtf16Fuzz);
+    Register("scan/fuzz", TestScanFuzz);
+    Register("scan/tail", TestScanTail);
+    Register("scan/folding", TestScanFolding);
+    Register("scan/add", TestScanAdd);
+    Register("log/splitter_carriage_return", TestSplitterCarriageReturn);
+    Register("log/splitter_partial_lines", TestSplitterPartialLines);
+    Register("log/splitter_max_line", TestSplitterMaxLine);
+    Register("log/parse_line", TestParseLogLine);
+    Register("log/parse_line_fallback", TestParseLogLineFallback);
+    Register("log/spsc_ring_wrap", TestSpscRingWrap);
+    Register("log/spsc_ring_full", TestSpscRingFull);
+    Register("log/spsc_ring_threads", TestSpscRingThreads);
+    Register("log/channel_drops", TestLogChannelDrops);
+    Register("log_model/eviction", TestScrollbackEviction);
+    Register("log_model/wrap", TestScrollbackWrap);
+    Register("log_model/code_points", TestScrollbackCodePoints);
+    Register("log_model/line_ends", TestScrollbackLineEnds);
+    Register("crypto/gcm_vectors", TestGcmVectors);
+    Register("crypto/chacha20_poly1305_vectors", TestChaChaVectors);
+#ifdef TEST_LIBCRYPTO
+    Register("crypto/libcrypto_cross_check", TestCryptoAgainstLibcrypto);
+#endif
+    Register("remote/bring_up", TestRemoteBringUp);
+    Register("remote/failed_step", TestRemoteFailedStep);
+    Register("remote/healthz_ready", TestHealthzReady);
+    Register("remote/healthz_timeout", TestHealthzTimeout);
+    Register("shm_ring/attach", TestShmRingAttach);
+    Register("shm_ring/wrap", TestShmRingWrap);
+    Register("shm_ring/full", TestShmRingFull);
+    Register("shm_ring/wake", TestShmRingWake);
+    Register("server/client_trace", TestClientTrace);
+    Register("server/search_index_limit", TestSearchIndexLimit);
+    Register("server/text_log", TestTextLog);
+}
+
+int main(int argc, char** argv) {
+    std::string filter;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        if (key == "--filter") filter = value;
+        else if (key == "--seed") g_seed = (uint32_t)strtoul(value.c_str(), nullptr, 10);
+        else if (key == "--rounds") g_rounds = std::max(1, atoi(value.c_str()));
+        else if (key == "--python") g_python = value;
+        else {
+            fprintf(stderr, "usage: test [--filter=S] [--seed=1] [--rounds=2000] [--python=python3]\n");
+            return 2;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);  // runner pipes whose command exited early
+    RegisterAll();
+    int failed = 0, run = 0, skipped = 0;
+    for (const Test& t : Registry()) {
+        if (!filter.empty() && t.name.find(filter) == std::string::npos) continue;
+        g_failures = 0;
+        g_skipped = false;
+        t.run();
+        if (g_skipped && !g_failures) {
+            skipped++;
+            printf("%-36s skipped\n", t.name.c_str());
+            continue;
+        }
+        run++;
+        failed += g_failures != 0;
+        printf("%-36s %s\n", t.name.c_str(), g_failures ? "FAIL" : "ok");
+        fflush(stdout);
+    }
+    printf("%d of %d tests passed", run - failed, run);
+    printf(skipped ? ", %d skipped (see --python)\n" : "\n", skipped);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,268 @@
+#pragma once
+
+// UTF-8 <-> UTF-16 transcoding with validation.
+//
+// Invalid input (bad UTF-8 sequences, overlongs, unpaired surrogates) is
+// replaced with U+FFFD and reported through the optional `valid` flag, so
+// the same calls serve both strict and lossy callers. ASCII runs take an
+// SSE2 / AVX2 fast path on x86; everything else goes through the scalar
+// decoder, which is also the fallback on other CPUs.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define TRANSCODE_SSE2 1
+#endif
+
+#if TRANSCODE_SSE2 && (defined(__GNUC__) || defined(__clang__))
+#define TRANSCODE_AVX2 1
+#endif
+
+// Worst-case output sizes, in code units
+inline size_t Utf16CapacityFor(size_t utf8Len) { return utf8Len; }
+inline size_t Utf8CapacityFor(size_t utf16Len) { return utf16Len * 3; }
+
+namespace transcode_detail {
+
+const char16_t kReplacement = 0xFFFD;
+
+// Leading ASCII bytes copied as UTF-16 units; returns how many were done
+#if TRANSCODE_AVX2
+__attribute__((target("avx2")))
+inline size_t AsciiToUtf16Avx2(const uint8_t* src, size_t len, char16_t* dst) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i in = _mm256_loadu_si256((const __m256i*)(src + i));
+        if (_mm256_movemask_epi8(in)) break;
+        __m256i lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(in));
+        __m256i hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(in, 1));
+        _mm256_storeu_si256((__m256i*)(dst + i), lo);
+        _mm256_storeu_si256((__m256i*)(dst + i + 16), hi);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+inline size_t AsciiToUtf8Avx2(const char16_t* src, size_t len, uint8_t* dst) {
+    const __m256i nonAscii = _mm256_set1_epi16((short)0xFF80);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 16));
+        if (!_mm256_testz_si256(_mm256_or_si256(a, b), nonAscii)) break;
+        __m256i packed = _mm256_packus_epi16(a, b);
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);
+        _mm256_storeu_si256((__m256i*)(dst + i), packed);
+    }
+    return i;
+}
+
+inline bool HasAvx2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+#endif
+
+inline size_t AsciiToUtf16(const uint8_t* src, size_t len, char16_t* dst) {
+    size_t i = 0;
+#if TRANSCODE_AVX2
+    if (HasAvx2()) i = AsciiToUtf16Avx2(src, len, dst);
+#endif
+#if TRANSCODE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src + i));
+        if (_mm_movemask_epi8(in)) break;
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi8(in, zero));
+        _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpackhi_epi8(in, zero));
+    }
+#endif
+    while (i < len && src[i] < 0x80) {
+        dst[i] = src[i];
+        i++;
+    }
+    return i;
+}
+
+inline size_t AsciiToUtf8(const char16_t* src, size_t len, uint8_t* dst) {
+    size_t i = 0;
+#if TRANSCODE_AVX2
+    if (HasAvx2()) i = AsciiToUtf8Avx2(src, len, dst);
+#endif
+#if TRANSCODE_SSE2
+    // packus saturates as signed, so test the high bits explicitly first
+    const __m128i nonAscii = _mm_set1_epi16((short)0xFF80);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 8));
+        __m128i high = _mm_and_si128(_mm_or_si128(a, b), nonAscii);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(high, zero)) != 0xFFFF) break;
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+    }
+#endif
+    while (i < len && src[i] < 0x80) {
+        dst[i] = (uint8_t)src[i];
+        i++;
+    }
+    return i;
+}
+
+// Decodes one non-ASCII sequence at src[0]; returns bytes consumed (>= 1).
+// A maximal invalid subpart yields U+FFFD and clears `ok`.
+inline size_t DecodeUtf8(const uint8_t* src, size_t len, uint32_t& cp, bool& ok) {
+    uint8_t b0 = src[0];
+    size_t need;
+    uint32_t min;
+    if (b0 >= 0xC2 && b0 <= 0xDF) { need = 1; cp = b0 & 0x1F; min = 0x80; }
+    else if (b0 >= 0xE0 && b0 <= 0xEF) { need = 2; cp = b0 & 0x0F; min = 0x800; }
+    else if (b0 >= 0xF0 && b0 <= 0xF4) { need = 3; cp = b0 & 0x07; min = 0x10000; }
+    else { cp = kReplacement; ok = false; return 1; }
+
+    size_t i = 1;
+    for (; i <= need; i++) {
+        if (i >= len || (src[i] & 0xC0) != 0x80) break;
+        cp = (cp << 6) | (src[i] & 0x3F);
+        // Reject overlongs, surrogates and > U+10FFFF as early as possible
+        if (i == 1 && need >= 2) {
+            uint32_t top = cp << (6 * (need - 1));
+            if (top < min || top > 0x10FFFF || (top >= 0xD800 && top <= 0xDFFF)) break;
+        }
+    }
+    if (i <= need) {
+        cp = kReplacement;
+        ok = false;
+    }
+    return i;
+}
+
+} // namespace transcode_detail
+
+// Converts UTF-8 to UTF-16. `dst` needs Utf16CapacityFor(len) units.
+// Returns units written; sets *valid to false if anything was replaced.
+inline size_t Utf8ToUtf16(const char* text, size_t len, char16_t* dst, bool* valid = nullptr) {
+    using namespace transcode_detail;
+    const uint8_t* src = (const uint8_t*)text;
+    bool ok = true;
+    size_t i = 0, o = 0;
+    while (i < len) {
+        size_t run = AsciiToUtf16(src + i, len - i, dst + o);
+        i += run;
+        o += run;
+        if (i >= len) break;
+
+        uint32_t cp;
+        i += DecodeUtf8(src + i, len - i, cp, ok);
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            dst[o++] = (char16_t)(0xD800 | (cp >> 10));
+            dst[o++] = (char16_t)(0xDC00 | (cp & 0x3FF));
+        } else {
+            dst[o++] = (char16_t)cp;
+        }
+    }
+    if (valid) *valid = ok;
+    return o;
+}
+
+// Converts UTF-16 to UTF-8. `dst` needs Utf8CapacityFor(len) bytes.
+// Returns bytes written; sets *valid to false if anything was replaced.
+inline size_t Utf16ToUtf8(const char16_t* src, size_t len, char* text, bool* valid = nullptr) {
+    using namespace transcode_detail;
+    uint8_t* dst = (uint8_t*)text;
+    bool ok = true;
+    size_t i = 0, o = 0;
+    while (i < len) {
+        size_t run = AsciiToUtf8(src + i, len - i, dst + o);
+        i += run;
+        o += run;
+        if (i >= len) break;
+
+        uint32_t cp = src[i++];
+        if (cp >= 0xD800 && cp <= 0xDFFF) {
+            if (cp <= 0xDBFF && i < len && src[i] >= 0xDC00 && src[i] <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (src[i++] - 0xDC00);
+            } else {
+                cp = kReplacement;
+                ok = false;
+            }
+        }
+        if (cp < 0x80) {
+            dst[o++] = (uint8_t)cp;
+        } else if (cp < 0x800) {
+            dst[o++] = (uint8_t)(0xC0 | (cp >> 6));
+            dst[o++] = (uint8_t)(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            dst[o++] = (uint8_t)(0xE0 | (cp >> 12));
+            dst[o++] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+            dst[o++] = (uint8_t)(0x80 | (cp & 0x3F));
+        } else {
+            dst[o++] = (uint8_t)(0xF0 | (cp >> 18));
+            dst[o++] = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+            dst[o++] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+            dst[o++] = (uint8_t)(0x80 | (cp & 0x3F));
+        }
+    }
+    if (valid) *valid = ok;
+    return o;
+}
+
+inline bool ValidateUtf8(const char* text, size_t len) {
+    using namespace transcode_detail;
+    const uint8_t* src = (const uint8_t*)text;
+    size_t i = 0;
+    while (i < len) {
+#if TRANSCODE_SSE2
+        while (i + 16 <= len && !_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(src + i)))) i += 16;
+#endif
+        if (i >= len) break;
+        if (src[i] < 0x80) { i++; continue; }
+        uint32_t cp;
+        bool ok = true;
+        i += DecodeUtf8(src + i, len - i, cp, ok);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+inline bool ValidateUtf16(const char16_t* src, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (src[i] < 0xD800 || src[i] > 0xDFFF) continue;
+        if (src[i] > 0xDBFF || i + 1 >= len || src[i + 1] < 0xDC00 || src[i + 1] > 0xDFFF) return false;
+        i++;
+    }
+    return true;
+}
+
+inline std::u16string Utf8ToUtf16(const std::string& text, bool* valid = nullptr) {
+    std::u16string out(Utf16CapacityFor(text.size()), u'\0');
+    out.resize(Utf8ToUtf16(text.data(), text.size(), &out[0], valid));
+    return out;
+}
+
+inline std::string Utf16ToUtf8(const std::u16string& text, bool* valid = nullptr) {
+    std::string out(Utf8CapacityFor(text.size()), '\0');
+    out.resize(Utf16ToUtf8(text.data(), text.size(), &out[0], valid));
+    return out;
+}
+
+#ifdef _WIN32
+// Win32 wide strings are UTF-16; these are the GUI's conversion points
+static_assert(sizeof(wchar_t) == sizeof(char16_t), "wchar_t must be UTF-16");
+
+inline std::wstring Widen(const std::string& text) {
+    std::wstring out(Utf16CapacityFor(text.size()), L'\0');
+    out.resize(Utf8ToUtf16(text.data(), text.size(), (char16_t*)&out[0]));
+    return out;
+}
+
+inline std::string Narrow(const std::wstring& text) {
+    std::string out(Utf8CapacityFor(text.size()), '\0');
+    out.resize(Utf16ToUtf8((const char16_t*)text.data(), text.size(), &out[0]));
+    return out;
+}
+#endif